@@ -18,6 +18,8 @@
 #include <ltpP.h>
 
 // Other includes
+#include <pthread.h>
+#include <time.h>
 #include <Python.h>
 #include "_utils.c"
 
@@ -67,8 +69,22 @@ static char ltp_update_span_docstring[] =
     "Update/Modify an LTP span configuration.";
 static char ltp_info_span_docstring[] =
     "Get information about an LTP span configuration.";
+static char ltp_sampler_start_docstring[] =
+    "Start sampling the live state of all LTP spans in a native thread.";
+static char ltp_sampler_stop_docstring[] =
+    "Stop an LTP span sampler and free its memory.";
+static char ltp_sampler_series_docstring[] =
+    "Get the time series of LTP span state collected by a sampler.";
+static char ltp_sampler_stats_docstring[] =
+    "Get the statistics of an LTP span sampler.";
+static char ltp_span_segment_size_docstring[] =
+    "Get the max segment size of an LTP span.";
 static char cfdp_pdu_size_docstring[] =
-    "Update/Modify the CFDP segment/PDU size.";
+    "Update/Modify the CFDP segment/PDU size. Returns the size in effect.\n"
+    "Arguments\n"
+    "---------\n"
+    "Int or None [O, optional]: New size in bytes (must be positive). If None\n"
+    "                           or not given, the size is only read.";
 
 
 // Declare the functions to wrap
@@ -84,6 +100,11 @@ static PyObject *pyion_delete_range(PyObject *self, PyObject *args);
 static PyObject *pyion_ltp_span_exists(PyObject *self, PyObject *args);
 static PyObject *pyion_ltp_update_span(PyObject *self, PyObject *args);
 static PyObject *pyion_ltp_info_span(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_sampler_start(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_sampler_stop(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_sampler_series(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_sampler_stats(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_span_segment_size(PyObject *self, PyObject *args);
 static PyObject *pyion_cfdp_pdu_size(PyObject *self, PyObject *args);
 
 // Define member functions of this module
@@ -100,6 +121,11 @@ static PyMethodDef module_methods[] = {
     {"ltp_span_exists", pyion_ltp_span_exists, METH_VARARGS, ltp_span_exists_docstring},
     {"ltp_update_span", pyion_ltp_update_span, METH_VARARGS, ltp_update_span_docstring},
     {"ltp_info_span", pyion_ltp_info_span, METH_VARARGS, ltp_info_span_docstring},
+    {"ltp_sampler_start", pyion_ltp_sampler_start, METH_VARARGS, ltp_sampler_start_docstring},
+    {"ltp_sampler_stop", pyion_ltp_sampler_stop, METH_VARARGS, ltp_sampler_stop_docstring},
+    {"ltp_sampler_series", pyion_ltp_sampler_series, METH_VARARGS, ltp_sampler_series_docstring},
+    {"ltp_sampler_stats", pyion_ltp_sampler_stats, METH_VARARGS, ltp_sampler_stats_docstring},
+    {"ltp_span_segment_size", pyion_ltp_span_segment_size, METH_VARARGS, ltp_span_segment_size_docstring},
     {"cfdp_pdu_size", pyion_cfdp_pdu_size, METH_VARARGS, cfdp_pdu_size_docstring},
     {NULL, NULL, 0, NULL}
 };
@@ -531,6 +557,40 @@ not_found:
     Py_RETURN_FALSE;
 }
 
+static PyObject *pyion_ltp_span_segment_size(PyObject *self, PyObject *args) {
+    // Attach to ION
+    if (!py_ltp_attach()) return NULL;
+
+    // Define variables
+    Sdr      sdr = getIonsdr();
+    LtpVspan *vspan;
+    PsmAddress elt;
+    LtpSpan  span;
+    unsigned long long nbr;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "K", &nbr)) return NULL;
+
+    // If not sdr, set exception and return
+    if (sdr == NULL) {
+        pyion_SetExc(PyExc_RuntimeError, "Cannot find SDR.");
+        return NULL;
+    }
+
+    // Find the span and read its configuration
+    if (!sdr_pybegin_xn(sdr)) return NULL;
+    findSpan((uvast)nbr, &vspan, &elt);
+    if (elt) sdr_read(sdr, (char *)&span, sdr_list_data(sdr, vspan->spanElt), sizeof(LtpSpan));
+    sdr_exit_xn(sdr);
+
+    if (!elt) {
+        PyErr_Format(PyExc_KeyError, "An LTP span to peer %llu is not defined.", nbr);
+        return NULL;
+    }
+
+    return Py_BuildValue("I", (unsigned int)span.maxSegmentSize);
+}
+
 static PyObject *pyion_ltp_update_span(PyObject *self, PyObject *args) {
     // Attach to ION
     if (!py_ltp_attach()) return NULL;
@@ -635,6 +695,319 @@ ok:
     return py_spans;
 }
 
+/* ============================================================================
+ * === LTP span telemetry
+ *
+ * ``ltp_info_span`` only returns the static configuration of the spans. The
+ * sampler is a native thread that periodically reads the live state of all
+ * spans in a single SDR transaction (without holding the GIL), and stores it
+ * as a time series per span in a ring buffer of ``capacity`` samples.
+ *
+ * .. Note:: Segments sent and retransmissions are cumulative counters from
+ *           the span statistics. If this version of ION does not keep them,
+ *           they are reported as -1.
+ * ============================================================================ */
+
+#define MAX_SAMPLED_SPANS 64
+#define MAX_SAMPLER_CAPACITY (1 << 20)      // Samples per span (~12 days at 1 sample/sec)
+
+typedef struct {
+    double t;                               // Time of the sample [sec since epoch]
+    unsigned int export_sessions;           // Active export sessions
+    unsigned int import_sessions;           // Active import sessions
+    unsigned int queued_segments;           // Segments waiting for the LSO
+    long long buffered_bytes;               // Bytes in the block being aggregated
+    long long segments_sent;                // Segments popped by the LSO (cumulative)
+    long long retransmissions;              // Segments and checkpoints retransmitted (cumulative)
+} LtpSpanSample;
+
+typedef struct {
+    uvast engineId;
+    LtpSpanSample *samples;                 // Ring buffer
+    size_t head;                            // Position of the next sample
+    size_t count;
+} LtpSpanSeries;
+
+typedef struct {
+    double period;                          // Time between samples [sec]
+    size_t capacity;                        // Samples kept per span
+    LtpSpanSeries series[MAX_SAMPLED_SPANS];
+    unsigned int num_spans;
+    unsigned long long num_samples;
+    unsigned long long errors;
+    unsigned long long alloc_errors;        // Spans not sampled for lack of memory
+    int running;
+    pthread_t sampler;
+    pthread_mutex_t lock;
+    pthread_cond_t stop;
+} LtpSpanSampler;
+
+static int sampler_read_spans(uvast *ids, LtpSpanSample *smp, double t) {
+    /* Read the live state of all spans. Returns the number of spans read, or
+       -1 if the SDR transaction cannot be started. Does not need the GIL. */
+    Sdr             sdr = getIonsdr();
+	LtpVdb		    *vdb = getLtpVdb();
+	PsmPartition	ionwm = getIonwm();
+	PsmAddress	    elt;
+	LtpVspan	    *vspan;
+    LtpSpan         span;
+    int             n = 0;
+#ifdef OUT_SEG_RE_XMIT
+    LtpSpanStats    stats;
+#endif
+
+    if (!sdr_begin_xn(sdr)) return -1;
+    for (elt = sm_list_first(ionwm, vdb->spans); elt && n < MAX_SAMPLED_SPANS; elt = sm_list_next(ionwm, elt)) {
+        // Get the span data from memory
+        vspan = (LtpVspan *) psp(ionwm, sm_list_data(ionwm, elt));
+        sdr_read(sdr, (char *)&span, sdr_list_data(sdr, vspan->spanElt), sizeof(LtpSpan));
+
+        // Fill the sample
+        ids[n]                  = vspan->engineId;
+        smp[n].t                = t;
+        smp[n].export_sessions  = (unsigned int)sdr_list_length(sdr, span.exportSessions);
+        smp[n].import_sessions  = (unsigned int)sdr_list_length(sdr, span.importSessions);
+        smp[n].queued_segments  = (unsigned int)sdr_list_length(sdr, span.segments);
+        smp[n].buffered_bytes   = (long long)span.lengthOfBufferedBlock;
+        smp[n].segments_sent    = -1;
+        smp[n].retransmissions  = -1;
+#ifdef OUT_SEG_RE_XMIT
+        if (span.stats) {
+            sdr_read(sdr, (char *)&stats, span.stats, sizeof(LtpSpanStats));
+            smp[n].segments_sent   = (long long)stats.tallies[OUT_SEG_POPPED].totalCount;
+            smp[n].retransmissions = (long long)stats.tallies[OUT_SEG_RE_XMIT].totalCount + 
+                                     (long long)stats.tallies[CKPT_RE_XMIT].totalCount;
+        }
+#endif
+        n++;
+    }
+    sdr_exit_xn(sdr);
+
+    return n;
+}
+
+static void sampler_push(LtpSpanSampler *s, uvast engineId, LtpSpanSample *smp) {
+    // Add a sample to the series of a span. Must be called holding the lock.
+    LtpSpanSeries *ts = NULL;
+    unsigned int i;
+
+    // Find the series of this span. New spans get a new series if there is room.
+    for (i = 0; i < s->num_spans; i++)
+        if (s->series[i].engineId == engineId) ts = &(s->series[i]);
+    if (!ts) {
+        if (s->num_spans == MAX_SAMPLED_SPANS) return;
+        ts = &(s->series[s->num_spans]);
+        ts->samples = (LtpSpanSample *)malloc(s->capacity*sizeof(LtpSpanSample));
+        if (!ts->samples) {
+            // The span is not registered, so the next sample retries the allocation
+            s->alloc_errors++;
+            return;
+        }
+        ts->engineId = engineId;
+        ts->head = ts->count = 0;
+        s->num_spans++;
+    }
+
+    // Overwrite the oldest sample if the ring is full
+    ts->samples[ts->head] = *smp;
+    ts->head = (ts->head + 1) % s->capacity;
+    if (ts->count < s->capacity) ts->count++;
+}
+
+static void *span_sampler(void *arg) {
+    // Define variables
+    LtpSpanSampler *s = (LtpSpanSampler *)arg;
+    uvast ids[MAX_SAMPLED_SPANS];
+    LtpSpanSample smp[MAX_SAMPLED_SPANS];
+    struct timespec next;
+    int n, i;
+
+    pthread_mutex_lock(&(s->lock));
+    while (s->running) {
+        // Take the sample without holding the lock
+        pthread_mutex_unlock(&(s->lock));
+        clock_gettime(CLOCK_REALTIME, &next);
+        n = sampler_read_spans(ids, smp, next.tv_sec + next.tv_nsec*1e-9);
+        pthread_mutex_lock(&(s->lock));
+
+        // Store it
+        if (n < 0) {
+            s->errors++;
+        } else {
+            for (i = 0; i < n; i++) sampler_push(s, ids[i], &(smp[i]));
+            s->num_samples++;
+        }
+
+        // Wait until the next sample or until stopped
+        next.tv_sec  += (time_t)s->period;
+        next.tv_nsec += (long)((s->period - (time_t)s->period)*1e9);
+        if (next.tv_nsec >= 1000000000L) {
+            next.tv_sec++;
+            next.tv_nsec -= 1000000000L;
+        }
+        while (s->running && pthread_cond_timedwait(&(s->stop), &(s->lock), &next) == 0);
+    }
+    pthread_mutex_unlock(&(s->lock));
+
+    return NULL;
+}
+
+static PyObject *pyion_ltp_sampler_start(PyObject *self, PyObject *args) {
+    // Attach to ION
+    if (!py_ltp_attach()) return NULL;
+
+    // Define variables
+    LtpSpanSampler *s;
+    double period;
+    Py_ssize_t capacity;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "dn", &period, &capacity))
+        return NULL;
+
+    // Check validity of inputs
+    if (period <= 0 || capacity <= 0) {
+        pyion_SetExc(PyExc_ValueError, "LTP sampler period and capacity must be positive.");
+        return NULL;
+    }
+    if ((size_t)capacity > MAX_SAMPLER_CAPACITY || (size_t)capacity > SIZE_MAX/sizeof(LtpSpanSample)) {
+        pyion_SetExc(PyExc_ValueError, "LTP sampler capacity cannot exceed %d samples.", MAX_SAMPLER_CAPACITY);
+        return NULL;
+    }
+
+    // Allocate memory for the sampler and initialize to zeros
+    s = (LtpSpanSampler *)malloc(sizeof(LtpSpanSampler));
+    if (s == NULL) {
+        pyion_SetExc(PyExc_RuntimeError, "Cannot malloc for LTP sampler.");
+        return NULL;
+    }
+    memset((char *)s, 0, sizeof(LtpSpanSampler));
+    s->period   = period;
+    s->capacity = (size_t)capacity;
+
+    // Initialize synchronization primitives
+    pthread_mutex_init(&(s->lock), NULL);
+    pthread_cond_init(&(s->stop), NULL);
+
+    // Start the sampler
+    s->running = 1;
+    if (pthread_create(&(s->sampler), NULL, span_sampler, s) != 0) {
+        pthread_cond_destroy(&(s->stop));
+        pthread_mutex_destroy(&(s->lock));
+        free(s);
+        pyion_SetExc(PyExc_RuntimeError, "Cannot start LTP sampler.");
+        return NULL;
+    }
+
+    // Return the memory address of the sampler as an unsigned long
+    return Py_BuildValue("k", s);
+}
+
+static PyObject *pyion_ltp_sampler_stop(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSpanSampler *s;
+    unsigned int i;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&s))
+        return NULL;
+
+    // Stop the sampler
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(s->lock));
+    s->running = 0;
+    pthread_cond_broadcast(&(s->stop));
+    pthread_mutex_unlock(&(s->lock));
+    pthread_join(s->sampler, NULL);
+    Py_END_ALLOW_THREADS
+
+    // Free the sampler
+    for (i = 0; i < s->num_spans; i++) free(s->series[i].samples);
+    pthread_cond_destroy(&(s->stop));
+    pthread_mutex_destroy(&(s->lock));
+    free(s);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *series_to_dict(LtpSpanSampler *s, LtpSpanSeries *ts) {
+    // Convert the series of a span to {name: list}, from oldest to newest
+    static const char *names[] = {"time", "export_sessions", "import_sessions", "queued_segments",
+                                  "buffered_bytes", "segments_sent", "retransmissions"};
+    PyObject *cols[7], *ret;
+    LtpSpanSample *smp;
+    size_t i, start;
+    int j, ok = 1;
+
+    for (j = 0; j < 7; j++) if ((cols[j] = PyList_New(ts->count)) == NULL) ok = 0;
+    start = (ts->head + s->capacity - ts->count) % s->capacity;
+    for (i = 0; ok && i < ts->count; i++) {
+        smp = &(ts->samples[(start + i) % s->capacity]);
+        PyList_SET_ITEM(cols[0], i, PyFloat_FromDouble(smp->t));
+        PyList_SET_ITEM(cols[1], i, PyLong_FromUnsignedLong(smp->export_sessions));
+        PyList_SET_ITEM(cols[2], i, PyLong_FromUnsignedLong(smp->import_sessions));
+        PyList_SET_ITEM(cols[3], i, PyLong_FromUnsignedLong(smp->queued_segments));
+        PyList_SET_ITEM(cols[4], i, PyLong_FromLongLong(smp->buffered_bytes));
+        PyList_SET_ITEM(cols[5], i, PyLong_FromLongLong(smp->segments_sent));
+        PyList_SET_ITEM(cols[6], i, PyLong_FromLongLong(smp->retransmissions));
+    }
+
+    // Build the dictionary
+    ret = ok ? PyDict_New() : NULL;
+    for (j = 0; j < 7; j++) {
+        if (ret && cols[j] && PyDict_SetItemString(ret, names[j], cols[j]) < 0) Py_CLEAR(ret);
+        Py_XDECREF(cols[j]);
+    }
+
+    return ret;
+}
+
+static PyObject *pyion_ltp_sampler_series(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSpanSampler *s;
+    unsigned long long nbr;
+    PyObject *ret, *key, *item;
+    unsigned int i;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kK", (unsigned long *)&s, &nbr))
+        return NULL;
+
+    // Build {engine number: {name: list}}. If a number is provided, use it to
+    // filter the spans
+    ret = PyDict_New();
+    pthread_mutex_lock(&(s->lock));
+    for (i = 0; ret && i < s->num_spans; i++) {
+        if (nbr > 0 && nbr != s->series[i].engineId) continue;
+        key  = PyLong_FromUnsignedLongLong(s->series[i].engineId);
+        item = series_to_dict(s, &(s->series[i]));
+        if (!key || !item || PyDict_SetItem(ret, key, item) < 0) Py_CLEAR(ret);
+        Py_XDECREF(key);
+        Py_XDECREF(item);
+    }
+    pthread_mutex_unlock(&(s->lock));
+
+    return ret;
+}
+
+static PyObject *pyion_ltp_sampler_stats(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSpanSampler *s;
+    PyObject *ret;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&s))
+        return NULL;
+
+    pthread_mutex_lock(&(s->lock));
+    ret = Py_BuildValue("{s:d,s:n,s:I,s:K,s:K,s:K}", "period", s->period, "capacity", (Py_ssize_t)s->capacity,
+                        "spans", s->num_spans, "samples", s->num_samples, "errors", s->errors,
+                        "alloc_errors", s->alloc_errors);
+    pthread_mutex_unlock(&(s->lock));
+
+    return ret;
+}
+
 /* ============================================================================
  * === CFDP administration functions
  * ============================================================================ */
@@ -647,11 +1020,21 @@ static PyObject *pyion_cfdp_pdu_size(PyObject *self, PyObject *args) {
     Sdr     sdr = getIonsdr();
     Object	cfdpdbObj = getCfdpDbObject();
 	CfdpDB	cfdpdb;
-    int     segsize;
+    PyObject *py_size = Py_None;
+    long    segsize = 0;
 
-    // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "i", &segsize))
+    // Parse the input tuple. Raises error automatically if not possible. 
+    // Without a size (or None), just return the current one.
+    if (!PyArg_ParseTuple(args, "|O", &py_size))
         return NULL;
+    if (py_size != Py_None) {
+        segsize = PyLong_AsLong(py_size);
+        if (segsize == -1 && PyErr_Occurred()) return NULL;
+        if (segsize <= 0 || segsize > INT_MAX) {
+            pyion_SetExc(PyExc_ValueError, "CFDP PDU size must be in [1, %d] (got %ld).", INT_MAX, segsize);
+            return NULL;
+        }
+    }
 
     // Check validity of inputs
     if (!sdr) {
@@ -666,9 +1049,11 @@ static PyObject *pyion_cfdp_pdu_size(PyObject *self, PyObject *args) {
     // Modify the segment size
     if (!sdr_pybegin_xn(sdr)) return NULL;
     sdr_stage(sdr, (char *) &cfdpdb, cfdpdbObj, sizeof(CfdpDB));
-	cfdpdb.maxFileDataLength = segsize;
-	sdr_write(sdr, cfdpdbObj, (char *) &cfdpdb, sizeof(CfdpDB));
+    if (segsize > 0) {
+	    cfdpdb.maxFileDataLength = (int)segsize;
+	    sdr_write(sdr, cfdpdbObj, (char *) &cfdpdb, sizeof(CfdpDB));
+    }
     if (!sdr_pyend_xn(sdr)) return NULL;
 
-    Py_RETURN_NONE;
+    return Py_BuildValue("i", (int)cfdpdb.maxFileDataLength);
 }
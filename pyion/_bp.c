@@ -29,9 +29,10 @@
  * Also, to ensure no race conditions, the BpSapState object tracks the endpoint
  * status, which can be either EID_IDLE, EID_RUNNING, EID_CLOSING, EID_INTERRUPTING.
  * 
- * .. Warning:: While the status in BpSapState prevents most race conditions, 
- *              some edge cases might still be possible (e.g., the user issues
- *              a SIGINT while you are closing a endpoint).
+ * The status is protected by a lock. ``bp_interrupt`` and ``bp_close`` wake up
+ * the receiver and wait (with a deadline) until it acknowledges that it has left
+ * the endpoint. Only then ``bp_close`` frees the BpSapState. If the receiver does
+ * not acknowledge in time, it frees the BpSapState itself when it finally leaves.
  *
  * Limitations
  * -----------
@@ -47,10 +48,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
 #include <bp.h>
+#ifdef PYION_PRIVATE_API
+#include <bpP.h>
+#endif
 #include <Python.h>
 
 #include "_utils.c"
+#include "_codec.c"
 
 /* ============================================================================
  * === _bp module definitions
@@ -78,6 +85,12 @@ static char bp_close_docstring[] =
     "Arguments\n"
     "---------\n"
     "Long [k]: Memory address of SAP to close";
+static char bp_close_many_docstring[] =
+    "Close several endpoints at once. Their receivers are interrupted in parallel,\n"
+    "and the call returns when all of them have acknowledged it.\n"
+    "Arguments\n"
+    "---------\n"
+    "Tuple of Long [k]: Memory addresses of the SAPs to close";
 static char bp_send_docstring[] =
     "Send a blob of bytes using bp_send.\n"
     "Arguments\n"
@@ -90,7 +103,14 @@ static char bp_send_docstring[] =
     "Int [i]: BP custody\n"
     "Int [i]: Report flags\n"
     "Int [i]: Acknowledgement required\n"
-    "Bytes-like object [s#]: data";
+    "Int [I]: Custodial retransmission timer [sec]\n"
+    "Int [i]: Ordinal (sub-priority within the expedited class)\n"
+    "Long [k]: Memory address of the bundle tracker (0 for none)\n"
+    "Bytes-like object [s#]: data\n"
+    "Return\n"
+    "------\n"
+    "Tuple (creation time, creation count) of the bundle. None if the endpoint\n"
+    "is not detained, or pyion was compiled without ION's private API";
 static char bp_receive_docstring[] =
     "Receive a blob of bytes using bp_send.\n"
     "Arguments\n"
@@ -101,15 +121,217 @@ static char bp_interrupt_docstring[] =
     "Arguments\n"
     "---------\n"
     "Long [k]: Memory address of SAP to interrupt";
+static char bp_interrupt_many_docstring[] =
+    "Interrupt several endpoints at once, and wait until all their receivers\n"
+    "have acknowledged it.\n"
+    "Arguments\n"
+    "---------\n"
+    "Tuple of Long [k]: Memory addresses of the SAPs to interrupt";
+static char bp_queue_open_docstring[] =
+    "Create a priority send queue and start its dispatcher thread.\n"
+    "Return\n"
+    "------\n"
+    "Long [k]: Memory address of the send queue";
+static char bp_queue_close_docstring[] =
+    "Stop the dispatcher of a send queue, drop pending data and free it.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the send queue";
+static char bp_queue_send_docstring[] =
+    "Enqueue a blob of bytes to be sent by the dispatcher.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the send queue\n"
+    "Long [k]: SAP memory address of endpoint\n"
+    "String [s]: Destination EID\n"
+    "String or None [z]: Report EID\n"
+    "Int [i]: Time-to-live [sec]\n"
+    "Int [i]: BP priority\n"
+    "Int [i]: Ordinal (sub-priority) [0-254]\n"
+    "Int [i]: BP custody\n"
+    "Int [i]: Report flags\n"
+    "Int [i]: Acknowledgement required\n"
+    "Int [I]: Custodial retransmission timer [sec]\n"
+    "Long [k]: Memory address of the bundle tracker (0 for none)\n"
+    "Int [n]: Chunk size in bytes (0 sends the data in one bundle)\n"
+    "Bytes-like object [y*]: data";
+static char bp_queue_flush_docstring[] =
+    "Block until all data in the send queue has been handed to BP.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the send queue\n"
+    "Double [d]: Timeout in [sec]. Negative means wait forever\n"
+    "Return\n"
+    "------\n"
+    "Bool: False if the timeout expired";
+static char bp_queue_purge_docstring[] =
+    "Drop all pending data of an endpoint from the send queue.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the send queue\n"
+    "Long [k]: SAP memory address of endpoint";
+static char bp_stripe_send_docstring[] =
+    "Split a blob of bytes in sequenced chunks and send them round-robin\n"
+    "over several endpoints and/or destinations.\n"
+    "Arguments\n"
+    "---------\n"
+    "Tuple of Long [O]: SAP memory addresses of the endpoints\n"
+    "Tuple of String [O]: Destination EIDs\n"
+    "String or None [z]: Report EID\n"
+    "Int [i]: Time-to-live [sec]\n"
+    "Int [i]: BP priority\n"
+    "Int [i]: Ordinal (sub-priority) [0-254]\n"
+    "Int [i]: BP custody\n"
+    "Int [i]: Report flags\n"
+    "Int [i]: Acknowledgement required\n"
+    "Int [I]: Custodial retransmission timer [sec]\n"
+    "Long [k]: Memory address of the bundle tracker (0 for none)\n"
+    "Int [I]: Transfer id\n"
+    "Int [n]: Chunk size in bytes (without stripe header)\n"
+    "Bytes-like object [y*]: data\n"
+    "Return\n"
+    "------\n"
+    "Int: Number of chunks sent";
+static char bp_stripe_rx_open_docstring[] =
+    "Create a reassembly buffer for a striped transfer.\n"
+    "Arguments\n"
+    "---------\n"
+    "Int [I]: Transfer id (0 accepts the first transfer seen)\n"
+    "Writable buffer or None [O]: Output. If None, a bytes object is allocated\n"
+    "Return\n"
+    "------\n"
+    "Long [k]: Memory address of the reassembly state";
+static char bp_stripe_receive_docstring[] =
+    "Receive one chunk of a striped transfer and store it in place.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the reassembly state\n"
+    "Long [k]: SAP memory address of endpoint\n"
+    "Return\n"
+    "------\n"
+    "Int: Chunks still missing (-1 if not known yet)";
+static char bp_stripe_rx_status_docstring[] =
+    "Get the progress of a striped transfer.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the reassembly state";
+static char bp_stripe_rx_close_docstring[] =
+    "Free a reassembly state.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the reassembly state\n"
+    "Return\n"
+    "------\n"
+    "The output object if the transfer is complete, None otherwise";
+static char bp_receive_reports_docstring[] =
+    "Receive and decode a batch of administrative records (status reports and\n"
+    "custody signals) delivered to an endpoint.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of SAP to receive from\n"
+    "Int [I]: Max number of records to return\n"
+    "Int [i]: Seconds to wait for the first record (-1 waits forever)\n"
+    "Long [k]: Memory address of a bundle tracker to update (0 for none)\n"
+    "Return\n"
+    "------\n"
+    "List of tuples (kind, source EID, creation time, creation count, fragment\n"
+    "offset, fragment length, flags, reason, time). Times are DTN seconds. If an\n"
+    "error or interruption ends a batch with records, they are returned and the\n"
+    "error is raised on the next call.";
+static char bp_queue_stats_docstring[] =
+    "Get the counters of a send queue.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the send queue";
+static char bp_set_codec_docstring[] =
+    "Set the compression stage of an endpoint.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: SAP memory address of endpoint\n"
+    "Int [i]: Codec (CODEC_NONE, CODEC_LZ4, CODEC_ZSTD)\n"
+    "Int [i]: Level (LZ4 acceleration, ZSTD level). 0 uses the default\n"
+    "Int [n]: Payloads smaller than this are not compressed\n"
+    "Int [n, optional]: Max size of a decompressed payload (default CODEC_MAX_SIZE)";
+static char bp_codec_stats_docstring[] =
+    "Get the compression statistics of an endpoint.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: SAP memory address of endpoint";
+static char bp_tracker_open_docstring[] =
+    "Create an index of outstanding bundles.\n"
+    "Arguments\n"
+    "---------\n"
+    "Int [i]: Report flags that mark a bundle as delivered\n"
+    "Return\n"
+    "------\n"
+    "Long [k]: Memory address of the bundle tracker";
+static char bp_tracker_close_docstring[] =
+    "Free a bundle tracker.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the bundle tracker";
+static char bp_tracker_lookup_docstring[] =
+    "Check if a bundle is outstanding.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the bundle tracker\n"
+    "Int [K]: Creation time\n"
+    "Int [K]: Creation count\n"
+    "Return\n"
+    "------\n"
+    "None if not outstanding, (size, remaining TTL [sec]) otherwise";
+static char bp_tracker_wait_docstring[] =
+    "Block until enough bundles have been delivered.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the bundle tracker\n"
+    "Int [i]: 0 waits for N completed bundles, 1 for at most N in flight\n"
+    "Int [K]: N\n"
+    "Double [d]: Timeout in [sec]. Negative means wait forever\n"
+    "Return\n"
+    "------\n"
+    "Bool: False if the timeout expired";
+static char bp_tracker_stats_docstring[] =
+    "Get the counters of a bundle tracker.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the bundle tracker";
+static char bp_tracker_outstanding_docstring[] =
+    "List the handles of all outstanding bundles.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the bundle tracker";
 
 // Declare the functions to wrap
 static PyObject *pyion_bp_attach(PyObject *self, PyObject *args);
 static PyObject *pyion_bp_detach(PyObject *self, PyObject *args);
 static PyObject *pyion_bp_open(PyObject *self, PyObject *args);
 static PyObject *pyion_bp_close(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_close_many(PyObject *self, PyObject *args);
 static PyObject *pyion_bp_send(PyObject *self, PyObject *args);
 static PyObject *pyion_bp_receive(PyObject *self, PyObject *args);
 static PyObject *pyion_bp_interrupt(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_interrupt_many(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_queue_open(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_queue_close(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_queue_send(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_queue_flush(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_queue_purge(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_queue_stats(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_stripe_send(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_receive_reports(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_stripe_rx_open(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_stripe_receive(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_stripe_rx_status(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_stripe_rx_close(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_set_codec(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_codec_stats(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_tracker_open(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_tracker_close(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_tracker_lookup(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_tracker_wait(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_tracker_stats(PyObject *self, PyObject *args);
+static PyObject *pyion_bp_tracker_outstanding(PyObject *self, PyObject *args);
 
 // Define member functions of this module
 static PyMethodDef module_methods[] = {
@@ -117,9 +339,31 @@ static PyMethodDef module_methods[] = {
     {"bp_detach", pyion_bp_detach, METH_VARARGS, bp_detach_docstring},
     {"bp_open", pyion_bp_open, METH_VARARGS, bp_open_docstring},
     {"bp_close", pyion_bp_close, METH_VARARGS, bp_close_docstring},
+    {"bp_close_many", pyion_bp_close_many, METH_VARARGS, bp_close_many_docstring},
     {"bp_send", pyion_bp_send, METH_VARARGS, bp_send_docstring},
     {"bp_receive", pyion_bp_receive, METH_VARARGS, bp_receive_docstring},
     {"bp_interrupt", pyion_bp_interrupt, METH_VARARGS, bp_interrupt_docstring},
+    {"bp_interrupt_many", pyion_bp_interrupt_many, METH_VARARGS, bp_interrupt_many_docstring},
+    {"bp_queue_open", pyion_bp_queue_open, METH_VARARGS, bp_queue_open_docstring},
+    {"bp_queue_close", pyion_bp_queue_close, METH_VARARGS, bp_queue_close_docstring},
+    {"bp_queue_send", pyion_bp_queue_send, METH_VARARGS, bp_queue_send_docstring},
+    {"bp_queue_flush", pyion_bp_queue_flush, METH_VARARGS, bp_queue_flush_docstring},
+    {"bp_queue_purge", pyion_bp_queue_purge, METH_VARARGS, bp_queue_purge_docstring},
+    {"bp_queue_stats", pyion_bp_queue_stats, METH_VARARGS, bp_queue_stats_docstring},
+    {"bp_receive_reports", pyion_bp_receive_reports, METH_VARARGS, bp_receive_reports_docstring},
+    {"bp_stripe_send", pyion_bp_stripe_send, METH_VARARGS, bp_stripe_send_docstring},
+    {"bp_stripe_rx_open", pyion_bp_stripe_rx_open, METH_VARARGS, bp_stripe_rx_open_docstring},
+    {"bp_stripe_receive", pyion_bp_stripe_receive, METH_VARARGS, bp_stripe_receive_docstring},
+    {"bp_stripe_rx_status", pyion_bp_stripe_rx_status, METH_VARARGS, bp_stripe_rx_status_docstring},
+    {"bp_stripe_rx_close", pyion_bp_stripe_rx_close, METH_VARARGS, bp_stripe_rx_close_docstring},
+    {"bp_set_codec", pyion_bp_set_codec, METH_VARARGS, bp_set_codec_docstring},
+    {"bp_codec_stats", pyion_bp_codec_stats, METH_VARARGS, bp_codec_stats_docstring},
+    {"bp_tracker_open", pyion_bp_tracker_open, METH_VARARGS, bp_tracker_open_docstring},
+    {"bp_tracker_close", pyion_bp_tracker_close, METH_VARARGS, bp_tracker_close_docstring},
+    {"bp_tracker_lookup", pyion_bp_tracker_lookup, METH_VARARGS, bp_tracker_lookup_docstring},
+    {"bp_tracker_wait", pyion_bp_tracker_wait, METH_VARARGS, bp_tracker_wait_docstring},
+    {"bp_tracker_stats", pyion_bp_tracker_stats, METH_VARARGS, bp_tracker_stats_docstring},
+    {"bp_tracker_outstanding", pyion_bp_tracker_outstanding, METH_VARARGS, bp_tracker_outstanding_docstring},
     {NULL, NULL, 0, NULL}
 };
 
@@ -166,6 +410,13 @@ PyMODINIT_FUNC PyInit__bp(void) {
     PyModule_AddIntConstant(module, "NoCustodyRequested", NoCustodyRequested);
     PyModule_AddIntConstant(module, "SourceCustodyOptional", SourceCustodyOptional);
     PyModule_AddIntConstant(module, "SourceCustodyRequired", SourceCustodyRequired);
+    PyModule_AddIntConstant(module, "BP_STATUS_REPORT", 1);
+    PyModule_AddIntConstant(module, "BP_CUSTODY_SIGNAL", 2);
+    PyModule_AddIntMacro(module, CODEC_NONE);
+    PyModule_AddIntMacro(module, CODEC_LZ4);
+    PyModule_AddIntMacro(module, CODEC_ZSTD);
+    PyModule_AddIntMacro(module, CODEC_MIN_SIZE);
+    PyModule_AddIntMacro(module, CODEC_MAX_SIZE);
 
     return module;
 }
@@ -189,6 +440,19 @@ typedef struct {
     BpSAP sap;
     SapStateEnum status;
     int detained;
+    PyionCodec codec;           // Compression stage of ``bp_send``/``bp_receive``
+
+    // Handshake between a receiver and the call that interrupts/closes it.
+    // The status and the flags below are only modified holding the lock.
+    int receiving;              // 1 while a call is receiving through this endpoint
+    int closer_waiting;         // 1 while ``bp_close`` waits for the receiver
+    pthread_mutex_t lock;
+    pthread_cond_t acked;       // Signaled when the receiver leaves the endpoint
+
+    // Error of ``bp_receive_reports`` raised on its next call, so that the records
+    // received before it are returned first (RPT_DEFERRED_*). Modified with the GIL.
+    int rpt_deferred;
+    int rpt_err_code;
 } BpSapState;
 
 /* ============================================================================
@@ -197,6 +461,40 @@ typedef struct {
 
 #define MAX_PREALLOC_BUFFER 1024
 
+// Ordinals (i.e., sub-priorities) accepted by ION. Only meaningful for bundles
+// in the expedited class.
+#define MAX_ORDINAL 254
+#define NUM_ORDINALS (MAX_ORDINAL+1)
+
+// Number of BP classes of service (bulk, standard, expedited)
+#define NUM_PRIORITIES 3
+
+// Header prepended to each chunk of a striped transfer (see ``stripe_pack_header``)
+#define STRIPE_MAGIC    0x5053
+#define STRIPE_VERSION  1
+#define STRIPE_HDR_SIZE 24
+
+// Administrative record types (RFC 5050, section 6.1)
+#define ADMIN_STATUS_REPORT  1
+#define ADMIN_CUSTODY_SIGNAL 2
+#define ADMIN_FOR_FRAGMENT   0x01
+
+// Max length of a source EID in an administrative record
+#define MAX_RPT_EID_LEN 256
+
+// Default max number of admin records returned by ``bp_receive_reports``
+#define MAX_RPT_BATCH 1024
+
+// Errors of ``bp_receive_reports`` deferred to its next call
+#define RPT_DEFERRED_NONE      0
+#define RPT_DEFERRED_RECEIVE   1
+#define RPT_DEFERRED_EXTRACT   2
+#define RPT_DEFERRED_INTERRUPT 3
+#define RPT_DEFERRED_CLOSE     4
+
+// Max time that closing/interrupting endpoints waits for their receivers [sec]
+#define SAP_ACK_TIMEOUT 5
+
 /* ============================================================================
  * === Attach/Detach Functions
  * ============================================================================ */
@@ -261,6 +559,8 @@ static PyObject *pyion_bp_open(PyObject *self, PyObject *args) {
     // Mark the SAP state for this endpoint as running
     state->status   = EID_IDLE;
     state->detained = (detained > 0);
+    pthread_mutex_init(&(state->lock), NULL);
+    pthread_cond_init(&(state->acked), NULL);
 
     // Return the memory address of the SAP for this endpoint as an unsined long
     PyObject *ret = Py_BuildValue("k", state);
@@ -272,9 +572,116 @@ static void close_endpoint(BpSapState *state) {
     bp_close(state->sap);
 
     // Free state memory
+    pthread_cond_destroy(&(state->acked));
+    pthread_mutex_destroy(&(state->lock));
     free(state);
 }
 
+static SapStateEnum sap_status(BpSapState *state) {
+    // Get the status of an endpoint. It can be called without holding the GIL.
+    SapStateEnum status;
+
+    pthread_mutex_lock(&(state->lock));
+    status = state->status;
+    pthread_mutex_unlock(&(state->lock));
+
+    return status;
+}
+
+static void sap_enter(BpSapState *state) {
+    // Mark the start of a reception through this endpoint
+    pthread_mutex_lock(&(state->lock));
+    state->receiving = 1;
+    if (state->status != EID_CLOSING) state->status = EID_RUNNING;
+    pthread_mutex_unlock(&(state->lock));
+}
+
+static void sap_leave(BpSapState *state) {
+    /* Mark the end of a reception through this endpoint. This acknowledges any
+       interruption or closure requested while receiving. If the closer gave up
+       waiting for this acknowledgement, the endpoint is closed here. */
+    int do_close;
+
+    pthread_mutex_lock(&(state->lock));
+    state->receiving = 0;
+    do_close = (state->status == EID_CLOSING) && !state->closer_waiting;
+    if (state->status != EID_CLOSING) state->status = EID_IDLE;
+    pthread_cond_broadcast(&(state->acked));
+    pthread_mutex_unlock(&(state->lock));
+
+    if (do_close) close_endpoint(state);
+}
+
+static void sap_stop(BpSapState **states, Py_ssize_t num, SapStateEnum how) {
+    /* Interrupt (``how`` = EID_INTERRUPTING) or close (``how`` = EID_CLOSING)
+       several endpoints. All receivers are woken up first, and then this call
+       waits for their acknowledgement with a common deadline. Endpoints whose
+       receiver does not acknowledge in time are closed when it leaves them.
+       Call it without holding the GIL. */
+    // Define variables
+    struct timespec deadline;
+    Py_ssize_t i;
+    int do_close;
+
+    // Phase 1: Mark all endpoints and wake up their receivers
+    for (i = 0; i < num; i++) {
+        pthread_mutex_lock(&(states[i]->lock));
+        if (how == EID_CLOSING || states[i]->status == EID_RUNNING) {
+            states[i]->status = how;
+            if (how == EID_CLOSING) states[i]->closer_waiting = 1;
+            if (states[i]->receiving) bp_interrupt(states[i]->sap);
+        }
+        pthread_mutex_unlock(&(states[i]->lock));
+    }
+
+    // Compute the absolute deadline
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SAP_ACK_TIMEOUT;
+
+    // Phase 2: Wait for the receivers to acknowledge. Close the endpoints if necessary.
+    for (i = 0; i < num; i++) {
+        pthread_mutex_lock(&(states[i]->lock));
+        while (states[i]->receiving && states[i]->status == how)
+            if (pthread_cond_timedwait(&(states[i]->acked), &(states[i]->lock), &deadline) != 0)
+                break;
+        do_close = (how == EID_CLOSING) && !states[i]->receiving;
+        if (how == EID_CLOSING) states[i]->closer_waiting = 0;
+        pthread_mutex_unlock(&(states[i]->lock));
+
+        if (do_close) close_endpoint(states[i]);
+    }
+}
+
+static BpSapState **parse_states(PyObject *args, Py_ssize_t *num) {
+    /* Parse a tuple of endpoint memory addresses. Returns an array that must
+       be freed by the caller, or NULL and sets the Python exception. */
+    // Define variables
+    PyObject *py_saps;
+    BpSapState **states;
+    Py_ssize_t i;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "O!", &PyTuple_Type, &py_saps))
+        return NULL;
+
+    // Get the memory address of all endpoints. Allocate at least one.
+    *num   = PyTuple_Size(py_saps);
+    states = (BpSapState **)malloc((*num + 1)*sizeof(BpSapState *));
+    if (!states) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (i = 0; i < *num; i++) {
+        states[i] = (BpSapState *)PyLong_AsUnsignedLong(PyTuple_GET_ITEM(py_saps, i));
+        if (PyErr_Occurred()) {
+            free(states);
+            return NULL;
+        }
+    }
+
+    return states;
+}
+
 static PyObject *pyion_bp_close(PyObject *self, PyObject *args) {
     // Define variables
     BpSapState *state;
@@ -283,20 +690,32 @@ static PyObject *pyion_bp_close(PyObject *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "k", (unsigned long *)&state))
         return NULL;
 
-    // If endpoint is in idle state, just close
-    if (state->status == EID_IDLE) {
-        close_endpoint(state);
-        Py_RETURN_NONE;
-    }
-
-    // We assume that if you reach this point, you are always in 
-    // running state.
-    state->status = EID_CLOSING;
-    bp_interrupt(state->sap);
+    // Close the endpoint once its receiver (if any) has acknowledged it
+    Py_BEGIN_ALLOW_THREADS
+    sap_stop(&state, 1, EID_CLOSING);
+    Py_END_ALLOW_THREADS
     
     Py_RETURN_NONE;
 }
 
+static PyObject *pyion_bp_close_many(PyObject *self, PyObject *args) {
+    // Define variables
+    BpSapState **states;
+    Py_ssize_t num;
+
+    // Parse the input tuple
+    if (!(states = parse_states(args, &num)))
+        return NULL;
+
+    // Close all endpoints in parallel
+    Py_BEGIN_ALLOW_THREADS
+    sap_stop(states, num, EID_CLOSING);
+    Py_END_ALLOW_THREADS
+
+    free(states);
+    Py_RETURN_NONE;
+}
+
 /* ============================================================================
  * === Interrupt Endpoint Functions
  * ============================================================================ */
@@ -309,169 +728,1202 @@ static PyObject *pyion_bp_interrupt(PyObject *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "k", (unsigned long *)&state))
         return NULL;
 
-    // If EID is not running, you do not need to interrupt
-    if (state->status != EID_RUNNING)
-        Py_RETURN_NONE;
+    // Interrupt the endpoint if running, and wait until its receiver has
+    // acknowledged it.
+    Py_BEGIN_ALLOW_THREADS
+    sap_stop(&state, 1, EID_INTERRUPTING);
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_bp_interrupt_many(PyObject *self, PyObject *args) {
+    // Define variables
+    BpSapState **states;
+    Py_ssize_t num;
+
+    // Parse the input tuple
+    if (!(states = parse_states(args, &num)))
+        return NULL;
 
-    // Mark that you have transitioned to interruping state
-    state->status = EID_INTERRUPTING;
-    bp_interrupt(state->sap);
+    // Interrupt all endpoints in parallel
+    Py_BEGIN_ALLOW_THREADS
+    sap_stop(states, num, EID_INTERRUPTING);
+    Py_END_ALLOW_THREADS
 
+    free(states);
     Py_RETURN_NONE;
 }
 
 /* ============================================================================
- * === Send Functionality
+ * === Compression Functions
  * ============================================================================ */
 
-static PyObject *pyion_bp_send(PyObject *self, PyObject *args) {
+static PyObject *pyion_bp_set_codec(PyObject *self, PyObject *args) {
     // Define variables
-    char *destEid = NULL;
-    char *reportEid = NULL;
-    Sdr sdr = NULL;
-    const char *data = NULL;
-    int data_size;
-    Object bundleSdr;
-    Object bundleZco;
-    Object newBundle;
-    int ok, ttl, classOfService, rrFlags, ackReq;
-    unsigned int retxTimer;
-    BpCustodySwitch custodySwitch;
-    BpAncillaryData *ancillaryData = NULL;
-    BpSapState *state = NULL;
+    BpSapState *state;
+    int codec, level;
+    Py_ssize_t min_size, max_size = CODEC_MAX_SIZE;
 
-    // Parse input arguments. First one is SAP memory address for this endpoint
-    if (!PyArg_ParseTuple(args, "ksziiiiiIs#", (unsigned long *)&state, &destEid, &reportEid, &ttl,
-                          &classOfService, (int *)&custodySwitch, &rrFlags, &ackReq, &retxTimer,
-                          &data, &data_size))
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kiin|n", (unsigned long *)&state, &codec, &level, &min_size,
+                          &max_size))
         return NULL;
 
-    // Initialize variables
-    sdr = bp_get_sdr();
+    // Configure the compression stage
+    if (!codec_configure(&(state->codec), codec, level, min_size, max_size))
+        return NULL;
 
-    // Start SDR transaction
-    if (!sdr_pybegin_xn(sdr)) return NULL;
+    Py_RETURN_NONE;
+}
 
-    // Insert data to SDR
-    bundleSdr = sdr_insert(sdr, data, (size_t)data_size);
+static PyObject *pyion_bp_codec_stats(PyObject *self, PyObject *args) {
+    // Define variables
+    BpSapState *state;
 
-    // If insert failed, cancel transaction and exit
-    if (!bundleSdr) {
-        sdr_cancel_xn(sdr);
-        pyion_SetExc(PyExc_MemoryError, "SDR memory could not be allocated.");
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&state))
         return NULL;
-    }
 
-    // Create the ZCO object
-    bundleZco = ionCreateZco(ZcoSdrSource, bundleSdr, 0, data_size,
-                             classOfService, 0, ZcoOutbound, NULL);
+    return codec_stats(&(state->codec));
+}
 
-    // Handle error while creating ZCO object
-    if (!bundleZco || bundleZco == (Object)ERROR) {
-        sdr_cancel_xn(sdr);
-        pyion_SetExc(PyExc_MemoryError, "ZCO object creation failed.");
-        return NULL;
-    }
+/* ============================================================================
+ * === Bundle Tracker
+ *
+ * Keeps an index of the bundles sent by this process that are still waiting
+ * for a custody signal or status report. Bundles are identified by their
+ * creation timestamp (time and sequence count), which ION guarantees to be
+ * unique per node. Therefore, the source EID is not part of the key.
+ *  - ``send_payload`` inserts the bundle in the tracker before ending the
+ *    SDR transaction, so a report cannot arrive before the bundle is indexed.
+ *  - ``bp_receive_reports`` removes a bundle when a record asserts one of
+ *    the tracker's ``done_flags`` (completed), or reports its deletion (failed).
+ *  - Bundles whose TTL elapses are swept lazily when the tracker is queried.
+ * Reports for fragments complete the whole bundle. Only bundles sent through
+ * detained endpoints are tracked, since ION does not return the new bundle
+ * otherwise.
+ *
+ * Functions that use the tracker without the GIL (and send jobs) hold a
+ * reference to it, so ``bp_tracker_close`` defers freeing it until the last
+ * user releases it.
+ *
+ * .. Warning:: Reading the creation timestamp of a new bundle requires ION's
+ *              private API (bpP.h). Without it, trackers cannot be opened.
+ * ============================================================================ */
 
-    // Send ZCO object using BP protocol.                            
-    ok = bp_send(state->sap, destEid, reportEid, ttl, classOfService, custodySwitch,
-                 rrFlags, ackReq, ancillaryData, bundleZco, &newBundle);
-                                    
+// Initial number of hash slots. Must be a power of 2.
+#define TRACKER_MIN_SLOTS 1024
 
-    // Handle error in bp_send
-    if (ok <= 0) {
-        sdr_cancel_xn(sdr);
-        pyion_SetExc(PyExc_RuntimeError, "Error while sending the bundle (err code=%i).", ok);
-        return NULL;
-    }
+// Unique identifier of a bundle sent by this node
+typedef struct {
+    uvast seconds;
+    uvast count;
+} BpBundleHandle;
 
-    // If you want custody transfer and have specified a re-transmission timer,
-    // then activate it
-    if (custodySwitch == SourceCustodyRequired && retxTimer > 0) {
-        // Note: The timer starts as soon as bp_memo is called.
-        ok = bp_memo(newBundle, retxTimer);
+typedef struct BpTrackedBundle {
+    BpBundleHandle id;
+    size_t size;                        // Payload size [bytes]
+    time_t deadline;                    // Time at which the TTL expires
+    struct BpTrackedBundle *next;
+} BpTrackedBundle;
 
-        // Handle error in bp_memo
-        if (ok < 0) {
-            sdr_cancel_xn(sdr);
-            pyion_SetExc(PyExc_RuntimeError, "Error while scheduling custodial retransmission (err code=%i).", ok);
-            return NULL;
+typedef struct {
+    BpTrackedBundle **slots;
+    size_t num_slots;
+    size_t in_flight;
+    time_t earliest;                    // No deadline in the index is earlier (see ``tracker_sweep``)
+    int done_flags;                     // Report flags that complete a bundle
+    int users;                          // Calls and send jobs using the tracker
+    int closing;                        // Free when the last user releases it
+    pthread_mutex_t lock;
+    pthread_cond_t changed;             // Signaled when a bundle leaves the index
+
+    // Statistics
+    unsigned long long in_flight_bytes;
+    unsigned long long tracked;
+    unsigned long long completed;
+    unsigned long long completed_bytes;
+    unsigned long long failed;
+    unsigned long long expired;
+    unsigned long long refused;         // Custody refusals (bundle is kept)
+} BpTracker;
+
+static size_t tracker_hash(BpTracker *t, BpBundleHandle *id) {
+    // splitmix64 finalizer of the combined timestamp
+    unsigned long long x = ((unsigned long long)id->seconds << 20) ^ (unsigned long long)id->count;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    x = x ^ (x >> 31);
+    return (size_t)x & (t->num_slots - 1);
+}
+
+static void tracker_grow(BpTracker *t) {
+    /* Double the number of slots. If memory cannot be allocated, the index
+       keeps working with longer chains. Must be called holding the lock. */
+    BpTrackedBundle **old = t->slots, *b, *next;
+    size_t old_slots = t->num_slots, i, h;
+
+    t->slots = (BpTrackedBundle **)calloc(2*old_slots, sizeof(BpTrackedBundle *));
+    if (!t->slots) {
+        t->slots = old;
+        return;
+    }
+    t->num_slots = 2*old_slots;
+
+    for (i = 0; i < old_slots; i++) {
+        for (b = old[i]; b; b = next) {
+            next = b->next;
+            h = tracker_hash(t, &(b->id));
+            b->next = t->slots[h];
+            t->slots[h] = b;
         }
     }
+    free(old);
+}
 
-    // If you have opened this endpoint in detained mode, you need to release the bundle
-    if (state->detained) bp_release(newBundle);
+static int tracker_insert(BpTracker *t, BpBundleHandle *id, size_t size, int ttl) {
+    // Returns 0 if memory cannot be allocated
+    BpTrackedBundle *b = (BpTrackedBundle *)malloc(sizeof(BpTrackedBundle));
+    size_t h;
+
+    if (!b) return 0;
+    b->id       = *id;
+    b->size     = size;
+    b->deadline = time(NULL) + ttl;
+
+    pthread_mutex_lock(&(t->lock));
+    if (t->in_flight >= t->num_slots) tracker_grow(t);
+    if (t->in_flight == 0 || b->deadline < t->earliest) t->earliest = b->deadline;
+    h = tracker_hash(t, id);
+    b->next = t->slots[h];
+    t->slots[h] = b;
+    t->in_flight++;
+    t->in_flight_bytes += size;
+    t->tracked++;
+    pthread_mutex_unlock(&(t->lock));
+
+    return 1;
+}
 
-    // End SDR transaction
-    if (!sdr_pyend_xn(sdr)) return NULL;
+static BpTrackedBundle *tracker_unlink(BpTracker *t, BpBundleHandle *id) {
+    // Remove a bundle from the index. Must be called holding the lock.
+    BpTrackedBundle **prev = &(t->slots[tracker_hash(t, id)]), *b;
 
-    // Return True to indicate success
-    Py_RETURN_TRUE;
+    for (b = *prev; b; prev = &(b->next), b = b->next) {
+        if (b->id.seconds != id->seconds || b->id.count != id->count) continue;
+        *prev = b->next;
+        t->in_flight--;
+        t->in_flight_bytes -= b->size;
+        return b;
+    }
+
+    return NULL;
 }
 
-/* ============================================================================
- * === Receive Functionality
- * ============================================================================ */
+static void tracker_remove(BpTracker *t, BpBundleHandle *id) {
+    // Forget a bundle without counting it (e.g., the send was cancelled)
+    BpTrackedBundle *b;
 
-static PyObject *receive_data(BpSapState *state, BpDelivery *dlv){
-    // Define variables
-    int data_size, len, rx_ret, do_malloc;
-    Sdr sdr;
-    ZcoReader reader;
+    pthread_mutex_lock(&(t->lock));
+    b = tracker_unlink(t, id);
+    if (b) t->tracked--;
+    pthread_mutex_unlock(&(t->lock));
+    free(b);
+}
 
-    // Define variables to store the bundle payload. If payload size is less than
-    // MAX_PREALLOC_BUFFER, then use preallocated buffer to save time. Otherwise,
-    // call malloc to allocate as much memory as you need.
-    char prealloc_payload[MAX_PREALLOC_BUFFER];
-    char *payload;
+static void tracker_sweep(BpTracker *t) {
+    /* Drop bundles whose TTL has elapsed. The index is only walked once the
+       earliest deadline has passed, so calling this often is cheap. Must be 
+       called holding the lock. */
+    BpTrackedBundle **prev, *b;
+    time_t now = time(NULL), earliest = 0;
+    size_t i, n = 0;
+
+    if (t->in_flight == 0 || t->earliest >= now) return;
+
+    for (i = 0; i < t->num_slots && t->in_flight > 0; i++) {
+        prev = &(t->slots[i]);
+        while ((b = *prev) != NULL) {
+            if (b->deadline >= now) {
+                if (earliest == 0 || b->deadline < earliest) earliest = b->deadline;
+                prev = &(b->next);
+                continue;
+            }
+            *prev = b->next;
+            t->in_flight--;
+            t->in_flight_bytes -= b->size;
+            t->expired++;
+            free(b);
+            n++;
+        }
+    }
 
-    // Get ION's SDR
-    sdr = bp_get_sdr();
+    t->earliest = earliest;
+    if (n > 0) pthread_cond_broadcast(&(t->changed));
+}
 
-    while (state->status == EID_RUNNING) {
-        // Receive the next bundle. This is a blocking call. Therefore, release the GIL
-        Py_BEGIN_ALLOW_THREADS                                // Release the GIL
-        rx_ret = bp_receive(state->sap, dlv, BP_BLOCKING);
-        Py_END_ALLOW_THREADS                                  // Acquire the GIL
+static BpTracker *tracker_acquire(BpTracker *t) {
+    // Must be called holding the GIL, so the tracker cannot be closed meanwhile
+    if (!t) return NULL;
+    pthread_mutex_lock(&(t->lock));
+    t->users++;
+    pthread_mutex_unlock(&(t->lock));
+    return t;
+}
 
-        // Check if error while receiving a bundle
-        if ((rx_ret < 0) && (state->status == EID_RUNNING)) {
-            pyion_SetExc(PyExc_IOError, "Error receiving bundle through endpoint (err code=%d).", rx_ret);
-            return NULL;
-        }
+static void tracker_free(BpTracker *t) {
+    // Free all entries and the tracker
+    BpTrackedBundle *b, *next;
+    size_t i;
 
-        // If dlv is not interrupted (e.g., it was successful), get out of loop.
-        // From Scott Burleigh: BpReceptionInterrupted can happen because SO triggers an
-        // interruption without the user doing anything. Therefore, bp_receive always
-        // needs to be enclosed in this type of while loops.
-        if (dlv->result != BpReceptionInterrupted)
-            break;
+    for (i = 0; i < t->num_slots; i++) {
+        for (b = t->slots[i]; b; b = next) {
+            next = b->next;
+            free(b);
+        }
     }
+    free(t->slots);
+    pthread_cond_destroy(&(t->changed));
+    pthread_mutex_destroy(&(t->lock));
+    free(t);
+}
 
-    // If you exited because of interruption
-    if (state->status == EID_INTERRUPTING) {
-        pyion_SetExc(PyExc_InterruptedError, "BP reception interrupted.");
-        return NULL;
-    }
+static void tracker_release(BpTracker *t) {
+    // Free the tracker if it was closed while in use and this is the last user
+    int last;
 
-    // If you exited because of closing
-    if (state->status == EID_CLOSING) {
-        pyion_SetExc(PyExc_ConnectionAbortedError, "BP reception closed.");
-        return NULL;
-    }
+    if (!t) return;
+    pthread_mutex_lock(&(t->lock));
+    t->users--;
+    last = (t->closing && t->users == 0);
+    pthread_mutex_unlock(&(t->lock));
+    if (last) tracker_free(t);
+}
 
-    // If endpoint was stopped, finish
-    if (dlv->result == BpEndpointStopped) {
-        pyion_SetExc(PyExc_ConnectionAbortedError, "BP endpoint was stopped.");
+static int tracker_wants(BpTracker *t, int rrFlags, BpCustodySwitch custodySwitch) {
+    // Only track bundles for which a completing record will be sent
+    if (rrFlags & t->done_flags) return 1;
+    return (custodySwitch == SourceCustodyRequired) && (t->done_flags & BP_CUSTODY_RPT);
+}
+
+static PyObject *pyion_bp_tracker_open(PyObject *self, PyObject *args) {
+    // Define variables
+    BpTracker *t;
+    int done_flags;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "i", &done_flags))
         return NULL;
-    }
 
-    // If bundle does not have the payload, raise IOError
-    if (dlv->result != BpPayloadPresent) {
-        pyion_SetExc(PyExc_IOError, "Bundle received without payload.");
+#ifndef PYION_PRIVATE_API
+    pyion_SetExc(PyExc_NotImplementedError, "Bundle tracker requires compiling pyion with ION_HOME.");
+    return NULL;
+#else
+    // Allocate memory for tracker and initialize to zeros
+    t = (BpTracker *)malloc(sizeof(BpTracker));
+    if (t) memset((char *)t, 0, sizeof(BpTracker));
+    if (t) t->slots = (BpTrackedBundle **)calloc(TRACKER_MIN_SLOTS, sizeof(BpTrackedBundle *));
+    if (!t || !t->slots) {
+        free(t);
+        pyion_SetExc(PyExc_MemoryError, "Cannot malloc for bundle tracker.");
         return NULL;
     }
 
+    // Initialize
+    t->num_slots  = TRACKER_MIN_SLOTS;
+    t->done_flags = done_flags;
+    pthread_mutex_init(&(t->lock), NULL);
+    pthread_cond_init(&(t->changed), NULL);
+
+    // Return the memory address of the tracker as an unsigned long
+    return Py_BuildValue("k", t);
+#endif
+}
+
+static PyObject *pyion_bp_tracker_close(PyObject *self, PyObject *args) {
+    // Define variables
+    BpTracker *t;
+    int unused;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&t))
+        return NULL;
+
+    // Wake up waiters so that they release the tracker. If it is still in use
+    // (e.g., by pending send jobs), the last user frees it.
+    pthread_mutex_lock(&(t->lock));
+    t->closing = 1;
+    unused = (t->users == 0);
+    pthread_cond_broadcast(&(t->changed));
+    pthread_mutex_unlock(&(t->lock));
+    if (unused) tracker_free(t);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_bp_tracker_lookup(PyObject *self, PyObject *args) {
+    // Define variables
+    BpTracker *t;
+    BpBundleHandle id;
+    BpTrackedBundle *b;
+    unsigned long long seconds, count, size = 0;
+    long long ttl = 0;
+    int found = 0;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kKK", (unsigned long *)&t, &seconds, &count))
+        return NULL;
+    id.seconds = (uvast)seconds;
+    id.count   = (uvast)count;
+
+    // Find the bundle
+    pthread_mutex_lock(&(t->lock));
+    for (b = t->slots[tracker_hash(t, &id)]; b; b = b->next) {
+        if (b->id.seconds != id.seconds || b->id.count != id.count) continue;
+        found = 1;
+        size  = (unsigned long long)b->size;
+        ttl   = (long long)(b->deadline - time(NULL));
+        break;
+    }
+    pthread_mutex_unlock(&(t->lock));
+
+    // If not outstanding, return None
+    if (!found) Py_RETURN_NONE;
+
+    return Py_BuildValue("(KL)", size, ttl < 0 ? 0 : ttl);
+}
+
+static PyObject *pyion_bp_tracker_wait(PyObject *self, PyObject *args) {
+    // Define variables
+    BpTracker *t;
+    unsigned long long n;
+    int mode, reached;
+    double timeout;
+    struct timespec deadline, slice;
+    time_t until = 0;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kiKd", (unsigned long *)&t, &mode, &n, &timeout))
+        return NULL;
+
+    // Compute the deadline. A negative timeout waits forever.
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout >= 0) {
+        deadline.tv_sec  += (time_t)timeout;
+        deadline.tv_nsec += (long)((timeout - (time_t)timeout)*1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        until = deadline.tv_sec;
+    }
+
+    // Wait in slices of one second so that expired bundles are swept
+    tracker_acquire(t);
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(t->lock));
+    while (1) {
+        tracker_sweep(t);
+        reached = (mode == 0) ? (t->completed >= n) : (t->in_flight <= n);
+        if (reached || t->closing) break;
+        clock_gettime(CLOCK_REALTIME, &slice);
+        if (timeout >= 0 && (slice.tv_sec > deadline.tv_sec ||
+            (slice.tv_sec == deadline.tv_sec && slice.tv_nsec >= deadline.tv_nsec))) break;
+        slice.tv_sec += 1;
+        if (timeout >= 0 && slice.tv_sec >= until) slice = deadline;
+        pthread_cond_timedwait(&(t->changed), &(t->lock), &slice);
+    }
+    pthread_mutex_unlock(&(t->lock));
+    tracker_release(t);
+    Py_END_ALLOW_THREADS
+
+    return PyBool_FromLong(reached);
+}
+
+static PyObject *pyion_bp_tracker_stats(PyObject *self, PyObject *args) {
+    // Define variables
+    BpTracker *t;
+    BpTracker snap;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&t))
+        return NULL;
+
+    // Take a consistent snapshot of the counters
+    pthread_mutex_lock(&(t->lock));
+    tracker_sweep(t);
+    snap = *t;
+    pthread_mutex_unlock(&(t->lock));
+
+    return Py_BuildValue("{s:n,s:K,s:K,s:K,s:K,s:K,s:K,s:K}",
+                         "in_flight", (Py_ssize_t)snap.in_flight,
+                         "in_flight_bytes", snap.in_flight_bytes,
+                         "tracked", snap.tracked,
+                         "completed", snap.completed,
+                         "completed_bytes", snap.completed_bytes,
+                         "failed", snap.failed,
+                         "expired", snap.expired,
+                         "refused", snap.refused);
+}
+
+static PyObject *pyion_bp_tracker_outstanding(PyObject *self, PyObject *args) {
+    // Define variables
+    BpTracker *t;
+    BpBundleHandle *ids;
+    BpTrackedBundle *b;
+    size_t i, n = 0;
+    PyObject *ret, *item;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&t))
+        return NULL;
+
+    // Copy the handles while holding the lock, build Python objects afterwards
+    pthread_mutex_lock(&(t->lock));
+    tracker_sweep(t);
+    ids = (BpBundleHandle *)malloc((t->in_flight + 1)*sizeof(BpBundleHandle));
+    for (i = 0; ids && i < t->num_slots; i++)
+        for (b = t->slots[i]; b; b = b->next) ids[n++] = b->id;
+    pthread_mutex_unlock(&(t->lock));
+
+    if (!ids) {
+        pyion_SetExc(PyExc_MemoryError, "Cannot malloc for outstanding bundles.");
+        return NULL;
+    }
+
+    // Build the list of handles
+    ret = PyList_New(n);
+    for (i = 0; ret && i < n; i++) {
+        item = Py_BuildValue("(KK)", (unsigned long long)ids[i].seconds,
+                             (unsigned long long)ids[i].count);
+        if (!item) {
+            Py_CLEAR(ret);
+            break;
+        }
+        PyList_SET_ITEM(ret, i, item);
+    }
+    free(ids);
+
+    return ret;
+}
+
+/* ============================================================================
+ * === Send Functionality
+ * ============================================================================ */
+
+// Outcome of ``send_payload``. Used to build the Python exception when
+// sending from a thread that holds the GIL.
+typedef enum {
+    SEND_OK = 0,
+    SEND_ERR_XN,
+    SEND_ERR_SDR,
+    SEND_ERR_ZCO,
+    SEND_ERR_BP,
+    SEND_ERR_MEMO
+} SendResultEnum;
+
+// Parameters of a bundle, as provided by ``Endpoint.bp_send``
+typedef struct {
+    char *destEid;
+    char *reportEid;
+    int ttl;
+    int classOfService;
+    int ordinal;
+    BpCustodySwitch custodySwitch;
+    int rrFlags;
+    int ackReq;
+    unsigned int retxTimer;
+} BpSendParams;
+
+static SendResultEnum send_payload(BpSapState *state, BpSendParams *prm, const char *hdr,
+                                   size_t hdr_size, const char *data, size_t data_size,
+                                   BpTracker *tracker, BpBundleHandle *handle, int *err_code) {
+    /* Insert the data in the SDR and send it using bp_send. If ``hdr`` is not 
+       NULL, it is prepended to the data in the same SDR object. If ``handle``
+       is not NULL and the endpoint is detained (otherwise ION does not return
+       the new bundle), it is filled with the creation timestamp of the new
+       bundle, and the bundle is indexed in ``tracker`` (if not NULL). This function
+       does not interact with Python and can therefore be called without
+       holding the GIL (e.g., from the send queue dispatcher). */
+    // Define variables
+    Sdr sdr = bp_get_sdr();
+    Object bundleSdr;
+    Object bundleZco;
+    Object newBundle;
+    BpAncillaryData ancillaryData;
+    size_t total_size = hdr_size + data_size;
+    int ok, tracked = 0;
+#ifdef PYION_PRIVATE_API
+    Bundle bundle;
+#endif
+
+    // Set the ordinal of this bundle. Everything else uses ION's defaults.
+    memset((char *)&ancillaryData, 0, sizeof(BpAncillaryData));
+    ancillaryData.ordinal = (unsigned char)prm->ordinal;
+
+    // Start SDR transaction
+    if (!sdr_begin_xn(sdr)) return SEND_ERR_XN;
+
+    // Insert data (and header) to SDR
+    if (hdr_size == 0) {
+        bundleSdr = sdr_insert(sdr, (char *)data, data_size);
+    } else {
+        bundleSdr = sdr_malloc(sdr, total_size);
+        if (bundleSdr) {
+            sdr_write(sdr, bundleSdr, (char *)hdr, hdr_size);
+            sdr_write(sdr, bundleSdr + hdr_size, (char *)data, data_size);
+        }
+    }
+
+    // If insert failed, cancel transaction and exit
+    if (!bundleSdr) {
+        sdr_cancel_xn(sdr);
+        return SEND_ERR_SDR;
+    }
+
+    // Create the ZCO object
+    bundleZco = ionCreateZco(ZcoSdrSource, bundleSdr, 0, total_size,
+                             prm->classOfService, prm->ordinal, ZcoOutbound, NULL);
+
+    // Handle error while creating ZCO object
+    if (!bundleZco || bundleZco == (Object)ERROR) {
+        sdr_cancel_xn(sdr);
+        return SEND_ERR_ZCO;
+    }
+
+    // Send ZCO object using BP protocol.
+    ok = bp_send(state->sap, prm->destEid, prm->reportEid, prm->ttl, prm->classOfService,
+                 prm->custodySwitch, prm->rrFlags, prm->ackReq, &ancillaryData, bundleZco,
+                 &newBundle);
+
+    // Handle error in bp_send
+    if (ok <= 0) {
+        sdr_cancel_xn(sdr);
+        *err_code = ok;
+        return SEND_ERR_BP;
+    }
+
+    // If you want custody transfer and have specified a re-transmission timer,
+    // then activate it
+    if (prm->custodySwitch == SourceCustodyRequired && prm->retxTimer > 0) {
+        // Note: The timer starts as soon as bp_memo is called.
+        ok = bp_memo(newBundle, prm->retxTimer);
+
+        // Handle error in bp_memo
+        if (ok < 0) {
+            sdr_cancel_xn(sdr);
+            *err_code = ok;
+            return SEND_ERR_MEMO;
+        }
+    }
+
+#ifdef PYION_PRIVATE_API
+    // Get the ID of the new bundle and index it. This is done before ending the
+    // transaction so that no report can be processed before the bundle is indexed.
+    if (handle && state->detained) {
+        sdr_read(sdr, (char *)&bundle, newBundle, sizeof(Bundle));
+        handle->seconds = (uvast)bundle.id.creationTime.seconds;
+        handle->count   = (uvast)bundle.id.creationTime.count;
+        if (tracker && tracker_wants(tracker, prm->rrFlags, prm->custodySwitch))
+            tracked = tracker_insert(tracker, handle, data_size, prm->ttl);
+    }
+#endif
+
+    // If you have opened this endpoint in detained mode, you need to release the bundle
+    if (state->detained) bp_release(newBundle);
+
+    // End SDR transaction. If it fails, the bundle was never sent.
+    if (sdr_end_xn(sdr) < 0) {
+        if (tracked) tracker_remove(tracker, handle);
+        return SEND_ERR_XN;
+    }
+
+    return SEND_OK;
+}
+
+static void send_set_exc(SendResultEnum res, int err_code) {
+    // Translate the outcome of ``send_payload`` into a Python exception
+    switch (res) {
+        case SEND_ERR_XN:
+            pyion_SetExc(PyExc_RuntimeError, "Cannot start/end SDR transaction.");
+            break;
+        case SEND_ERR_SDR:
+            pyion_SetExc(PyExc_MemoryError, "SDR memory could not be allocated.");
+            break;
+        case SEND_ERR_ZCO:
+            pyion_SetExc(PyExc_MemoryError, "ZCO object creation failed.");
+            break;
+        case SEND_ERR_BP:
+            pyion_SetExc(PyExc_RuntimeError, "Error while sending the bundle (err code=%i).", err_code);
+            break;
+        case SEND_ERR_MEMO:
+            pyion_SetExc(PyExc_RuntimeError, "Error while scheduling custodial retransmission (err code=%i).", err_code);
+            break;
+        default:
+            break;
+    }
+}
+
+static PyObject *pyion_bp_send(PyObject *self, PyObject *args) {
+    // Define variables
+    const char *data = NULL;
+    int data_size, err_code = 0;
+    BpSendParams prm;
+    BpSapState *state = NULL;
+    BpTracker *tracker = NULL;
+    BpBundleHandle handle;
+    SendResultEnum res = SEND_OK;
+    char *payload;
+    size_t payload_size;
+    int encoded;
+
+    // Parse input arguments. First one is SAP memory address for this endpoint
+    if (!PyArg_ParseTuple(args, "ksziiiiiIiks#", (unsigned long *)&state, &prm.destEid,
+                          &prm.reportEid, &prm.ttl, &prm.classOfService, (int *)&prm.custodySwitch,
+                          &prm.rrFlags, &prm.ackReq, &prm.retxTimer, &prm.ordinal,
+                          (unsigned long *)&tracker, &data, &data_size))
+        return NULL;
+
+    // Check validity of the ordinal
+    if (prm.ordinal < 0 || prm.ordinal > MAX_ORDINAL) {
+        pyion_SetExc(PyExc_ValueError, "Ordinal must be in [0, %d].", MAX_ORDINAL);
+        return NULL;
+    }
+
+    // Compress (if enabled) and send the data. Both can take long (sdr_begin_xn
+    // can block), therefore release the GIL.
+    tracker_acquire(tracker);
+    Py_BEGIN_ALLOW_THREADS
+    encoded = codec_encode(&(state->codec), data, (size_t)data_size, &payload, &payload_size);
+    if (encoded >= 0)
+        res = send_payload(state, &prm, NULL, 0, payload, payload_size, tracker, &handle,
+                           &err_code);
+    if (encoded > 0) free(payload);
+    tracker_release(tracker);
+    Py_END_ALLOW_THREADS
+
+    // Handle error while compressing or sending
+    if (encoded < 0) {
+        codec_set_exc(encoded);
+        return NULL;
+    }
+    if (res != SEND_OK) {
+        send_set_exc(res, err_code);
+        return NULL;
+    }
+
+#ifdef PYION_PRIVATE_API
+    // Return the handle of the bundle (creation time, creation count)
+    if (state->detained)
+        return Py_BuildValue("(KK)", (unsigned long long)handle.seconds,
+                             (unsigned long long)handle.count);
+#endif
+
+    // The bundle ID cannot be read
+    Py_RETURN_NONE;
+}
+
+/* ============================================================================
+ * === Priority Send Queue
+ *
+ * ``bp_send`` is synchronous from the application's point of view. If a large
+ * bulk transfer is being sent in chunks, then an expedited command has to wait
+ * until the entire transfer is handed to BP. The send queue decouples the two:
+ *  - Each call to ``bp_queue_send`` creates a BpSendJob (a copy of the data
+ *    and its bundle parameters) and appends it to the bucket of its class of
+ *    service and ordinal.
+ *  - A dispatcher thread always serves the highest non-empty class, and within
+ *    a class the highest ordinal. It sends one chunk of the job at the head of
+ *    that bucket and, if the job is not done, moves it to the tail of the same
+ *    bucket. Therefore, chunks of jobs with equal priority are interleaved, and
+ *    a new higher priority job preempts a transfer in between two chunks.
+ *
+ * .. Warning:: BpSendJobs store the BpSapState of the endpoint that sends them.
+ *              Before closing the endpoint, call ``bp_queue_purge``.
+ * ============================================================================ */
+
+typedef struct BpSendJob {
+    BpSapState *state;
+    BpSendParams prm;
+    BpTracker *tracker;         // NULL if bundles are not tracked
+    size_t chunk_size;          // 0 means send everything in one bundle
+    size_t offset;              // Bytes already sent
+    size_t data_size;
+    char *data;                 // Points inside this allocation, after the eids
+    struct BpSendJob *next;
+} BpSendJob;
+
+// FIFO of jobs with the same class of service and ordinal
+typedef struct {
+    BpSendJob *head;
+    BpSendJob *tail;
+} BpJobBucket;
+
+typedef struct {
+    BpJobBucket buckets[NUM_PRIORITIES][NUM_ORDINALS];
+    unsigned int jobs[NUM_PRIORITIES];      // Jobs pending per class
+    BpSendJob *current;                     // Job being sent by the dispatcher
+    int running;
+    pthread_t dispatcher;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;               // Signaled when a job is enqueued
+    pthread_cond_t progress;                // Signaled when a chunk has been sent
+
+    // Statistics
+    unsigned long long queued_bytes;
+    unsigned long long sent_bytes[NUM_PRIORITIES];
+    unsigned long long sent_bundles[NUM_PRIORITIES];
+    unsigned long long errors;
+    int last_error;                         // Last SendResultEnum that failed
+    int last_err_code;
+} BpSendQueue;
+
+static void bucket_push(BpJobBucket *bucket, BpSendJob *job) {
+    job->next = NULL;
+    if (bucket->tail) bucket->tail->next = job; else bucket->head = job;
+    bucket->tail = job;
+}
+
+static BpSendJob *bucket_pop(BpJobBucket *bucket) {
+    BpSendJob *job = bucket->head;
+    if (!job) return NULL;
+    bucket->head = job->next;
+    if (!bucket->head) bucket->tail = NULL;
+    job->next = NULL;
+    return job;
+}
+
+static BpSendJob *queue_pop_highest(BpSendQueue *q) {
+    // Find the highest class with pending jobs, and then the highest ordinal.
+    // Must be called while holding the queue lock.
+    int p, o;
+
+    for (p = NUM_PRIORITIES-1; p >= 0; p--) {
+        if (q->jobs[p] == 0) continue;
+        for (o = MAX_ORDINAL; o >= 0; o--) {
+            if (q->buckets[p][o].head) {
+                q->jobs[p]--;
+                return bucket_pop(&(q->buckets[p][o]));
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void job_free(BpSendJob *job) {
+    tracker_release(job->tracker);
+    free(job);
+}
+
+static void queue_push(BpSendQueue *q, BpSendJob *job) {
+    // Must be called while holding the queue lock.
+    bucket_push(&(q->buckets[job->prm.classOfService][job->prm.ordinal]), job);
+    q->jobs[job->prm.classOfService]++;
+}
+
+static void *queue_dispatcher(void *arg) {
+    // Define variables
+    BpSendQueue *q = (BpSendQueue *)arg;
+    BpSendJob *job;
+    BpBundleHandle handle;
+    SendResultEnum res;
+    size_t len;
+    int err_code;
+
+    pthread_mutex_lock(&(q->lock));
+    while (1) {
+        // Wait until there is something to send
+        while (q->running && (job = queue_pop_highest(q)) == NULL)
+            pthread_cond_wait(&(q->not_empty), &(q->lock));
+        if (!q->running) break;
+
+        // Compute the size of the next chunk
+        len = job->data_size - job->offset;
+        if (job->chunk_size > 0 && job->chunk_size < len) len = job->chunk_size;
+
+        // Send the chunk without holding the lock, so that producers can enqueue
+        q->current = job;
+        pthread_mutex_unlock(&(q->lock));
+        err_code = 0;
+        res = send_payload(job->state, &(job->prm), NULL, 0, job->data + job->offset, len,
+                           job->tracker, &handle, &err_code);
+        pthread_mutex_lock(&(q->lock));
+        q->current = NULL;
+
+        // Update statistics. On error, the rest of the job is dropped since
+        // sending a partial transfer is of no use to the receiver.
+        q->queued_bytes -= (res == SEND_OK) ? len : (job->data_size - job->offset);
+        if (res == SEND_OK) {
+            job->offset += len;
+            q->sent_bytes[job->prm.classOfService] += len;
+            q->sent_bundles[job->prm.classOfService]++;
+        } else {
+            job->offset = job->data_size;
+            q->errors++;
+            q->last_error = (int)res;
+            q->last_err_code = err_code;
+        }
+
+        // If the job is not done, let other jobs with the same priority go first
+        if (job->offset < job->data_size) {
+            queue_push(q, job);
+        } else {
+            job_free(job);
+        }
+
+        // Wake up anyone waiting for the queue to progress (flush, purge)
+        pthread_cond_broadcast(&(q->progress));
+    }
+    pthread_mutex_unlock(&(q->lock));
+
+    return NULL;
+}
+
+static void queue_drop_jobs(BpSendQueue *q, BpSapState *state) {
+    /* Free all pending jobs of an endpoint (or all if state is NULL). Must be
+       called while holding the queue lock. */
+    BpJobBucket keep;
+    BpSendJob *job;
+    int p, o;
+
+    for (p = 0; p < NUM_PRIORITIES; p++) {
+        if (q->jobs[p] == 0) continue;
+        for (o = 0; o < NUM_ORDINALS; o++) {
+            keep.head = keep.tail = NULL;
+            while ((job = bucket_pop(&(q->buckets[p][o]))) != NULL) {
+                if (state == NULL || job->state == state) {
+                    q->jobs[p]--;
+                    q->queued_bytes -= job->data_size - job->offset;
+                    job_free(job);
+                } else {
+                    bucket_push(&keep, job);
+                }
+            }
+            q->buckets[p][o] = keep;
+        }
+    }
+}
+
+static PyObject *pyion_bp_queue_open(PyObject *self, PyObject *args) {
+    // Allocate memory for queue and initialize to zeros
+    BpSendQueue *q = (BpSendQueue*)malloc(sizeof(BpSendQueue));
+    if (q == NULL) {
+        pyion_SetExc(PyExc_RuntimeError, "Cannot malloc for BP send queue.");
+        return NULL;
+    }
+    memset((char *)q, 0, sizeof(BpSendQueue));
+
+    // Initialize synchronization primitives
+    pthread_mutex_init(&(q->lock), NULL);
+    pthread_cond_init(&(q->not_empty), NULL);
+    pthread_cond_init(&(q->progress), NULL);
+
+    // Start the dispatcher
+    q->running = 1;
+    if (pthread_create(&(q->dispatcher), NULL, queue_dispatcher, q) != 0) {
+        pthread_cond_destroy(&(q->progress));
+        pthread_cond_destroy(&(q->not_empty));
+        pthread_mutex_destroy(&(q->lock));
+        free(q);
+        pyion_SetExc(PyExc_RuntimeError, "Cannot start BP send queue dispatcher.");
+        return NULL;
+    }
+
+    // Return the memory address of the queue as an unsigned long
+    return Py_BuildValue("k", q);
+}
+
+static PyObject *pyion_bp_queue_close(PyObject *self, PyObject *args) {
+    // Define variables
+    BpSendQueue *q;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&q))
+        return NULL;
+
+    // Stop the dispatcher. It finishes the chunk it is sending, if any.
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(q->lock));
+    q->running = 0;
+    pthread_cond_broadcast(&(q->not_empty));
+    pthread_mutex_unlock(&(q->lock));
+    pthread_join(q->dispatcher, NULL);
+    Py_END_ALLOW_THREADS
+
+    // Drop whatever is left and free the queue
+    queue_drop_jobs(q, NULL);
+    pthread_cond_destroy(&(q->progress));
+    pthread_cond_destroy(&(q->not_empty));
+    pthread_mutex_destroy(&(q->lock));
+    free(q);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_bp_queue_send(PyObject *self, PyObject *args) {
+    // Define variables
+    BpSendQueue *q;
+    BpSapState *state;
+    BpSendParams prm;
+    BpSendJob *job;
+    BpTracker *tracker;
+    Py_buffer data;
+    Py_ssize_t chunk_size;
+    size_t dest_len, rpt_len;
+
+    // Parse input arguments
+    if (!PyArg_ParseTuple(args, "kksziiiiiiIkny*", (unsigned long *)&q, (unsigned long *)&state,
+                          &prm.destEid, &prm.reportEid, &prm.ttl, &prm.classOfService,
+                          &prm.ordinal, (int *)&prm.custodySwitch, &prm.rrFlags, &prm.ackReq,
+                          &prm.retxTimer, (unsigned long *)&tracker, &chunk_size, &data))
+        return NULL;
+
+    // Check validity of inputs
+    if (prm.classOfService < 0 || prm.classOfService >= NUM_PRIORITIES) {
+        PyBuffer_Release(&data);
+        pyion_SetExc(PyExc_ValueError, "Invalid BP priority %d.", prm.classOfService);
+        return NULL;
+    }
+    if (prm.ordinal < 0 || prm.ordinal > MAX_ORDINAL) {
+        PyBuffer_Release(&data);
+        pyion_SetExc(PyExc_ValueError, "Ordinal must be in [0, %d].", MAX_ORDINAL);
+        return NULL;
+    }
+    if (chunk_size < 0 || data.len == 0) {
+        PyBuffer_Release(&data);
+        pyion_SetExc(PyExc_ValueError, "Chunk size must be positive and data cannot be empty.");
+        return NULL;
+    }
+
+    // Allocate the job. Destination/report EIDs and data are stored right after it.
+    dest_len = strlen(prm.destEid) + 1;
+    rpt_len  = prm.reportEid ? strlen(prm.reportEid) + 1 : 0;
+    job = (BpSendJob *)malloc(sizeof(BpSendJob) + dest_len + rpt_len + data.len);
+    if (job == NULL) {
+        PyBuffer_Release(&data);
+        pyion_SetExc(PyExc_MemoryError, "Cannot malloc for BP send job.");
+        return NULL;
+    }
+
+    // Fill the job
+    job->state      = state;
+    job->prm        = prm;
+    job->tracker    = tracker_acquire(tracker);
+    job->chunk_size = (size_t)chunk_size;
+    job->offset     = 0;
+    job->data_size  = (size_t)data.len;
+    job->prm.destEid = (char *)(job + 1);
+    memcpy(job->prm.destEid, prm.destEid, dest_len);
+    job->prm.reportEid = rpt_len ? job->prm.destEid + dest_len : NULL;
+    if (rpt_len) memcpy(job->prm.reportEid, prm.reportEid, rpt_len);
+    job->data = job->prm.destEid + dest_len + rpt_len;
+    memcpy(job->data, data.buf, data.len);
+    PyBuffer_Release(&data);
+
+    // Enqueue and wake up the dispatcher
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(q->lock));
+    queue_push(q, job);
+    q->queued_bytes += job->data_size;
+    pthread_cond_signal(&(q->not_empty));
+    pthread_mutex_unlock(&(q->lock));
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static int queue_is_idle(BpSendQueue *q) {
+    // Must be called while holding the queue lock.
+    int p;
+    if (q->current) return 0;
+    for (p = 0; p < NUM_PRIORITIES; p++)
+        if (q->jobs[p] > 0) return 0;
+    return 1;
+}
+
+static PyObject *pyion_bp_queue_flush(PyObject *self, PyObject *args) {
+    // Define variables
+    BpSendQueue *q;
+    double timeout;
+    struct timespec deadline;
+    int idle, ret = 0;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kd", (unsigned long *)&q, &timeout))
+        return NULL;
+
+    // Compute the absolute deadline
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout >= 0) {
+        deadline.tv_sec  += (time_t)timeout;
+        deadline.tv_nsec += (long)((timeout - (time_t)timeout)*1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    // Wait until the queue is empty. This can take long, release the GIL
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(q->lock));
+    while (!(idle = queue_is_idle(q)) && q->running && ret == 0) {
+        if (timeout < 0)
+            pthread_cond_wait(&(q->progress), &(q->lock));
+        else
+            ret = pthread_cond_timedwait(&(q->progress), &(q->lock), &deadline);
+    }
+    idle = queue_is_idle(q);
+    pthread_mutex_unlock(&(q->lock));
+    Py_END_ALLOW_THREADS
+
+    if (idle) Py_RETURN_TRUE;
+    Py_RETURN_FALSE;
+}
+
+static PyObject *pyion_bp_queue_purge(PyObject *self, PyObject *args) {
+    // Define variables
+    BpSendQueue *q;
+    BpSapState *state;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kk", (unsigned long *)&q, (unsigned long *)&state))
+        return NULL;
+
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(q->lock));
+
+    // If the dispatcher is sending on this endpoint, wait for it to finish the
+    // chunk. Otherwise the state could be freed while it is in use.
+    while (q->current && q->current->state == state)
+        pthread_cond_wait(&(q->progress), &(q->lock));
+
+    // Drop all pending jobs of this endpoint
+    queue_drop_jobs(q, state);
+    pthread_cond_broadcast(&(q->progress));
+    pthread_mutex_unlock(&(q->lock));
+    Py_END_ALLOW_THREADS
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_bp_queue_stats(PyObject *self, PyObject *args) {
+    // Define variables
+    BpSendQueue *q;
+    unsigned long long queued, errors;
+    unsigned long long bytes[NUM_PRIORITIES], bundles[NUM_PRIORITIES];
+    unsigned int jobs[NUM_PRIORITIES];
+    int last_error, last_err_code;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&q))
+        return NULL;
+
+    // Take a snapshot of the counters
+    pthread_mutex_lock(&(q->lock));
+    queued = q->queued_bytes;
+    errors = q->errors;
+    last_error = q->last_error;
+    last_err_code = q->last_err_code;
+    memcpy(jobs, q->jobs, sizeof(jobs));
+    memcpy(bytes, q->sent_bytes, sizeof(bytes));
+    memcpy(bundles, q->sent_bundles, sizeof(bundles));
+    pthread_mutex_unlock(&(q->lock));
+
+    return Py_BuildValue("{s:K, s:K, s:i, s:i, s:(III), s:(KKK), s:(KKK)}",
+                         "queued_bytes", queued,
+                         "errors", errors,
+                         "last_error", last_error,
+                         "last_err_code", last_err_code,
+                         "pending_jobs", jobs[BP_BULK_PRIORITY], jobs[BP_STD_PRIORITY],
+                                         jobs[BP_EXPEDITED_PRIORITY],
+                         "sent_bytes", bytes[BP_BULK_PRIORITY], bytes[BP_STD_PRIORITY],
+                                       bytes[BP_EXPEDITED_PRIORITY],
+                         "sent_bundles", bundles[BP_BULK_PRIORITY], bundles[BP_STD_PRIORITY],
+                                         bundles[BP_EXPEDITED_PRIORITY]);
+}
+
+/* ============================================================================
+ * === Receive Functionality
+ * ============================================================================ */
+
+static int wait_for_bundle(BpSapState *state, BpDelivery *dlv) {
+    /* Block until a bundle with payload is delivered to this endpoint. Returns
+       1 if success. Otherwise, it returns 0 and sets the Python exception. */
+    // Define variables
+    int rx_ret;
+
+    // Nothing to release if the endpoint is already closing
+    memset((char *)dlv, 0, sizeof(BpDelivery));
+
+    while (sap_status(state) == EID_RUNNING) {
+        // Receive the next bundle. This is a blocking call. Therefore, release the GIL
+        Py_BEGIN_ALLOW_THREADS                                // Release the GIL
+        rx_ret = bp_receive(state->sap, dlv, BP_BLOCKING);
+        Py_END_ALLOW_THREADS                                  // Acquire the GIL
+
+        // Check if error while receiving a bundle
+        if ((rx_ret < 0) && (sap_status(state) == EID_RUNNING)) {
+            pyion_SetExc(PyExc_IOError, "Error receiving bundle through endpoint (err code=%d).", rx_ret);
+            return 0;
+        }
+
+        // If dlv is not interrupted (e.g., it was successful), get out of loop.
+        // From Scott Burleigh: BpReceptionInterrupted can happen because SO triggers an
+        // interruption without the user doing anything. Therefore, bp_receive always
+        // needs to be enclosed in this type of while loops.
+        if (dlv->result != BpReceptionInterrupted)
+            break;
+    }
+
+    // If you exited because of interruption
+    if (sap_status(state) == EID_INTERRUPTING) {
+        pyion_SetExc(PyExc_InterruptedError, "BP reception interrupted.");
+        return 0;
+    }
+
+    // If you exited because of closing
+    if (sap_status(state) == EID_CLOSING) {
+        pyion_SetExc(PyExc_ConnectionAbortedError, "BP reception closed.");
+        return 0;
+    }
+
+    // If endpoint was stopped, finish
+    if (dlv->result == BpEndpointStopped) {
+        pyion_SetExc(PyExc_ConnectionAbortedError, "BP endpoint was stopped.");
+        return 0;
+    }
+
+    // If bundle does not have the payload, raise IOError
+    if (dlv->result != BpPayloadPresent) {
+        pyion_SetExc(PyExc_IOError, "Bundle received without payload.");
+        return 0;
+    }
+
+    return 1;
+}
+
+static PyObject *receive_data(BpSapState *state, BpDelivery *dlv){
+    // Define variables
+    int data_size, len, do_malloc, decoded;
+    char *output;
+    size_t output_size;
+    Sdr sdr;
+    ZcoReader reader;
+
+    // Define variables to store the bundle payload. If payload size is less than
+    // MAX_PREALLOC_BUFFER, then use preallocated buffer to save time. Otherwise,
+    // call malloc to allocate as much memory as you need.
+    char prealloc_payload[MAX_PREALLOC_BUFFER];
+    char *payload;
+
+    // Get ION's SDR
+    sdr = bp_get_sdr();
+
+    // Wait for the next bundle
+    if (!wait_for_bundle(state, dlv)) return NULL;
+
     // Get content data size
     if (!sdr_pybegin_xn(sdr)) return NULL;
     data_size = zco_source_data_length(sdr, dlv->adu);
@@ -499,8 +1951,23 @@ static PyObject *receive_data(BpSapState *state, BpDelivery *dlv){
         return NULL;
     }
 
-    // Build return object
-    PyObject *ret = Py_BuildValue("y#", payload, len);
+    // Build return object. Compressed payloads are decompressed straight into it.
+    PyObject *ret = NULL;
+    decoded = codec_decode_size(&(state->codec), payload, (size_t)len, &output_size);
+    if (decoded < 0) {
+        codec_set_exc(decoded);
+    } else if (decoded == 0) {
+        ret = PyBytes_FromStringAndSize(payload, (Py_ssize_t)len);
+    } else if ((ret = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)output_size)) != NULL) {
+        output = PyBytes_AS_STRING(ret);
+        Py_BEGIN_ALLOW_THREADS
+        decoded = codec_decode_into(&(state->codec), payload, (size_t)len, output, output_size);
+        Py_END_ALLOW_THREADS
+        if (decoded < 0) {
+            Py_CLEAR(ret);
+            codec_set_exc(decoded);
+        }
+    }
 
     // If you allocated memory for this payload, free it here
     if (do_malloc) free(payload);
@@ -519,7 +1986,7 @@ static PyObject *pyion_bp_receive(PyObject *self, PyObject *args) {
         return NULL;
 
     // Mark as running
-    state->status = EID_RUNNING;
+    sap_enter(state);
 
     // Trigger reception of data
     ret = receive_data(state, &dlv);
@@ -527,19 +1994,708 @@ static PyObject *pyion_bp_receive(PyObject *self, PyObject *args) {
     // Clean up tasks
     bp_release_delivery(&dlv, 1);
 
-    // Close if necessary. Otherwise set to IDLE
-    if (state->status == EID_CLOSING) {
-        close_endpoint(state);
+    // Acknowledge any interruption/closure. This can close the endpoint.
+    sap_leave(state);
+
+    // Return value
+    return ret;
+}
+
+/* ============================================================================
+ * === Striped Transfer Functionality
+ *
+ * A large product is split in chunks that are sent round-robin over several
+ * endpoints and/or destinations. Each chunk carries a header with the 
+ * following fields in network byte order:
+ *
+ *      magic (2) | version (1) | flags (1) | transfer id (4) | sequence (4) |
+ *      chunk size (4) | total size (8)
+ *
+ * The receiver learns the total size from the first chunk it gets, and then 
+ * copies each chunk's payload from the ZCO straight into its final position
+ * of the output. A bitmap tracks which chunks have been received so that
+ * duplicates are ignored and completion is detected.
+ * ============================================================================ */
+
+typedef struct {
+    unsigned int transfer_id;
+    unsigned int seq;
+    unsigned int chunk_size;
+    unsigned long long total_size;
+} StripeHeader;
+
+typedef struct {
+    unsigned int transfer_id;       // 0 until the first chunk is seen (if not provided)
+    unsigned long long total_size;
+    unsigned int chunk_size;
+    unsigned int num_chunks;
+    unsigned int received;
+    unsigned long long duplicates;
+    unsigned long long foreign;     // Bundles of other transfers or w/o valid header
+    unsigned char *bitmap;
+    PyObject *out_obj;              // Object returned to Python at the end
+    Py_buffer out_view;             // Only used if the output was provided by the user
+    int has_view;
+    char *out;                      // Memory where chunks are written
+} StripeRxState;
+
+static void stripe_pack_header(unsigned char *buf, StripeHeader *hdr) {
+    int i;
+    buf[0] = (STRIPE_MAGIC >> 8) & 0xFF;
+    buf[1] = STRIPE_MAGIC & 0xFF;
+    buf[2] = STRIPE_VERSION;
+    buf[3] = 0;
+    for (i = 0; i < 4; i++) {
+        buf[4+i]  = (hdr->transfer_id >> (24-8*i)) & 0xFF;
+        buf[8+i]  = (hdr->seq >> (24-8*i)) & 0xFF;
+        buf[12+i] = (hdr->chunk_size >> (24-8*i)) & 0xFF;
+    }
+    for (i = 0; i < 8; i++)
+        buf[16+i] = (hdr->total_size >> (56-8*i)) & 0xFF;
+}
+
+static int stripe_unpack_header(unsigned char *buf, StripeHeader *hdr) {
+    // Returns 0 if this is not a valid stripe header
+    int i;
+    if (((buf[0] << 8) | buf[1]) != STRIPE_MAGIC || buf[2] != STRIPE_VERSION)
+        return 0;
+
+    memset((char *)hdr, 0, sizeof(StripeHeader));
+    for (i = 0; i < 4; i++) {
+        hdr->transfer_id = (hdr->transfer_id << 8) | buf[4+i];
+        hdr->seq         = (hdr->seq << 8) | buf[8+i];
+        hdr->chunk_size  = (hdr->chunk_size << 8) | buf[12+i];
+    }
+    for (i = 0; i < 8; i++)
+        hdr->total_size = (hdr->total_size << 8) | buf[16+i];
+
+    return (hdr->chunk_size > 0 && hdr->total_size > 0);
+}
+
+static PyObject *pyion_bp_stripe_send(PyObject *self, PyObject *args) {
+    // Define variables
+    PyObject *py_saps, *py_dests, *item;
+    BpSapState **states = NULL;
+    char **dests = NULL;
+    BpSendParams prm;
+    BpTracker *tracker;
+    BpBundleHandle handle;
+    StripeHeader hdr;
+    unsigned char hdr_buf[STRIPE_HDR_SIZE];
+    Py_buffer data;
+    Py_ssize_t chunk_size, nsaps, ndests, i;
+    unsigned long long num_chunks, n;
+    size_t offset, len;
+    SendResultEnum res = SEND_OK;
+    int err_code = 0;
+
+    // Parse input arguments
+    if (!PyArg_ParseTuple(args, "O!O!ziiiiiiIkIny*", &PyTuple_Type, &py_saps, &PyTuple_Type,
+                          &py_dests, &prm.reportEid, &prm.ttl, &prm.classOfService,
+                          &prm.ordinal, (int *)&prm.custodySwitch, &prm.rrFlags, &prm.ackReq,
+                          &prm.retxTimer, (unsigned long *)&tracker, &hdr.transfer_id,
+                          &chunk_size, &data))
+        return NULL;
+
+    // Check validity of inputs
+    nsaps  = PyTuple_Size(py_saps);
+    ndests = PyTuple_Size(py_dests);
+    if (nsaps == 0 || ndests == 0 || chunk_size <= 0 || data.len == 0) {
+        PyBuffer_Release(&data);
+        pyion_SetExc(PyExc_ValueError, "Need endpoints, destinations, a positive chunk size and data.");
+        return NULL;
+    }
+    if (prm.ordinal < 0 || prm.ordinal > MAX_ORDINAL || (unsigned long long)chunk_size > 0xFFFFFFFFULL) {
+        PyBuffer_Release(&data);
+        pyion_SetExc(PyExc_ValueError, "Invalid ordinal or chunk size.");
+        return NULL;
+    }
+
+    // Get the C representation of endpoints and destinations. The strings
+    // belong to the tuple, which is alive during this call.
+    states = (BpSapState **)malloc(nsaps*sizeof(BpSapState *));
+    dests  = (char **)malloc(ndests*sizeof(char *));
+    if (!states || !dests) {
+        pyion_SetExc(PyExc_MemoryError, "Cannot malloc for striped transfer.");
+        goto error;
+    }
+    for (i = 0; i < nsaps; i++) {
+        item = PyTuple_GET_ITEM(py_saps, i);
+        states[i] = (BpSapState *)PyLong_AsUnsignedLong(item);
+        if (PyErr_Occurred()) goto error;
+    }
+    for (i = 0; i < ndests; i++) {
+        dests[i] = (char *)PyUnicode_AsUTF8(PyTuple_GET_ITEM(py_dests, i));
+        if (!dests[i]) goto error;
+    }
+
+    // Fill the fields of the header common to all chunks
+    num_chunks = ((unsigned long long)data.len + chunk_size - 1)/chunk_size;
+    hdr.chunk_size = (unsigned int)chunk_size;
+    hdr.total_size = (unsigned long long)data.len;
+
+    // Send all chunks. This does not need Python, release the GIL.
+    tracker_acquire(tracker);
+    Py_BEGIN_ALLOW_THREADS
+    for (n = 0, offset = 0; n < num_chunks; n++, offset += len) {
+        // Build this chunk's header
+        hdr.seq = (unsigned int)n;
+        stripe_pack_header(hdr_buf, &hdr);
+        len = (size_t)data.len - offset;
+        if (len > (size_t)chunk_size) len = (size_t)chunk_size;
+
+        // Send it through the next endpoint and destination
+        prm.destEid = dests[n % ndests];
+        res = send_payload(states[n % nsaps], &prm, (char *)hdr_buf, STRIPE_HDR_SIZE,
+                           (char *)data.buf + offset, len, tracker, &handle, &err_code);
+        if (res != SEND_OK) break;
+    }
+    tracker_release(tracker);
+    Py_END_ALLOW_THREADS
+
+    // Handle error while sending
+    if (res != SEND_OK) {
+        send_set_exc(res, err_code);
+        goto error;
+    }
+
+    free(states);
+    free(dests);
+    PyBuffer_Release(&data);
+    return Py_BuildValue("K", num_chunks);
+
+error:
+    free(states);
+    free(dests);
+    PyBuffer_Release(&data);
+    return NULL;
+}
+
+static PyObject *pyion_bp_stripe_rx_open(PyObject *self, PyObject *args) {
+    // Define variables
+    StripeRxState *rx;
+    unsigned int transfer_id;
+    PyObject *out;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "IO", &transfer_id, &out))
+        return NULL;
+
+    // Allocate memory for state and initialize to zeros
+    rx = (StripeRxState *)malloc(sizeof(StripeRxState));
+    if (rx == NULL) {
+        pyion_SetExc(PyExc_RuntimeError, "Cannot malloc for stripe reassembly state.");
+        return NULL;
+    }
+    memset((char *)rx, 0, sizeof(StripeRxState));
+    rx->transfer_id = transfer_id;
+
+    // If the user provided the output, get a writable view to it.
+    if (out != Py_None) {
+        if (PyObject_GetBuffer(out, &(rx->out_view), PyBUF_WRITABLE|PyBUF_C_CONTIGUOUS) < 0) {
+            free(rx);
+            return NULL;
+        }
+        rx->has_view = 1;
+        rx->out      = (char *)rx->out_view.buf;
+        rx->out_obj  = out;
+        Py_INCREF(out);
+    }
+
+    return Py_BuildValue("k", rx);
+}
+
+static int stripe_rx_init(StripeRxState *rx, StripeHeader *hdr) {
+    /* Allocate the output and bitmap once the size of the transfer is known.
+       Must be called with the GIL. Returns 0 and sets exception on error. */
+    unsigned long long num_chunks = (hdr->total_size + hdr->chunk_size - 1)/hdr->chunk_size;
+
+    // Check the size of the output
+    if (num_chunks > 0xFFFFFFFFULL || (rx->has_view && (unsigned long long)rx->out_view.len < hdr->total_size)) {
+        pyion_SetExc(PyExc_BufferError, "Output cannot hold a striped transfer of %llu bytes.", hdr->total_size);
+        return 0;
+    }
+
+    // Allocate the bitmap
+    rx->bitmap = (unsigned char *)calloc((size_t)((num_chunks+7)/8), 1);
+    if (!rx->bitmap) {
+        pyion_SetExc(PyExc_MemoryError, "Cannot malloc for stripe bitmap.");
+        return 0;
+    }
+
+    // Allocate the output as a bytes object that will be returned to Python
+    if (!rx->has_view) {
+        rx->out_obj = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)hdr->total_size);
+        if (!rx->out_obj) {
+            free(rx->bitmap);
+            rx->bitmap = NULL;
+            return 0;
+        }
+        rx->out = PyBytes_AS_STRING(rx->out_obj);
+    }
+
+    // Store transfer information
+    rx->transfer_id = hdr->transfer_id;
+    rx->total_size  = hdr->total_size;
+    rx->chunk_size  = hdr->chunk_size;
+    rx->num_chunks  = (unsigned int)num_chunks;
+
+    return 1;
+}
+
+static int stripe_store(StripeRxState *rx, BpDelivery *dlv) {
+    /* Copy the chunk in a delivered bundle into the output. Returns 0 and 
+       sets exception on error. */
+    // Define variables
+    Sdr sdr = bp_get_sdr();
+    ZcoReader reader;
+    StripeHeader hdr;
+    unsigned char hdr_buf[STRIPE_HDR_SIZE];
+    unsigned long long offset, expected;
+    vast data_size, len = 0;
+    unsigned char mask;
+    int ok;
+
+    // Read the stripe header
+    if (!sdr_pybegin_xn(sdr)) return 0;
+    data_size = zco_source_data_length(sdr, dlv->adu);
+    zco_start_receiving(dlv->adu, &reader);
+    if (data_size >= STRIPE_HDR_SIZE)
+        len = zco_receive_source(sdr, &reader, STRIPE_HDR_SIZE, (char *)hdr_buf);
+    sdr_exit_xn(sdr);
+
+    // If this is not a chunk of the transfer being reassembled, ignore it
+    ok = (len == STRIPE_HDR_SIZE && stripe_unpack_header(hdr_buf, &hdr));
+    if (ok && rx->transfer_id) ok = (hdr.transfer_id == rx->transfer_id);
+    if (ok && rx->bitmap) ok = (hdr.total_size == rx->total_size && hdr.chunk_size == rx->chunk_size);
+    if (!ok) {
+        rx->foreign++;
+        return 1;
+    }
+
+    // If this is the first chunk, allocate memory
+    if (!rx->bitmap && !stripe_rx_init(rx, &hdr)) return 0;
+
+    // Check that chunk is consistent with the transfer
+    offset   = (unsigned long long)hdr.seq * rx->chunk_size;
+    expected = (hdr.seq + 1 == rx->num_chunks) ? rx->total_size - offset : rx->chunk_size;
+    if (hdr.seq >= rx->num_chunks || (unsigned long long)(data_size - STRIPE_HDR_SIZE) != expected) {
+        rx->foreign++;
+        return 1;
+    }
+
+    // If already received, ignore it
+    mask = (unsigned char)(1 << (hdr.seq & 7));
+    if (rx->bitmap[hdr.seq >> 3] & mask) {
+        rx->duplicates++;
+        return 1;
+    }
+
+    // Copy the payload to its final location. Note that other threads can
+    // store other chunks at the same time because they write on different
+    // regions of the output.
+    Py_BEGIN_ALLOW_THREADS
+    ok = sdr_begin_xn(sdr);
+    if (ok) {
+        zco_start_receiving(dlv->adu, &reader);
+        len = zco_receive_source(sdr, &reader, STRIPE_HDR_SIZE, (char *)hdr_buf);
+        if (len == STRIPE_HDR_SIZE)
+            len = zco_receive_source(sdr, &reader, (vast)expected, rx->out + offset);
+        ok = (sdr_end_xn(sdr) >= 0 && len == (vast)expected);
+    }
+    Py_END_ALLOW_THREADS
+
+    if (!ok) {
+        pyion_SetExc(PyExc_IOError, "Error extracting chunk %u of striped transfer.", hdr.seq);
+        return 0;
+    }
+
+    // Mark the chunk as received. This happens with the GIL, so it is atomic
+    // with respect to other receiving threads.
+    if (rx->bitmap[hdr.seq >> 3] & mask) {
+        rx->duplicates++;
     } else {
-        state->status = EID_IDLE;
+        rx->bitmap[hdr.seq >> 3] |= mask;
+        rx->received++;
     }
 
-    // Return value
+    return 1;
+}
+
+static PyObject *pyion_bp_stripe_receive(PyObject *self, PyObject *args) {
+    // Define variables
+    StripeRxState *rx;
+    BpSapState *state;
+    BpDelivery dlv;
+    int ok;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kk", (unsigned long *)&rx, (unsigned long *)&state))
+        return NULL;
+
+    // Mark as running
+    sap_enter(state);
+
+    // Receive the next bundle and store it
+    ok = wait_for_bundle(state, &dlv);
+    if (ok) ok = stripe_store(rx, &dlv);
+
+    // Clean up tasks
+    bp_release_delivery(&dlv, 1);
+
+    // Acknowledge any interruption/closure. This can close the endpoint.
+    sap_leave(state);
+
+    // Return the number of chunks still missing
+    if (!ok) return NULL;
+    if (!rx->bitmap) return Py_BuildValue("i", -1);
+    return Py_BuildValue("I", rx->num_chunks - rx->received);
+}
+
+static PyObject *pyion_bp_stripe_rx_status(PyObject *self, PyObject *args) {
+    // Define variables
+    StripeRxState *rx;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&rx))
+        return NULL;
+
+    return Py_BuildValue("{s:I, s:K, s:I, s:I, s:I, s:K, s:K}",
+                         "transfer_id", rx->transfer_id,
+                         "total_size", rx->total_size,
+                         "chunk_size", rx->chunk_size,
+                         "num_chunks", rx->num_chunks,
+                         "received", rx->received,
+                         "duplicates", rx->duplicates,
+                         "foreign", rx->foreign);
+}
+
+static PyObject *pyion_bp_stripe_rx_close(PyObject *self, PyObject *args) {
+    // Define variables
+    StripeRxState *rx;
+    PyObject *ret;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&rx))
+        return NULL;
+
+    // Release the user's buffer, if any
+    if (rx->has_view) PyBuffer_Release(&(rx->out_view));
+
+    // Return the output only if all chunks were received
+    if (rx->bitmap && rx->received == rx->num_chunks) {
+        ret = rx->out_obj;
+    } else {
+        Py_XDECREF(rx->out_obj);
+        Py_INCREF(Py_None);
+        ret = Py_None;
+    }
+
+    // Free memory
+    free(rx->bitmap);
+    free(rx);
+
     return ret;
 }
 
 /* ============================================================================
  * === BP Report Parsing functionality
+ *
+ * Bundles requested with report flags (e.g., BP_RECEIVED_RPT) make other nodes
+ * send administrative records to the report-to endpoint. Decoding them in 
+ * Python does not keep up with high send rates. Therefore, ``bp_receive_reports``
+ * drains all records pending in the endpoint in a single GIL release, decodes
+ * them in C (RFC 5050 format, see section 6) and returns them as compact tuples.
+ *
+ * Status report:  type | status flags | reason | [frag offset | frag length] |
+ *                 one DTN time per status flag | creation time | creation count |
+ *                 source EID length | source EID
+ * Custody signal: type | status | [frag offset | frag length] | signal time |
+ *                 creation time | creation count | source EID length | source EID
+ *
+ * Integers are SDNVs and DTN times are (seconds, nanoseconds) SDNV pairs.
  * ============================================================================ */
 
-// TODO
\ No newline at end of file
+// A decoded administrative record
+typedef struct {
+    int kind;                           // ADMIN_STATUS_REPORT or ADMIN_CUSTODY_SIGNAL
+    char sourceEid[MAX_RPT_EID_LEN+1];  // Source EID of the subject bundle
+    uvast creationTime;                 // Creation time of the subject bundle
+    uvast creationCount;                // Creation sequence number of the subject bundle
+    uvast fragOffset;
+    uvast fragLength;
+    unsigned int flags;                 // SR: status flags. CS: 1 if custody accepted
+    unsigned int reason;
+    uvast time;                         // SR: time of the last status asserted. CS: signal time
+} BpAdminRecord;
+
+static int decode_sdnv(unsigned char **cursor, unsigned char *end, uvast *value) {
+    // Returns 0 if the SDNV is truncated or too long
+    unsigned char *c = *cursor;
+    int n = 0;
+
+    *value = 0;
+    while (c < end && n < 10) {
+        *value = (*value << 7) | (*c & 0x7F);
+        n++;
+        if ((*c++ & 0x80) == 0) {
+            *cursor = c;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static int decode_admin_record(unsigned char *buf, size_t len, BpAdminRecord *rec) {
+    /* Decode an administrative record. Returns 0 if it is not a status report
+       or custody signal, or if it is malformed. */
+    // Define variables
+    unsigned char *c = buf, *end = buf + len;
+    uvast seconds, nanosec, eid_len;
+    int is_fragment, flag;
+
+    // Check that there is enough data for type and status
+    if (len < 3) return 0;
+    memset((char *)rec, 0, sizeof(BpAdminRecord));
+
+    // Get record type and flags
+    rec->kind   = (*c >> 4) & 0x0F;
+    is_fragment = (*c++ & ADMIN_FOR_FRAGMENT);
+
+    // Get status (and reason)
+    if (rec->kind == ADMIN_STATUS_REPORT) {
+        rec->flags  = *c++;
+        rec->reason = *c++;
+    } else if (rec->kind == ADMIN_CUSTODY_SIGNAL) {
+        rec->flags  = (*c & 0x80) ? 1 : 0;
+        rec->reason = *c++ & 0x7F;
+    } else {
+        return 0;
+    }
+
+    // Get fragment information
+    if (is_fragment) {
+        if (!decode_sdnv(&c, end, &(rec->fragOffset))) return 0;
+        if (!decode_sdnv(&c, end, &(rec->fragLength))) return 0;
+    }
+
+    // Get times. Status reports have one for each status flag set. Keep the last.
+    if (rec->kind == ADMIN_STATUS_REPORT) {
+        for (flag = BP_RECEIVED_RPT; flag <= BP_DELETED_RPT; flag <<= 1) {
+            if (!(rec->flags & flag)) continue;
+            if (!decode_sdnv(&c, end, &seconds)) return 0;
+            if (!decode_sdnv(&c, end, &nanosec)) return 0;
+            rec->time = seconds;
+        }
+    } else {
+        if (!decode_sdnv(&c, end, &seconds)) return 0;
+        if (!decode_sdnv(&c, end, &nanosec)) return 0;
+        rec->time = seconds;
+    }
+
+    // Get the ID of the subject bundle
+    if (!decode_sdnv(&c, end, &(rec->creationTime))) return 0;
+    if (!decode_sdnv(&c, end, &(rec->creationCount))) return 0;
+    if (!decode_sdnv(&c, end, &eid_len)) return 0;
+    if (eid_len > MAX_RPT_EID_LEN || eid_len > (uvast)(end - c)) return 0;
+    memcpy(rec->sourceEid, c, (size_t)eid_len);
+    rec->sourceEid[eid_len] = '\0';
+
+    return 1;
+}
+
+static int read_admin_record(Sdr sdr, BpDelivery *dlv, BpAdminRecord *rec) {
+    /* Extract the payload of a delivered admin record and decode it. Does not
+       require the GIL. Returns -1 on SDR error, 0 if not a valid record. */
+    // Define variables
+    unsigned char prealloc_payload[MAX_PREALLOC_BUFFER];
+    unsigned char *payload = prealloc_payload;
+    ZcoReader reader;
+    vast data_size, len;
+    int ok;
+
+    // Get the payload
+    if (!sdr_begin_xn(sdr)) return -1;
+    data_size = zco_source_data_length(sdr, dlv->adu);
+    if (data_size > MAX_PREALLOC_BUFFER) payload = (unsigned char *)malloc(data_size);
+    if (!payload) {
+        sdr_exit_xn(sdr);
+        return -1;
+    }
+    zco_start_receiving(dlv->adu, &reader);
+    len = zco_receive_source(sdr, &reader, data_size, (char *)payload);
+    if (sdr_end_xn(sdr) < 0 || len < 0) {
+        if (payload != prealloc_payload) free(payload);
+        return -1;
+    }
+
+    // Decode it
+    ok = decode_admin_record(payload, (size_t)len, rec);
+    if (payload != prealloc_payload) free(payload);
+
+    return ok;
+}
+
+static void tracker_apply(BpTracker *t, BpAdminRecord *rec) {
+    // Update the index with a custody signal or status report
+    BpBundleHandle id = {rec->creationTime, rec->creationCount};
+    BpTrackedBundle *b;
+    int done = 0, failed = 0;
+
+    if (rec->kind == ADMIN_STATUS_REPORT) {
+        done   = (rec->flags & t->done_flags) != 0;
+        failed = !done && (rec->flags & BP_DELETED_RPT);
+    } else if (rec->kind == ADMIN_CUSTODY_SIGNAL) {
+        done = rec->flags && (t->done_flags & BP_CUSTODY_RPT);
+    }
+
+    pthread_mutex_lock(&(t->lock));
+    if (rec->kind == ADMIN_CUSTODY_SIGNAL && !rec->flags) t->refused++;
+    b = (done || failed) ? tracker_unlink(t, &id) : NULL;
+    if (b) {
+        if (done) {
+            t->completed++;
+            t->completed_bytes += b->size;
+        } else {
+            t->failed++;
+        }
+        pthread_cond_broadcast(&(t->changed));
+    }
+    pthread_mutex_unlock(&(t->lock));
+    free(b);
+}
+
+static void rpt_set_error(int err, int err_code) {
+    // Set the Python exception of an error of ``bp_receive_reports`` (RPT_DEFERRED_*)
+    switch (err) {
+    case RPT_DEFERRED_RECEIVE:
+        pyion_SetExc(PyExc_IOError, "Error receiving bundle through endpoint (err code=%d).", err_code);
+        break;
+    case RPT_DEFERRED_EXTRACT:
+        pyion_SetExc(PyExc_IOError, "Error extracting admin record from bundle.");
+        break;
+    case RPT_DEFERRED_INTERRUPT:
+        pyion_SetExc(PyExc_InterruptedError, "BP reception interrupted.");
+        break;
+    default:
+        pyion_SetExc(PyExc_ConnectionAbortedError, "BP reception closed.");
+        break;
+    }
+}
+
+static PyObject *pyion_bp_receive_reports(PyObject *self, PyObject *args) {
+    // Define variables
+    BpSapState *state;
+    BpDelivery dlv;
+    BpAdminRecord *recs;
+    unsigned int max_recs, nrecs = 0, i;
+    int timeout, rx_ret = 0, ok = 1, err = RPT_DEFERRED_NONE;
+    Sdr sdr = bp_get_sdr();
+    BpTracker *tracker;
+    SapStateEnum status;
+    PyObject *ret, *item;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kIik", (unsigned long *)&state, &max_recs, &timeout,
+                          (unsigned long *)&tracker))
+        return NULL;
+
+    // Raise the error that ended the previous batch, if any
+    if (state->rpt_deferred != RPT_DEFERRED_NONE) {
+        rpt_set_error(state->rpt_deferred, state->rpt_err_code);
+        state->rpt_deferred = RPT_DEFERRED_NONE;
+        return NULL;
+    }
+
+    // Allocate memory for the batch of records
+    if (max_recs == 0) max_recs = MAX_RPT_BATCH;
+    recs = (BpAdminRecord *)malloc(max_recs*sizeof(BpAdminRecord));
+    if (!recs) {
+        pyion_SetExc(PyExc_MemoryError, "Cannot malloc for BP admin records.");
+        return NULL;
+    }
+
+    // Mark as running
+    sap_enter(state);
+
+    // Receive admin records until the batch is full or none is pending. Only
+    // the first call to bp_receive blocks.
+    tracker_acquire(tracker);
+    Py_BEGIN_ALLOW_THREADS
+    while (sap_status(state) == EID_RUNNING && nrecs < max_recs) {
+        rx_ret = bp_receive(state->sap, &dlv, (nrecs == 0) ? timeout : BP_POLL);
+        if (rx_ret < 0) break;
+
+        // Spurious interruptions can happen (see ``wait_for_bundle``)
+        if (dlv.result == BpReceptionInterrupted) {
+            bp_release_delivery(&dlv, 1);
+            continue;
+        }
+
+        // If nothing else pending (or the endpoint was stopped), you are done
+        if (dlv.result != BpPayloadPresent) {
+            bp_release_delivery(&dlv, 1);
+            break;
+        }
+
+        // Decode the record. Other bundles in this endpoint are dropped.
+        if (dlv.adminRecord) {
+            ok = read_admin_record(sdr, &dlv, &(recs[nrecs]));
+            if (ok > 0 && tracker) tracker_apply(tracker, &(recs[nrecs]));
+            if (ok > 0) nrecs++;
+        }
+        bp_release_delivery(&dlv, 1);
+        if (ok < 0) break;
+    }
+    tracker_release(tracker);
+    Py_END_ALLOW_THREADS
+
+    // Find out why the batch ended. Records already applied to the tracker must
+    // not be lost, so if there are any, the error is raised on the next call (a
+    // closed endpoint is detected by ``Endpoint`` itself).
+    status = sap_status(state);
+    if (rx_ret < 0 && status == EID_RUNNING)
+        err = RPT_DEFERRED_RECEIVE;
+    else if (ok < 0)
+        err = RPT_DEFERRED_EXTRACT;
+    else if (status == EID_INTERRUPTING)
+        err = RPT_DEFERRED_INTERRUPT;
+    else if (status == EID_CLOSING)
+        err = RPT_DEFERRED_CLOSE;
+
+    if (err != RPT_DEFERRED_NONE && nrecs == 0) {
+        rpt_set_error(err, rx_ret);
+        ret = NULL;
+    } else {
+        if (err != RPT_DEFERRED_NONE && err != RPT_DEFERRED_CLOSE) {
+            state->rpt_deferred = err;
+            state->rpt_err_code = rx_ret;
+        }
+
+        // Build the list of records
+        ret = PyList_New(nrecs);
+        for (i = 0; ret && i < nrecs; i++) {
+            item = Py_BuildValue("(isKKKKIIK)", recs[i].kind, recs[i].sourceEid,
+                                 (unsigned long long)recs[i].creationTime,
+                                 (unsigned long long)recs[i].creationCount,
+                                 (unsigned long long)recs[i].fragOffset,
+                                 (unsigned long long)recs[i].fragLength,
+                                 recs[i].flags, recs[i].reason,
+                                 (unsigned long long)recs[i].time);
+            if (!item) {
+                Py_CLEAR(ret);
+                break;
+            }
+            PyList_SET_ITEM(ret, i, item);
+        }
+    }
+
+    // Clean up tasks
+    free(recs);
+
+    // Acknowledge any interruption/closure. This can close the endpoint.
+    sap_leave(state);
+
+    return ret;
+}
@@ -10,9 +10,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <cfdp.h>
 #include <Python.h>
 
+// States of a transaction (see ``CfdpProgress``)
+#define CFDP_TR_ACTIVE      0
+#define CFDP_TR_SUSPENDED   1
+#define CFDP_TR_FINISHED    2
+#define CFDP_TR_FAILED      3           // Abandoned, or finished with an error or incomplete data
+
+// Segmentation of a file in records (see ``read_records``)
+#define CFDP_RECORDS_NONE       0       // Let CFDP segment the file
+#define CFDP_RECORDS_DELIMITED  1       // Records end with a delimiter byte
+#define CFDP_RECORDS_FIXED      2       // Records of a fixed length
+
 /* ============================================================================
  * === _cfdp module definitions
  * ============================================================================ */
@@ -31,25 +46,158 @@ static char cfdp_open_docstring[] =
 static char cfdp_close_docstring[] =
     "Close a CFDP Entity object.";
 static char cfdp_send_docstring[] =
-    "Send a file to another host using CFDP.";
+    "Send a file to another host using CFDP.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the CFDP parameters\n"
+    "String [s]: Source file\n"
+    "String [z]: Destination file\n"
+    "Int [i]: Closure latency\n"
+    "Int [i]: Segment metadata\n"
+    "Long [l]: Mode\n"
+    "Tuple [O]: Optional. Pairs (condition, handler) of fault handlers. None for defaults\n"
+    "Bytes [y*]: Optional. Flow label\n"
+    "Int [i]: Optional. Record format (CFDP_RECORDS_*)\n"
+    "Int [I]: Optional. Delimiter byte, or record length\n"
+    "Int [I]: Optional. Max segment length with records\n"
+    "Return\n"
+    "------\n"
+    "Tuple (source entity nbr, transaction nbr) of the new transaction";
 static char cfdp_request_docstring[] =
-    "Request a file from another host using CFDP.";
+    "Request a file from another host using CFDP.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the CFDP parameters\n"
+    "String [s]: Source file\n"
+    "String [z]: Destination file\n"
+    "Int [i]: Closure latency\n"
+    "Int [i]: Segment metadata\n"
+    "Long [l]: Mode\n"
+    "Tuple [O]: Optional. Pairs (condition, handler) of fault handlers. None for defaults\n"
+    "Bytes [y*]: Optional. Flow label\n"
+    "Int [i]: Optional. 1 to request the file in unacknowledged mode (default)\n"
+    "Int [i]: Optional. 1 to request that record boundaries are respected\n"
+    "Return\n"
+    "------\n"
+    "Tuple (source entity nbr, transaction nbr) of the new transaction";
 static char cfdp_cancel_docstring[] =
-    "Cancel a CFDP transaction.";
+    "Cancel a CFDP transaction. If no transaction is given, cancel the last one.";
 static char cfdp_suspend_docstring[] =
-    "Suspend a CFDP transaction.";
+    "Suspend a CFDP transaction. If no transaction is given, suspend the last one.";
 static char cfdp_resume_docstring[] =
-    "Resume a CFDP transaction.";
+    "Resume a CFDP transaction. If no transaction is given, resume the last one.";
 static char cfdp_report_docstring[] =
-    "Report a CFDP transaction.";
+    "Report a CFDP transaction. If no transaction is given, report the last one.";
 static char cfdp_add_usr_msg_docstring[] =
-    "Add a user message to the next CFDP transaction.";
+    "Add a user message to the next CFDP transaction. Bytes-like messages are\n"
+    "sent as is, str messages are encoded as UTF-8 and null-terminated.";
+static char cfdp_add_usr_msgs_docstring[] =
+    "Add several user messages to the next CFDP transaction.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the CFDP parameters\n"
+    "Sequence [O]: User messages (see ``cfdp_add_usr_msg``). All of them are\n"
+    "              validated before any is added.";
 static char cfdp_add_fs_req_docstring[] =
-    "Add a user message to the next CFDP transaction.";    
+    "Add a filestore request to the next CFDP transaction.";
+static char cfdp_add_fs_reqs_docstring[] =
+    "Add several filestore requests to the next CFDP transaction.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the CFDP parameters\n"
+    "Sequence [O]: Tuples (action, first path, second path or None)";
 static char cfdp_next_evs_docstring[] =
-    "Handle CFDP events.";    
+    "Handle CFDP events.\n"
+    "Return\n"
+    "------\n"
+    "Tuple (event type, event parameters, (source entity nbr, transaction nbr))";    
 static char cfdp_interrupt_evs_docstring[] =
     "Handle CFDP events.";    
+static char cfdp_dispatcher_start_docstring[] =
+    "Start a thread that consumes all CFDP events of this node, and routes them to\n"
+    "the entity that owns their transaction.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [K]: Optional. Entity number of this node to hold the events of its\n"
+    "          transactions that are not routed until they are recovered (see\n"
+    "          ``cfdp_dispatcher_route`` and ``cfdp_dispatcher_release``). 0 to\n"
+    "          dispatch them right away (default)\n"
+    "Return\n"
+    "------\n"
+    "Long [k]: Memory address of the dispatcher";
+static char cfdp_dispatcher_stop_docstring[] =
+    "Stop the dispatcher thread. Calls waiting for events raise ConnectionAbortedError.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the dispatcher";
+static char cfdp_dispatcher_close_docstring[] =
+    "Free a stopped dispatcher and all its pending events.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the dispatcher";
+static char cfdp_dispatcher_next_docstring[] =
+    "Wait for the next CFDP event routed by the dispatcher.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the dispatcher\n"
+    "Double [d]: Timeout [sec]. Negative to wait forever\n"
+    "Return\n"
+    "------\n"
+    "Tuple (entity nbr, (event type, event parameters, (source entity nbr, transaction nbr)))";
+static char cfdp_dispatcher_next_many_docstring[] =
+    "Wait for CFDP events routed by the dispatcher, and drain up to a max number\n"
+    "of them at once.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the dispatcher\n"
+    "Int [I]: Max number of events to return\n"
+    "Double [d]: Timeout [sec]. Negative to wait forever\n"
+    "Return\n"
+    "------\n"
+    "List of tuples as in ``cfdp_dispatcher_next``. Events that cannot be converted\n"
+    "are dropped with a RuntimeWarning.";
+static char cfdp_dispatcher_aggregate_docstring[] =
+    "Coalesce the file segment indications of each transaction into a periodic\n"
+    "CfdpSegmentsSummaryInd with its progress and the extents of the file received.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the dispatcher\n"
+    "Double [d]: Time between summaries [sec]. Zero or negative to disable";
+static char cfdp_dispatcher_progress_docstring[] =
+    "Snapshot of the progress of the CFDP transactions seen by the dispatcher.\n"
+    "Transactions are kept for a minute after they end.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the dispatcher\n"
+    "Long [K]: Optional. Source entity number of a transaction\n"
+    "Long [K]: Optional. Transaction number of a transaction\n"
+    "Return\n"
+    "------\n"
+    "List of dictionaries, one per transaction";
+static char cfdp_dispatcher_route_docstring[] =
+    "Route the events of a transaction started before (e.g., by a previous process)\n"
+    "to an entity, and track its progress.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the dispatcher\n"
+    "Long [K]: Source entity number of the transaction\n"
+    "Long [K]: Transaction number\n"
+    "Long [K]: Entity number";
+static char cfdp_dispatcher_release_docstring[] =
+    "Stop holding the events of transactions that are not routed, and dispatch\n"
+    "the ones held so far.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the dispatcher";
+static char cfdp_dispatcher_stats_docstring[] =
+    "Get the statistics of the dispatcher.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the dispatcher\n"
+    "Return\n"
+    "------\n"
+    "Dict with the events dispatched/queued/held, the transactions routed, and\n"
+    "whether getting events fails (``error``, it is retried) and how many times";
 
 // Declare the functions to wrap
 static PyObject *pyion_cfdp_attach(PyObject *self, PyObject *args);
@@ -64,8 +212,20 @@ static PyObject *pyion_cfdp_resume(PyObject *self, PyObject *args);
 static PyObject *pyion_cfdp_report(PyObject *self, PyObject *args);
 static PyObject *pyion_cfdp_add_usr_msg(PyObject *self, PyObject *args);
 static PyObject *pyion_cfdp_add_fs_req(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_add_usr_msgs(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_add_fs_reqs(PyObject *self, PyObject *args);
 static PyObject *pyion_cfdp_next_events(PyObject *self, PyObject *args);
 static PyObject *pyion_cfdp_interrupt_events(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_start(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_stop(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_close(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_next(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_next_many(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_aggregate(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_progress(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_route(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_release(PyObject *self, PyObject *args);
+static PyObject *pyion_cfdp_dispatcher_stats(PyObject *self, PyObject *args);
 
 // Define member functions of this module
 static PyMethodDef module_methods[] = {
@@ -81,8 +241,20 @@ static PyMethodDef module_methods[] = {
     {"cfdp_report", pyion_cfdp_report, METH_VARARGS, cfdp_report_docstring},
     {"cfdp_add_usr_msg", pyion_cfdp_add_usr_msg, METH_VARARGS, cfdp_add_usr_msg_docstring},
     {"cfdp_add_filestore_request", pyion_cfdp_add_fs_req, METH_VARARGS, cfdp_add_fs_req_docstring},
+    {"cfdp_add_usr_msgs", pyion_cfdp_add_usr_msgs, METH_VARARGS, cfdp_add_usr_msgs_docstring},
+    {"cfdp_add_filestore_requests", pyion_cfdp_add_fs_reqs, METH_VARARGS, cfdp_add_fs_reqs_docstring},
     {"cfdp_next_event", pyion_cfdp_next_events, METH_VARARGS, cfdp_next_evs_docstring},
     {"cfdp_interrupt_events", pyion_cfdp_interrupt_events, METH_VARARGS, cfdp_interrupt_evs_docstring},
+    {"cfdp_dispatcher_start", pyion_cfdp_dispatcher_start, METH_VARARGS, cfdp_dispatcher_start_docstring},
+    {"cfdp_dispatcher_stop", pyion_cfdp_dispatcher_stop, METH_VARARGS, cfdp_dispatcher_stop_docstring},
+    {"cfdp_dispatcher_close", pyion_cfdp_dispatcher_close, METH_VARARGS, cfdp_dispatcher_close_docstring},
+    {"cfdp_dispatcher_next", pyion_cfdp_dispatcher_next, METH_VARARGS, cfdp_dispatcher_next_docstring},
+    {"cfdp_dispatcher_next_many", pyion_cfdp_dispatcher_next_many, METH_VARARGS, cfdp_dispatcher_next_many_docstring},
+    {"cfdp_dispatcher_aggregate", pyion_cfdp_dispatcher_aggregate, METH_VARARGS, cfdp_dispatcher_aggregate_docstring},
+    {"cfdp_dispatcher_progress", pyion_cfdp_dispatcher_progress, METH_VARARGS, cfdp_dispatcher_progress_docstring},
+    {"cfdp_dispatcher_route", pyion_cfdp_dispatcher_route, METH_VARARGS, cfdp_dispatcher_route_docstring},
+    {"cfdp_dispatcher_release", pyion_cfdp_dispatcher_release, METH_VARARGS, cfdp_dispatcher_release_docstring},
+    {"cfdp_dispatcher_stats", pyion_cfdp_dispatcher_stats, METH_VARARGS, cfdp_dispatcher_stats_docstring},
     {NULL, NULL, 0, NULL}
 };
 
@@ -122,6 +294,25 @@ PyMODINIT_FUNC PyInit__cfdp(void) {
     PyModule_AddIntConstant(module, "CfdpReportInd", CfdpReportInd);
     PyModule_AddIntConstant(module, "CfdpFaultInd", CfdpFaultInd);
     PyModule_AddIntConstant(module, "CfdpAbandonedInd", CfdpAbandonedInd);
+    PyModule_AddIntConstant(module, "CfdpSegmentsSummaryInd", 101);
+
+    // Add states of a transaction (see ``cfdp_dispatcher_progress``)
+    PyModule_AddIntConstant(module, "CFDP_TR_ACTIVE", CFDP_TR_ACTIVE);
+    PyModule_AddIntConstant(module, "CFDP_TR_SUSPENDED", CFDP_TR_SUSPENDED);
+    PyModule_AddIntConstant(module, "CFDP_TR_FINISHED", CFDP_TR_FINISHED);
+    PyModule_AddIntConstant(module, "CFDP_TR_FAILED", CFDP_TR_FAILED);
+
+    // Add fault handlers
+    PyModule_AddIntConstant(module, "CfdpNoHandler", CfdpNoHandler);
+    PyModule_AddIntConstant(module, "CfdpCancel", CfdpCancel);
+    PyModule_AddIntConstant(module, "CfdpSuspend", CfdpSuspend);
+    PyModule_AddIntConstant(module, "CfdpIgnore", CfdpIgnore);
+    PyModule_AddIntConstant(module, "CfdpAbandon", CfdpAbandon);
+
+    // Add record formats
+    PyModule_AddIntConstant(module, "CFDP_RECORDS_NONE", CFDP_RECORDS_NONE);
+    PyModule_AddIntConstant(module, "CFDP_RECORDS_DELIMITED", CFDP_RECORDS_DELIMITED);
+    PyModule_AddIntConstant(module, "CFDP_RECORDS_FIXED", CFDP_RECORDS_FIXED);
     
     // Add CFDP Condition
     PyModule_AddIntConstant(module, "CfdpNoError", CfdpNoError);
@@ -165,10 +356,177 @@ PyMODINIT_FUNC PyInit__cfdp(void) {
     return module;
 }
 
+/* ============================================================================
+ * === Define global variables
+ * ============================================================================ */
+
+// Max length of a user message [bytes]. CFDP encodes it in one byte.
+#define MAX_USR_MSG_LEN 255
+
+// Number of buckets of the transaction routes of the event dispatcher
+#define MAX_CFDP_ROUTES 1024
+
+// Max length of a file segment made of records [bytes]
+#define MAX_RECORD_SEGMENT 65536
+
+// Time between checks for Python signals while waiting for an event [nsec]
+#define EVENT_WAIT_SLICE 100000000L
+
+// Max time between retries of ``cfdp_get_event`` after it fails [nsec]. The
+// first retry waits EVENT_WAIT_SLICE, and each one after that doubles it.
+#define EVENT_RETRY_MAX 5000000000LL
+
+// Summary of the file segments received in a transaction (not an ION event,
+// see ``cfdp_dispatcher_aggregate``). Keep in sync with PyInit__cfdp.
+#define CfdpSegmentsSummaryInd ((CfdpEventType)101)
+
+// Time the progress of a transaction is kept after it ends [sec]
+#define PROGRESS_LINGER 60.0
+
+// Min time between samples of the throughput of a transaction [sec]
+#define RATE_WINDOW 1.0
+
+// Max number of events held until the transactions are recovered (see ``held_push``)
+#define MAX_HELD_EVENTS 4096
+
 /* ============================================================================
  * === Define structures for this module
  * ============================================================================ */
 
+// Filestore response of a CfdpTransactionFinishedInd
+typedef struct {
+    CfdpAction action;
+    int status;
+} CfdpFsResponse;
+
+// Range [start, end) of bytes of a file
+typedef struct {
+    uvast start;
+    uvast end;
+} CfdpExtent;
+
+// A CFDP event, as returned by ``cfdp_get_event``
+typedef struct CfdpEvent {
+    CfdpEventType type;
+    uvast entityNbr;                    // Entity that owns the event (see ``route_event``)
+    uvast sourceEntityNbr;              // Transaction of the event
+    uvast transactionNbr;
+    uvast origSourceEntityNbr;          // Source entity of the originating transaction
+    char sourceFileName[256];
+    char destFileName[256];
+    uvast fileSize;
+    uvast offset;
+    unsigned int length;
+    CfdpCondition condition;
+    uvast progress;
+    CfdpFileStatus fileStatus;
+    CfdpDeliveryCode deliveryCode;
+    char statusReport[256];
+    unsigned char *usrMsgs;             // numUsrMsgs messages, one after the other
+    int *usrMsgLens;
+    int numUsrMsgs;
+    CfdpFsResponse *fsResps;
+    int numFsResps;
+
+    // Only for CfdpSegmentsSummaryInd
+    unsigned long long segments;        // Segments since the last summary
+    unsigned long long totalSegments;
+    uvast received;                     // Bytes received (without duplicates)
+    CfdpExtent *extents;
+    int numExtents;
+
+    struct CfdpEvent *next;
+} CfdpEvent;
+
+// File segments received in a transaction (see ``aggr_add``)
+typedef struct CfdpSegAggr {
+    uvast sourceEntityNbr;
+    uvast transactionNbr;
+    uvast entityNbr;
+    uvast fileSize;
+    unsigned long long segments;        // Segments since the last summary
+    unsigned long long totalSegments;
+    uvast received;                     // Bytes in ``extents``
+    CfdpExtent *extents;                // Sorted and disjoint
+    int numExtents;
+    int capExtents;
+    struct CfdpSegAggr *next;
+} CfdpSegAggr;
+
+// Progress of a transaction (see ``progress_event``). Times are monotonic [sec].
+typedef struct CfdpProgress {
+    uvast sourceEntityNbr;
+    uvast transactionNbr;
+    uvast entityNbr;
+    int inbound;                        // 1 if the file is received by this node
+    int state;                          // CFDP_TR_*
+    uvast fileSize;
+    uvast sent;                         // Bytes handed to the peer
+    uvast acked;                        // Bytes confirmed by the peer
+    uvast received;                     // Bytes of file segments received
+    unsigned long long events;
+    unsigned long long faults;
+    double first;                       // Time of the first event
+    double last;                        // Time of the last event
+    double rateTime;                    // Last sample of the throughput
+    uvast rateBytes;
+    double rate;                        // Throughput at the last sample [bytes/sec]
+    struct CfdpProgress *next;
+} CfdpProgress;
+
+// Entity that owns a transaction started by this node
+typedef struct CfdpRoute {
+    uvast sourceEntityNbr;
+    uvast transactionNbr;
+    uvast entityNbr;
+    struct CfdpRoute *next;
+} CfdpRoute;
+
+// Dispatcher of the CFDP events of this node (see ``cfdp_dispatcher``)
+typedef struct {
+    pthread_t thread;
+    int running;                        // 1 while the dispatcher must keep running
+    int error;                          // 1 while ``cfdp_get_event`` fails (it is retried)
+    unsigned long long errors;          // Number of failed calls to ``cfdp_get_event``
+    pthread_mutex_t lock;
+    pthread_cond_t ready;               // Signaled when an event is queued
+    CfdpEvent *head;
+    CfdpEvent *tail;
+    size_t queued;
+    unsigned long long events;
+
+    // Routes of transactions started by this node, indexed by transaction number
+    CfdpRoute *routes[MAX_CFDP_ROUTES];
+    size_t num_routes;
+
+    // Aggregation of file segment indications, indexed by transaction number
+    double aggr_interval;               // Time between summaries [sec]. 0 if disabled
+    struct timespec last_summary;
+    CfdpSegAggr *aggrs[MAX_CFDP_ROUTES];
+    size_t num_aggrs;
+    unsigned long long segments;        // Segment indications coalesced
+    unsigned long long summaries;
+
+    // Progress of the transactions, indexed by transaction number
+    CfdpProgress *progress[MAX_CFDP_ROUTES];
+    size_t num_progress;
+    double last_purge;
+
+    // Events of transactions started by this entity that are not routed, held
+    // until they are recovered (see ``cfdp_dispatcher_release``)
+    uvast hold_entity_nbr;              // Local entity number. 0 if events are not held
+    CfdpEvent *held_head;
+    CfdpEvent *held_tail;
+    size_t num_held;
+} CfdpDispatcher;
+
+// Record-bounded segmentation of a file (see ``read_records``)
+typedef struct {
+    int format;                         // CFDP_RECORDS_*
+    unsigned int arg;                   // Delimiter byte, or record length
+    unsigned int segmentLength;         // Max segment length [bytes]
+} CfdpRecordFormat;
+
 typedef struct {
 	CfdpHandler		    faultHandlers[16];
 	CfdpNumber		    destinationEntityNbr;
@@ -181,12 +539,10 @@ typedef struct {
 	MetadataList		msgsToUser;
 	MetadataList		fsRequests;
 	CfdpTransactionId	transactionId;
+	uvast				entityNbr;
+	CfdpDispatcher		*disp;		// Routes the events of its transactions (can be NULL)
 } CfdpReqParms;
 
-/* ============================================================================
- * === Define global variables
- * ============================================================================ */
-
 /* ============================================================================
  * === Attach/Detach Functions
  * ============================================================================ */
@@ -223,6 +579,7 @@ static PyObject *pyion_cfdp_open(PyObject *self, PyObject *args) {
     char err_msg[150];
     uvast entityId;
     int ttl, classOfService, ordinal, srrFlags, criticality;
+    CfdpDispatcher *disp = NULL;
 
     // Allocate memory for CFDP state variable
     CfdpReqParms *params = (CfdpReqParms*)malloc(sizeof(CfdpReqParms));
@@ -236,12 +593,14 @@ static PyObject *pyion_cfdp_open(PyObject *self, PyObject *args) {
     memset((char *)params, 0, sizeof(CfdpReqParms));
 
     // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "Kiiiii", (unsigned long long *)&entityId, &ttl, &classOfService,
-                          &ordinal, &srrFlags, &criticality))
+    if (!PyArg_ParseTuple(args, "Kiiiii|k", (unsigned long long *)&entityId, &ttl, &classOfService,
+                          &ordinal, &srrFlags, &criticality, (unsigned long *)&disp))
         return NULL;
 
     // Initialize variables
     cfdp_compress_number(&(params->destinationEntityNbr), entityId);
+    params->entityNbr = entityId;
+    params->disp      = disp;
     params->utParms.lifespan = ttl;
 	params->utParms.classOfService = classOfService;
     params->utParms.srrFlags = srrFlags;
@@ -275,25 +634,127 @@ static PyObject *pyion_cfdp_close(PyObject *self, PyObject *args) {
  * === Add user messages and filestore requests
  * ============================================================================ */
 
+typedef struct {
+    int action;
+    PyObject *first;                    // Paths encoded with the file system encoding
+    PyObject *second;                   // NULL if the request has no second path
+} CfdpFsReqItem;
+
+static PyObject *usr_msg_bytes(PyObject *msg) {
+    /* Get the bytes of a user message. Bytes-like messages are taken as is, and 
+       str messages are encoded as UTF-8 and null-terminated. Returns NULL (and 
+       sets the Python exception) if error. */
+    PyObject *bytes;
+    const char *str;
+    Py_ssize_t len;
+
+    // Get the message bytes
+    if (PyUnicode_Check(msg)) {
+        if (!(str = PyUnicode_AsUTF8AndSize(msg, &len))) return NULL;
+        bytes = PyBytes_FromStringAndSize(str, len + 1);
+    } else {
+        bytes = PyBytes_FromObject(msg);
+    }
+    if (!bytes) return NULL;
+
+    // Check its length
+    if (PyBytes_GET_SIZE(bytes) > MAX_USR_MSG_LEN) {
+        PyErr_Format(PyExc_ValueError, "User messages cannot exceed %d bytes", MAX_USR_MSG_LEN);
+        Py_DECREF(bytes);
+        return NULL;
+    }
+
+    return bytes;
+}
+
+static int parse_fs_req(PyObject *req, CfdpFsReqItem *item) {
+    /* Parse a filestore request (action, first path, second path or None). Paths 
+       can be str, bytes or path-like. Returns 0 (and sets the Python exception) 
+       if error. */
+    PyObject *py_first, *py_second = Py_None;
+
+    // Parse the request
+    item->first = item->second = NULL;
+    if (!PyTuple_Check(req)) {
+        PyErr_Format(PyExc_TypeError, "Filestore requests must be tuples, not %.100s", Py_TYPE(req)->tp_name);
+        return 0;
+    }
+    if (!PyArg_ParseTuple(req, "iO|O", &item->action, &py_first, &py_second)) return 0;
+    if (!PyUnicode_FSConverter(py_first, &item->first)) return 0;
+    if (py_second != Py_None && !PyUnicode_FSConverter(py_second, &item->second)) {
+        Py_CLEAR(item->first);
+        return 0;
+    }
+
+    return 1;
+}
+
+static int add_usr_msgs(CfdpReqParms *params, PyObject **msgs, Py_ssize_t num) {
+    /* Add already validated user messages to the next transaction. Returns 0 (and 
+       sets the Python exception) if error. */
+    Py_ssize_t i;
+    int ok;
+
+    // Create user message list if necessary, and add the messages
+    if (params->msgsToUser == 0)
+        params->msgsToUser = cfdp_create_usrmsg_list();
+    ok = params->msgsToUser != 0;
+    for (i = 0; ok && i < num; i++)
+        ok = cfdp_add_usrmsg(params->msgsToUser, (unsigned char *)PyBytes_AS_STRING(msgs[i]),
+                             (int)PyBytes_GET_SIZE(msgs[i])) >= 0;
+    if (!ok) PyErr_SetString(PyExc_RuntimeError, "Cannot add CFDP user message, check ion.log.");
+
+    return ok;
+}
+
+static int add_fs_reqs(CfdpReqParms *params, CfdpFsReqItem *reqs, Py_ssize_t num) {
+    /* Add already validated filestore requests to the next transaction. Returns 0 
+       (and sets the Python exception) if error. */
+    Py_ssize_t i;
+    int ok;
+
+    // Create a file request list if necessary, and add the requests
+    if (params->fsRequests == 0)
+        params->fsRequests = cfdp_create_fsreq_list();
+    ok = params->fsRequests != 0;
+    for (i = 0; ok && i < num; i++)
+        ok = cfdp_add_fsreq(params->fsRequests, (CfdpAction)reqs[i].action, PyBytes_AS_STRING(reqs[i].first),
+                            reqs[i].second ? PyBytes_AS_STRING(reqs[i].second) : NULL) >= 0;
+    if (!ok) PyErr_SetString(PyExc_RuntimeError, "Cannot add CFDP filestore request, check ion.log.");
+
+    return ok;
+}
+
+static void free_fs_reqs(CfdpFsReqItem *reqs, Py_ssize_t num) {
+    // Release the paths of the first num filestore requests
+    Py_ssize_t i;
+
+    for (i = 0; i < num; i++) {
+        Py_XDECREF(reqs[i].first);
+        Py_XDECREF(reqs[i].second);
+    }
+}
+
 static PyObject *pyion_cfdp_add_usr_msg(PyObject *self, PyObject *args) {
     // Define variables
     CfdpReqParms *params;
-    char *usrMsg;
+    PyObject *usrMsg, *bytes;
+    int ok;
 
     // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "kz", (unsigned long *)&params, &usrMsg))
+    if (!PyArg_ParseTuple(args, "kO", (unsigned long *)&params, &usrMsg))
         return NULL;
 
     // If no user message, return
-    if (usrMsg == NULL)
+    if (usrMsg == Py_None)
         Py_RETURN_NONE;
 
-    // Create user message list if necessary
-    if (params->msgsToUser == 0)
-        params->msgsToUser = cfdp_create_usrmsg_list();
-
     // Add user message
-    oK(cfdp_add_usrmsg(params->msgsToUser, (unsigned char *)usrMsg, strlen(usrMsg)+1));
+    if (!(bytes = usr_msg_bytes(usrMsg)))
+        return NULL;
+    ok = add_usr_msgs(params, &bytes, 1);
+    Py_DECREF(bytes);
+    if (!ok) return NULL;
 
     // Return True to indicate success
     Py_RETURN_NONE;
@@ -302,36 +763,437 @@ static PyObject *pyion_cfdp_add_usr_msg(PyObject *self, PyObject *args) {
 static PyObject *pyion_cfdp_add_fs_req(PyObject *self, PyObject *args) {
     // Define variables
     CfdpReqParms *params;
-    CfdpAction	action;
-    char		*firstPathName;
-	char		*secondPathName;
+    CfdpFsReqItem item;
+    PyObject *req;
+    int ok;
 
-    // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "kisz", (unsigned long *)&params, (int *)&action,
-                          &firstPathName, &secondPathName))
+    // Parse the input tuple (the request is the rest of it)
+    if (PyTuple_Size(args) < 1 || !PyArg_Parse(PyTuple_GET_ITEM(args, 0), "k", (unsigned long *)&params))
+        return NULL;
+    if (!(req = PyTuple_GetSlice(args, 1, PyTuple_Size(args))))
         return NULL;
-
-    // Create a file request list if necessary
-    if (params->fsRequests == 0)
-        params->fsRequests = cfdp_create_fsreq_list();
 
     // Add file request
-    oK(cfdp_add_fsreq(params->fsRequests, action, firstPathName, secondPathName));
+    ok = parse_fs_req(req, &item);
+    Py_DECREF(req);
+    if (!ok) return NULL;
+    ok = add_fs_reqs(params, &item, 1);
+    free_fs_reqs(&item, 1);
+    if (!ok) return NULL;
 
     // Return True to indicate success
     Py_RETURN_NONE;
 }
 
+static PyObject *pyion_cfdp_add_usr_msgs(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpReqParms *params;
+    PyObject *msgs, *seq, **items;
+    Py_ssize_t i, num;
+    int ok = 1;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kO", (unsigned long *)&params, &msgs))
+        return NULL;
+
+    // Get all messages. Lists and tuples are not copied.
+    if (!(seq = PySequence_Fast(msgs, "User messages must be a sequence")))
+        return NULL;
+    num = PySequence_Fast_GET_SIZE(seq);
+    if (!(items = PyMem_New(PyObject *, num > 0 ? num : 1))) {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+
+    // Validate all messages before attaching any, so that an invalid message 
+    // does not leave the previous ones attached to the next transaction
+    for (i = 0; ok && i < num; i++)
+        ok = (items[i] = usr_msg_bytes(PySequence_Fast_GET_ITEM(seq, i))) != NULL;
+    if (ok)
+        ok = add_usr_msgs(params, items, num);
+    else
+        i--;
+
+    // Release the messages
+    while (i-- > 0)
+        Py_DECREF(items[i]);
+    PyMem_Free(items);
+    Py_DECREF(seq);
+
+    if (!ok) return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_cfdp_add_fs_reqs(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpReqParms *params;
+    CfdpFsReqItem *items;
+    PyObject *reqs, *seq;
+    Py_ssize_t i, num;
+    int ok = 1;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kO", (unsigned long *)&params, &reqs))
+        return NULL;
+
+    // Get all requests. Lists and tuples are not copied.
+    if (!(seq = PySequence_Fast(reqs, "Filestore requests must be a sequence")))
+        return NULL;
+    num = PySequence_Fast_GET_SIZE(seq);
+    if (!(items = PyMem_New(CfdpFsReqItem, num > 0 ? num : 1))) {
+        Py_DECREF(seq);
+        return PyErr_NoMemory();
+    }
+
+    // Validate all requests before attaching any (see ``pyion_cfdp_add_usr_msgs``)
+    for (i = 0; ok && i < num; i++)
+        ok = parse_fs_req(PySequence_Fast_GET_ITEM(seq, i), &items[i]);
+    if (ok)
+        ok = add_fs_reqs(params, items, num);
+    else
+        i--;
+
+    // Release the requests
+    free_fs_reqs(items, i);
+    PyMem_Free(items);
+    Py_DECREF(seq);
+
+    if (!ok) return NULL;
+    Py_RETURN_NONE;
+}
+
+/* ============================================================================
+ * === Transaction Progress (see ``cfdp_dispatcher_progress``)
+ * ============================================================================ */
+
+static double monotonic_time(void) {
+    // Monotonic time [sec]
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec*1e-9;
+}
+
+static CfdpProgress **progress_find(CfdpDispatcher *disp, uvast sourceEntityNbr, uvast transactionNbr) {
+    /* Find the progress of a transaction. Returns the pointer to the link that
+       points to it (or to the NULL at the end of its bucket if unknown). Must be
+       called holding the lock. */
+    CfdpProgress **p = &(disp->progress[transactionNbr % MAX_CFDP_ROUTES]);
+
+    while (*p && !((*p)->sourceEntityNbr == sourceEntityNbr && (*p)->transactionNbr == transactionNbr))
+        p = &((*p)->next);
+
+    return p;
+}
+
+static CfdpProgress *progress_get(CfdpDispatcher *disp, uvast sourceEntityNbr, uvast transactionNbr,
+                                  uvast entityNbr, int inbound, double now) {
+    // Get (or create) the progress of a transaction. Must be called holding the lock.
+    CfdpProgress **p = progress_find(disp, sourceEntityNbr, transactionNbr);
+
+    if (*p) return *p;
+    if (!(*p = (CfdpProgress *)calloc(1, sizeof(CfdpProgress)))) return NULL;
+    (*p)->sourceEntityNbr = sourceEntityNbr;
+    (*p)->transactionNbr  = transactionNbr;
+    (*p)->entityNbr       = entityNbr;
+    (*p)->inbound         = inbound;
+    (*p)->first           = now;
+    (*p)->last            = now;
+    (*p)->rateTime        = now;
+    disp->num_progress++;
+
+    return *p;
+}
+
+static void progress_start(CfdpDispatcher *disp, CfdpTransactionId *transactionId,
+                           uvast entityNbr, const char *sourceFile) {
+    /* Track the progress of a transaction started by this node. ``sourceFile``
+       is NULL for requests. Must be called holding the lock. */
+    uvast sourceEntityNbr, transactionNbr;
+    CfdpProgress *p;
+    struct stat st;
+
+    cfdp_decompress_number(&sourceEntityNbr, &(transactionId->sourceEntityNbr));
+    cfdp_decompress_number(&transactionNbr, &(transactionId->transactionNbr));
+
+    p = progress_get(disp, sourceEntityNbr, transactionNbr, entityNbr, 0, monotonic_time());
+    if (p && sourceFile && stat(sourceFile, &st) == 0) p->fileSize = (uvast)st.st_size;
+}
+
+static uvast progress_bytes(CfdpProgress *p) {
+    // Bytes that count for the throughput of a transaction
+    return p->inbound ? p->received : p->sent;
+}
+
+static double progress_rate(CfdpProgress *p, double now, int update) {
+    /* Throughput of a transaction over the last RATE_WINDOW (at least). With
+       ``update``, it is stored as a new sample. */
+    double rate = p->rate;
+
+    if (now - p->rateTime < RATE_WINDOW) return rate;
+    rate = (progress_bytes(p) - p->rateBytes)/(now - p->rateTime);
+    if (update) {
+        p->rate      = rate;
+        p->rateTime  = now;
+        p->rateBytes = progress_bytes(p);
+    }
+
+    return rate;
+}
+
+static void progress_event(CfdpDispatcher *disp, CfdpEvent *ev) {
+    /* Update the progress of the transaction of an event. Transactions not
+       started by this node are tracked from their first file data received.
+       ION does not notify the segments sent, so outbound transactions progress 
+       with the EOF, the indications that report progress, and their end. Must 
+       be called holding the lock. */
+    CfdpProgress *p;
+    double now = monotonic_time();
+    int ok;
+
+    // Find the transaction, or track it if it is received by this node
+    p = *progress_find(disp, ev->sourceEntityNbr, ev->transactionNbr);
+    if (!p && (ev->type == CfdpMetadataRecvInd || ev->type == CfdpFileSegmentRecvInd ||
+               ev->type == CfdpEofRecvInd))
+        p = progress_get(disp, ev->sourceEntityNbr, ev->transactionNbr, ev->entityNbr, 1, now);
+    if (!p) return;
+
+    p->events++;
+    p->last = now;
+
+    switch ((int)ev->type) {
+    case CfdpMetadataRecvInd:
+        p->fileSize = ev->fileSize;
+        break;
+
+    case CfdpFileSegmentRecvInd:
+        p->received += ev->length;
+        break;
+
+    case CfdpEofSentInd:
+        if (p->fileSize > p->sent) p->sent = p->fileSize;
+        break;
+
+    case CfdpSuspendedInd:
+        p->state = CFDP_TR_SUSPENDED;
+        break;
+
+    case CfdpFaultInd:
+        p->faults++;
+        // fall through
+    case CfdpResumedInd:
+        if (p->state == CFDP_TR_SUSPENDED) p->state = CFDP_TR_ACTIVE;
+        if (!p->inbound && ev->progress > p->sent) p->sent = ev->progress;
+        break;
+
+    case CfdpTransactionFinishedInd:
+        // Faults handled by ignoring them (or suspending and resuming) still complete the file
+        ok = ev->condition == CfdpNoError && ev->deliveryCode == CfdpDataComplete;
+        p->state = ok ? CFDP_TR_FINISHED : CFDP_TR_FAILED;
+        if (!p->inbound && ok) p->sent = p->acked = p->fileSize;
+        break;
+
+    case CfdpAbandonedInd:
+        p->state = CFDP_TR_FAILED;
+        if (!p->inbound && ev->progress > p->sent) p->sent = ev->progress;
+        break;
+
+    default:
+        break;
+    }
+
+    progress_rate(p, now, 1);
+}
+
+static void progress_purge(CfdpDispatcher *disp, double now) {
+    // Forget the transactions that ended PROGRESS_LINGER ago. Must be called holding the lock.
+    CfdpProgress **p, *tmp;
+    int i;
+
+    if (now - disp->last_purge < RATE_WINDOW) return;
+    disp->last_purge = now;
+
+    for (i = 0; i < MAX_CFDP_ROUTES; i++) {
+        p = &(disp->progress[i]);
+        while (*p) {
+            if ((*p)->state >= CFDP_TR_FINISHED && now - (*p)->last > PROGRESS_LINGER) {
+                tmp = *p;
+                *p  = tmp->next;
+                free(tmp);
+                disp->num_progress--;
+            } else {
+                p = &((*p)->next);
+            }
+        }
+    }
+}
+
+static void progress_clear(CfdpDispatcher *disp) {
+    // Forget the progress of all transactions
+    CfdpProgress *p;
+    int i;
+
+    for (i = 0; i < MAX_CFDP_ROUTES; i++) {
+        while ((p = disp->progress[i]) != NULL) {
+            disp->progress[i] = p->next;
+            free(p);
+        }
+    }
+    disp->num_progress = 0;
+}
+
+/* ============================================================================
+ * === Transaction Routes (see ``cfdp_dispatcher``)
+ * ============================================================================ */
+
+static CfdpRoute **route_find(CfdpDispatcher *disp, uvast sourceEntityNbr, uvast transactionNbr) {
+    /* Find the route of a transaction. Returns the pointer to the link that
+       points to it (or to the NULL at the end of its bucket if unknown). Must be
+       called holding the lock. */
+    CfdpRoute **r = &(disp->routes[transactionNbr % MAX_CFDP_ROUTES]);
+
+    while (*r && !((*r)->sourceEntityNbr == sourceEntityNbr && (*r)->transactionNbr == transactionNbr))
+        r = &((*r)->next);
+
+    return r;
+}
+
+static int route_set(CfdpDispatcher *disp, uvast sourceEntityNbr, uvast transactionNbr, uvast entityNbr) {
+    /* Route the events of a transaction to an entity. Must be called holding
+       the lock. Returns 0 if error. */
+    CfdpRoute *route, **r;
+
+    // If already routed, you are done
+    r = route_find(disp, sourceEntityNbr, transactionNbr);
+    if (*r) return 1;
+
+    // Create the new route
+    route = (CfdpRoute *)malloc(sizeof(CfdpRoute));
+    if (!route) return 0;
+    route->sourceEntityNbr = sourceEntityNbr;
+    route->transactionNbr  = transactionNbr;
+    route->entityNbr       = entityNbr;
+    route->next            = NULL;
+    *r = route;
+    disp->num_routes++;
+
+    return 1;
+}
+
+static int route_add(CfdpDispatcher *disp, CfdpTransactionId *transactionId, uvast entityNbr) {
+    // Route the events of a transaction just started. See ``route_set``.
+    uvast sourceEntityNbr, transactionNbr;
+
+    cfdp_decompress_number(&sourceEntityNbr, &(transactionId->sourceEntityNbr));
+    cfdp_decompress_number(&transactionNbr, &(transactionId->transactionNbr));
+
+    return route_set(disp, sourceEntityNbr, transactionNbr, entityNbr);
+}
+
+static void routes_lock(CfdpReqParms *params) {
+    /* Lock the routes of the dispatcher while a transaction is started, so that
+       it cannot dispatch its events before it is routed */
+    if (params->disp) pthread_mutex_lock(&(params->disp->lock));
+}
+
+static void routes_unlock(CfdpReqParms *params, int started, const char *sourceFile) {
+    /* Route the transaction just started (if any), track its progress and unlock
+       the routes. ``sourceFile`` is NULL for requests. */
+    if (!params->disp) return;
+    if (started) {
+        route_add(params->disp, &(params->transactionId), params->entityNbr);
+        progress_start(params->disp, &(params->transactionId), params->entityNbr, sourceFile);
+    }
+    pthread_mutex_unlock(&(params->disp->lock));
+}
+
 /* ============================================================================
  * === Send/Request Functions (and helpers)
  * ============================================================================ */
 
+static PyObject *transaction_key(CfdpTransactionId *transactionId) {
+    // Build the tuple (source entity nbr, transaction nbr) that identifies a transaction
+    uvast source_entity_nbr, transaction_nbr;
+
+    cfdp_decompress_number(&source_entity_nbr, &(transactionId->sourceEntityNbr));
+    cfdp_decompress_number(&transaction_nbr, &(transactionId->transactionNbr));
+
+    return Py_BuildValue("(KK)", (unsigned long long)source_entity_nbr,
+                                 (unsigned long long)transaction_nbr);
+}
+
 static int	noteSegmentTime(uvast fileOffset, unsigned int recordOffset,
 			unsigned int length, int sourceFileFd, char *buffer) {
 	writeTimestampLocal(getUTCTime(), buffer);
 	return strlen(buffer) + 1;
 }
 
+// Record format of the file being segmented by ``cfdp_put``. ION calls the reader
+// function synchronously within ``cfdp_put``, with the GIL held.
+static CfdpRecordFormat recordFormat;
+static unsigned char recordBuf[MAX_RECORD_SEGMENT];
+
+static int read_records(int fd, unsigned int *checksum) {
+    /* Reader function for ``cfdp_put``. Reads the next segment of the file as
+       the largest run of whole records that fits in the max segment length
+       (records longer than that are split), and adds it to the file checksum.
+       Returns the length of the segment, 0 at the end of file, or -1 if error. */
+    off_t start;
+    ssize_t num, len, i;
+
+    // Read as much as a segment can hold
+    if ((start = lseek(fd, 0, SEEK_CUR)) < 0) return -1;
+    num = read(fd, recordBuf, recordFormat.segmentLength);
+    if (num <= 0) return (int)num;
+    len = num;
+
+    // Cut the segment at the last record boundary, unless this is the end of file
+    if (num == recordFormat.segmentLength) {
+        if (recordFormat.format == CFDP_RECORDS_FIXED && num >= recordFormat.arg) {
+            len = (num / recordFormat.arg)*recordFormat.arg;
+        } else if (recordFormat.format == CFDP_RECORDS_DELIMITED) {
+            for (i = num; i > 0 && recordBuf[i-1] != (unsigned char)recordFormat.arg; i--);
+            if (i > 0) len = i;
+        }
+    }
+
+    // CFDP checksum: sum of the 32-bit words of the file, aligned to its start
+    for (i = 0; i < len; i++)
+        *checksum += (unsigned int)recordBuf[i] << (8*(3 - ((start + i) & 0x03)));
+
+    // Leave the file at the start of the next segment
+    if (lseek(fd, start + len, SEEK_SET) < 0) return -1;
+
+    return (int)len;
+}
+
+static int parse_fault_handlers(PyObject *py_handlers, CfdpHandler *handlers) {
+    /* Parse a sequence of (condition, handler) pairs into a table of fault
+       handlers indexed by condition. Returns 1 if any, 0 if None, or -1 (and
+       sets the Python exception) if error. */
+    PyObject *seq, *item;
+    Py_ssize_t i;
+    int condition, handler, ok = 1;
+
+    memset(handlers, 0, 16*sizeof(CfdpHandler));
+    if (!py_handlers || py_handlers == Py_None) return 0;
+    if (!(seq = PySequence_Fast(py_handlers, "Fault handlers must be a sequence of (condition, handler)")))
+        return -1;
+
+    for (i = 0; ok && i < PySequence_Fast_GET_SIZE(seq); i++) {
+        item = PySequence_Fast_GET_ITEM(seq, i);
+        ok = PyArg_ParseTuple(item, "ii", &condition, &handler);
+        if (ok && (condition < 0 || condition > 15 || handler < CfdpNoHandler || handler > CfdpAbandon)) {
+            PyErr_Format(PyExc_ValueError, "Invalid fault handler %d for condition %d", handler, condition);
+            ok = 0;
+        }
+        if (ok) handlers[condition] = (CfdpHandler)handler;
+    }
+    Py_DECREF(seq);
+
+    return ok ? 1 : -1;
+}
+
 static void setParams(CfdpReqParms *params, char *sourceFile, char *destFile, 
                       int segMetadata, int closureLat, long int mode) {
     // Fill in basic parameters
@@ -365,21 +1227,46 @@ static PyObject *pyion_cfdp_send(PyObject *self, PyObject *args) {
     char *destFile;
     int closureLat, segMetadata;
     long int mode;
+    PyObject *py_handlers = NULL;
+    Py_buffer flowLabel = {0};
+    CfdpRecordFormat format = {CFDP_RECORDS_NONE, 0, MAX_RECORD_SEGMENT};
+    int ok, handlers;
 
     // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "ksziil", (unsigned long *)&params, &sourceFile, 
-                          &destFile, &closureLat, &segMetadata, &mode))
+    if (!PyArg_ParseTuple(args, "ksziil|Oy*iII", (unsigned long *)&params, &sourceFile, 
+                          &destFile, &closureLat, &segMetadata, &mode, &py_handlers,
+                          &flowLabel, &(format.format), &(format.arg), &(format.segmentLength)))
         return NULL;
 
+    // Check the options of the put
+    ok = handlers = parse_fault_handlers(py_handlers, params->faultHandlers);
+    if (ok >= 0 && (format.segmentLength == 0 || format.segmentLength > MAX_RECORD_SEGMENT ||
+                    (format.format == CFDP_RECORDS_FIXED && format.arg == 0))) {
+        PyErr_Format(PyExc_ValueError, "Invalid record format (segments must have 1 to %d bytes)", 
+                     MAX_RECORD_SEGMENT);
+        ok = -1;
+    }
+    if (ok < 0) {
+        PyBuffer_Release(&flowLabel);
+        return NULL;
+    }
+
     // Store parameters
     setParams(params, sourceFile, destFile, segMetadata, closureLat, mode);
+    recordFormat = format;
 
     // Trigger the CFDP put
-    if (cfdp_put(&(params->destinationEntityNbr), sizeof(BpUtParms), 
-                 (unsigned char *) &(params->utParms), params->sourceFileName,
-				 params->destFileName, NULL, params->segMetadataFn,
-				 NULL, 0, NULL, params->closureLatency, params->msgsToUser,
-				 params->fsRequests, &(params->transactionId)) < 0){
+    routes_lock(params);
+    ok = cfdp_put(&(params->destinationEntityNbr), sizeof(BpUtParms), 
+                  (unsigned char *) &(params->utParms), params->sourceFileName,
+				  params->destFileName, format.format == CFDP_RECORDS_NONE ? NULL : read_records,
+				  params->segMetadataFn, handlers ? params->faultHandlers : NULL,
+				  (unsigned int)flowLabel.len, flowLabel.len ? (unsigned char *)flowLabel.buf : NULL,
+				  params->closureLatency, params->msgsToUser,
+				  params->fsRequests, &(params->transactionId));
+    routes_unlock(params, ok >= 0, params->sourceFileName);
+    PyBuffer_Release(&flowLabel);
+    if (ok < 0) {
         sprintf(err_msg, "Cannot do cfdp_put operation, check ion.log.");                     
         PyErr_SetString(PyExc_RuntimeError, err_msg);
         return NULL;
@@ -389,8 +1276,8 @@ static PyObject *pyion_cfdp_send(PyObject *self, PyObject *args) {
     params->msgsToUser = 0;
     params->fsRequests = 0;
 
-    // Return True to indicate success
-    Py_RETURN_NONE;
+    // Return the identifier of this transaction
+    return transaction_key(&(params->transactionId));
 }
 
 static PyObject *pyion_cfdp_request(PyObject *self, PyObject *args) {
@@ -402,12 +1289,23 @@ static PyObject *pyion_cfdp_request(PyObject *self, PyObject *args) {
     char *destFile;
     int closureLat, segMetadata;
     long int mode;
+    PyObject *py_handlers = NULL;
+    Py_buffer flowLabel = {0};
+    int unacknowledged = 1, recordBounds = 0;
+    int ok, handlers;
 
     // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "ksziil", (unsigned long *)&params, &sourceFile, 
-                          &destFile, &closureLat, &segMetadata, &mode))
+    if (!PyArg_ParseTuple(args, "ksziil|Oy*ii", (unsigned long *)&params, &sourceFile, 
+                          &destFile, &closureLat, &segMetadata, &mode, &py_handlers,
+                          &flowLabel, &unacknowledged, &recordBounds))
         return NULL;
 
+    // Parse the fault handlers for the peer's put
+    if ((handlers = parse_fault_handlers(py_handlers, params->faultHandlers)) < 0) {
+        PyBuffer_Release(&flowLabel);
+        return NULL;
+    }
+
     // Store parameters
     setParams(params, sourceFile, destFile, segMetadata, closureLat, mode);
 
@@ -416,17 +1314,21 @@ static PyObject *pyion_cfdp_request(PyObject *self, PyObject *args) {
     task.destFileName = params->destFileName;
     task.messagesToUser = params->msgsToUser;
     task.filestoreRequests = params->fsRequests;
-    task.faultHandlers = NULL;
-    task.unacknowledged = 1;
-    task.flowLabelLength = 0;
-    task.flowLabel = NULL;
-    task.recordBoundsRespected = 0;
+    task.faultHandlers = handlers ? params->faultHandlers : NULL;
+    task.unacknowledged = unacknowledged;
+    task.flowLabelLength = (unsigned int)flowLabel.len;
+    task.flowLabel = flowLabel.len ? (unsigned char *)flowLabel.buf : NULL;
+    task.recordBoundsRespected = recordBounds;
     task.closureRequested = !(params->closureLatency == 0);
 
     // Tigger CFDP get command
-    if (cfdp_get(&(params->destinationEntityNbr), sizeof(BpUtParms),
+    routes_lock(params);
+    ok = cfdp_get(&(params->destinationEntityNbr), sizeof(BpUtParms),
 					(unsigned char *) &(params->utParms), NULL, NULL, NULL, 
-                    NULL, 0, NULL, 0, 0, 0, &task, &(params->transactionId)) < 0) {
+                    NULL, 0, NULL, 0, 0, 0, &task, &(params->transactionId));
+    routes_unlock(params, ok >= 0, NULL);
+    PyBuffer_Release(&flowLabel);
+    if (ok < 0) {
         sprintf(err_msg, "Cannot do cfdp_get operation, check ion.log.");                     
         PyErr_SetString(PyExc_RuntimeError, err_msg);
         return NULL;
@@ -436,25 +1338,52 @@ static PyObject *pyion_cfdp_request(PyObject *self, PyObject *args) {
     params->msgsToUser = 0;
     params->fsRequests = 0;
 
-    // Return True to indicate success
-    Py_RETURN_NONE;
+    // Return the identifier of this transaction
+    return transaction_key(&(params->transactionId));
 }
 
 /* ============================================================================
  * === Cancel/Suspend/Resume/Report Functions
  * ============================================================================ */
 
+static int parse_transaction(PyObject *args, CfdpTransactionId *transactionId) {
+    /* Parse (params, [source entity nbr, transaction nbr]) into a transaction
+       identifier. If no transaction is given (or its number is 0), use the last
+       one started with these parameters. Returns 0 and sets the Python exception
+       if error. */
+    CfdpReqParms *params;
+    unsigned long long source_entity_nbr = 0, transaction_nbr = 0;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k|KK", (unsigned long *)&params, &source_entity_nbr,
+                          &transaction_nbr))
+        return 0;
+
+    // Use the last transaction by default
+    if (transaction_nbr == 0) {
+        *transactionId = params->transactionId;
+        return 1;
+    }
+
+    // Build the transaction identifier
+    memset((char *)transactionId, 0, sizeof(CfdpTransactionId));
+    cfdp_compress_number(&(transactionId->sourceEntityNbr), (uvast)source_entity_nbr);
+    cfdp_compress_number(&(transactionId->transactionNbr), (uvast)transaction_nbr);
+
+    return 1;
+}
+
 static PyObject *pyion_cfdp_cancel(PyObject *self, PyObject *args) {
     // Define variables
     char err_msg[150];
-    CfdpReqParms *params;
+    CfdpTransactionId transactionId;
 
     // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&params))
+    if (!parse_transaction(args, &transactionId))
         return NULL;
 
     // Trigger CFDP cancel
-    if (cfdp_cancel(&(params->transactionId)) < 0) {
+    if (cfdp_cancel(&transactionId) < 0) {
         sprintf(err_msg, "Cannot do cfdp_cancel operation, check ion.log.");                     
         PyErr_SetString(PyExc_RuntimeError, err_msg);
         return NULL;
@@ -467,14 +1396,14 @@ static PyObject *pyion_cfdp_cancel(PyObject *self, PyObject *args) {
 static PyObject *pyion_cfdp_suspend(PyObject *self, PyObject *args) {
     // Define variables
     char err_msg[150];
-    CfdpReqParms *params;
+    CfdpTransactionId transactionId;
 
     // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&params))
+    if (!parse_transaction(args, &transactionId))
         return NULL;
 
     // Trigger CFDP suspend
-    if (cfdp_suspend(&(params->transactionId)) < 0) {
+    if (cfdp_suspend(&transactionId) < 0) {
         sprintf(err_msg, "Cannot do cfdp_suspend operation, check ion.log.");                     
         PyErr_SetString(PyExc_RuntimeError, err_msg);
         return NULL;
@@ -487,14 +1416,14 @@ static PyObject *pyion_cfdp_suspend(PyObject *self, PyObject *args) {
 static PyObject *pyion_cfdp_resume(PyObject *self, PyObject *args) {
     // Define variables
     char err_msg[150];
-    CfdpReqParms *params;
+    CfdpTransactionId transactionId;
 
     // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&params))
+    if (!parse_transaction(args, &transactionId))
         return NULL;
 
     // Trigger CFDP resume
-    if (cfdp_resume(&(params->transactionId)) < 0) {
+    if (cfdp_resume(&transactionId) < 0) {
         sprintf(err_msg, "Cannot do cfdp_resume operation, check ion.log.");                     
         PyErr_SetString(PyExc_RuntimeError, err_msg);
         return NULL;
@@ -507,14 +1436,14 @@ static PyObject *pyion_cfdp_resume(PyObject *self, PyObject *args) {
 static PyObject *pyion_cfdp_report(PyObject *self, PyObject *args) {
     // Define variables
     char err_msg[150];
-    CfdpReqParms *params;
+    CfdpTransactionId transactionId;
 
     // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&params))
+    if (!parse_transaction(args, &transactionId))
         return NULL;
 
     // Trigger CFDP report
-    if (cfdp_report(&(params->transactionId)) < 0) {
+    if (cfdp_report(&transactionId) < 0) {
         sprintf(err_msg, "Cannot do cfdp_report operation, check ion.log.");                     
         PyErr_SetString(PyExc_RuntimeError, err_msg);
         return NULL;
@@ -528,216 +1457,964 @@ static PyObject *pyion_cfdp_report(PyObject *self, PyObject *args) {
  * === Handling of CFDP Events (see CCSDS CDFP, section 3.5.6 onwards)
  * ============================================================================ */
 
-static PyObject *pyion_cfdp_next_events(PyObject *self, PyObject *args) {
+static void event_free(CfdpEvent *ev) {
+    // Free an event and its user messages/filestore responses
+    free(ev->usrMsgs);
+    free(ev->usrMsgLens);
+    free(ev->fsResps);
+    free(ev->extents);
+    free(ev);
+}
+
+static int read_event(CfdpEvent *ev) {
+    /* Get the next CFDP event from ION and copy it into ``ev``, including its
+       user messages and filestore responses. This is a blocking call that does
+       not use the Python API, call it without holding the GIL. Returns -1 if
+       error. */
     // Define variables for cfdp_get_event
-    CfdpEventType type;
     time_t time;
     int reqNbr;
     CfdpTransactionId transactionId;
-	char sourceFileNameBuf[256];
-	char destFileNameBuf[256];
-    uvast			fileSize;
-	MetadataList		messagesToUser;
-	uvast			offset;
-	unsigned int		length;
-	unsigned int		recordBoundsRespected;
-	CfdpContinuationState	continuationState;
-	unsigned int		segMetadataLength;
-	char			segMetadata[63];
-	CfdpCondition		condition;
-	uvast			progress;
-	CfdpFileStatus		fileStatus;
-	CfdpDeliveryCode	deliveryCode;
-	CfdpTransactionId	originatingTransactionId;
-	char			statusReportBuf[256];
-	MetadataList		filestoreResponses;
-    
+    MetadataList messagesToUser;
+    unsigned int recordBoundsRespected;
+    CfdpContinuationState continuationState;
+    unsigned int segMetadataLength;
+    char segMetadata[63];
+    CfdpTransactionId originatingTransactionId;
+    MetadataList filestoreResponses;
+
     // Define other variables
-    char err_msg[150];
+    unsigned char usrmsgBuf[MAX_USR_MSG_LEN + 1];
+    size_t usrMsgsLen = 0;
+    char firstPathName[256], secondPathName[256], msgBuf[256];
+    CfdpFsResponse *resp;
+    void *tmp;
+    int length;
+
+    // Receive the next CFDP event. This is a blocking call
+    memset((char *)&transactionId, 0, sizeof(CfdpTransactionId));
+    memset((char *)&originatingTransactionId, 0, sizeof(CfdpTransactionId));
+    messagesToUser = filestoreResponses = 0;
+    if (cfdp_get_event(&(ev->type), &time, &reqNbr, &transactionId,
+                       ev->sourceFileName, ev->destFileName,
+                       &(ev->fileSize), &messagesToUser, &(ev->offset), &(ev->length),
+                       &recordBoundsRespected, &continuationState,
+                       &segMetadataLength, segMetadata,
+                       &(ev->condition), &(ev->progress), &(ev->fileStatus),
+                       &(ev->deliveryCode), &originatingTransactionId,
+                       ev->statusReport, &filestoreResponses) < 0)
+        return -1;
+
+    // Get the transaction of this event
+    cfdp_decompress_number(&(ev->sourceEntityNbr), &(transactionId.sourceEntityNbr));
+    cfdp_decompress_number(&(ev->transactionNbr), &(transactionId.transactionNbr));
+    cfdp_decompress_number(&(ev->origSourceEntityNbr), &(originatingTransactionId.sourceEntityNbr));
+
+    // Get all user messages (only with CfdpMetadataRecvInd)
+    while (ev->type == CfdpMetadataRecvInd && messagesToUser) {
+        if (cfdp_get_usrmsg(&messagesToUser, usrmsgBuf, &length) < 0) return -1;
+
+        // If empty message, continue
+        if (length <= 0) continue;
+
+        // Store the user message after the previous ones, with its length
+        if (length > MAX_USR_MSG_LEN) length = MAX_USR_MSG_LEN;
+        tmp = realloc(ev->usrMsgs, usrMsgsLen + length);
+        if (!tmp) return -1;
+        ev->usrMsgs = (unsigned char *)tmp;
+        tmp = realloc(ev->usrMsgLens, (ev->numUsrMsgs+1)*sizeof(int));
+        if (!tmp) return -1;
+        ev->usrMsgLens = (int *)tmp;
+        memcpy(ev->usrMsgs + usrMsgsLen, usrmsgBuf, length);
+        ev->usrMsgLens[ev->numUsrMsgs++] = length;
+        usrMsgsLen += length;
+    }
+
+    // Get all filestore responses (only with CfdpTransactionFinishedInd)
+    while (ev->type == CfdpTransactionFinishedInd && filestoreResponses) {
+        tmp = realloc(ev->fsResps, (ev->numFsResps+1)*sizeof(CfdpFsResponse));
+        if (!tmp) return -1;
+        ev->fsResps = (CfdpFsResponse *)tmp;
+        resp = &(ev->fsResps[ev->numFsResps]);
+        if (cfdp_get_fsresp(&filestoreResponses, &(resp->action), &(resp->status),
+                            firstPathName, secondPathName, msgBuf) < 0)
+            return -1;
+
+        // If no action, continue
+        if (resp->action == ((CfdpAction) -1)) continue;
+        ev->numFsResps++;
+    }
+
+    return 0;
+}
+
+static PyObject *event_params(CfdpEvent *ev) {
+    /* Build the tuple (event type, event parameters) of a CFDP event. Returns
+       NULL and sets the Python exception if error. */
+    // Define variables
+    unsigned long long transaction_id = (unsigned long long)ev->transactionNbr;
+    PyObject *py_list, *py_dict, *item, *key;
+    size_t len;
+    int i, ok;
+
+    switch ((int)ev->type) {
+    // If no event, just return
+    case CfdpNoEvent:
+        return Py_BuildValue("(i, z)", (int)CfdpNoEvent, NULL);
+
+    // Handle CfdpTransactionInd, CfdpEofSentInd and CfdpEofRecvInd
+    case CfdpTransactionInd:
+    case CfdpEofSentInd:
+    case CfdpEofRecvInd:
+        return Py_BuildValue("(i, {s:K})", (int)ev->type, "transaction_id", transaction_id);
+
+    // Handle CfdpSuspendedInd
+    case CfdpSuspendedInd:
+        return Py_BuildValue("(i, {s:i})", (int)CfdpSuspendedInd, "condition", (int)ev->condition);
+
+    // Handle CfdpResumedInd
+    case CfdpResumedInd:
+        return Py_BuildValue("(i, {s:K})", (int)CfdpResumedInd, "progress", (unsigned long long)ev->progress);
+
+    // Handle CfdpReportInd
+    case CfdpReportInd:
+        return Py_BuildValue("(i, {s:K, s:i})", (int)CfdpReportInd, "transaction_id", transaction_id,
+                                                "status", (int)ev->fileStatus);
+
+    // Handle CfdpFaultInd and CfdpAbandonedInd
+    case CfdpFaultInd:
+    case CfdpAbandonedInd:
+        return Py_BuildValue("(i, {s:K, s:i, s:K})", (int)ev->type, "transaction_id", transaction_id,
+                                                     "code", (int)ev->deliveryCode,
+                                                     "progress", (unsigned long long)ev->progress);
+
+    // Handle CfdpFileSegmentRecvInd
+    case CfdpFileSegmentRecvInd:
+        return Py_BuildValue("(i, {s:K, s:K, s:I})", (int)CfdpFileSegmentRecvInd,
+                                                     "transaction_id", transaction_id,
+                                                     "offset", (unsigned long long)ev->offset,
+                                                     "length", (unsigned int)ev->length);
+
+    // Handle CfdpMetadataRecvInd
+    case CfdpMetadataRecvInd:
+        // Build the list of user messages. They are returned as is, as bytes.
+        py_list = PyList_New(ev->numUsrMsgs);
+        for (i = 0, len = 0; py_list && i < ev->numUsrMsgs; len += ev->usrMsgLens[i++]) {
+            item = PyBytes_FromStringAndSize((char *)ev->usrMsgs + len, ev->usrMsgLens[i]);
+            if (!item) {
+                Py_CLEAR(py_list);
+                break;
+            }
+            PyList_SET_ITEM(py_list, i, item);
+        }
+        if (!py_list) return NULL;
+
+        // Build the return value. File names are decoded as ``os.fsdecode`` does,
+        // so that names that are not valid UTF-8 are not lost.
+        return Py_BuildValue("(i, {s:K, s:K, s:N, s:N, s:N})", 
+                            (int)CfdpMetadataRecvInd, 
+                            "transaction_id", transaction_id,
+                            "source_entity_id", (unsigned long long)ev->origSourceEntityNbr,
+                            "source_file_name", PyUnicode_DecodeFSDefault(ev->sourceFileName),
+                            "dest_file_name", PyUnicode_DecodeFSDefault(ev->destFileName),
+                            "user_messages", py_list);
+
+    // Handle CfdpTransactionFinishedInd. Its outcome is reported even if there are
+    // no filestore responses (keyed by action).
+    case CfdpTransactionFinishedInd:
+        py_dict = Py_BuildValue("{s:i, s:i}", "condition_code", (int)ev->condition,
+                                "delivery_code", (int)ev->deliveryCode);
+        for (i = 0; py_dict && i < ev->numFsResps; i++) {
+            // Build a value for this action and store it
+            item = Py_BuildValue("{s:N, s:i, s:i, s:i}", "status_report",
+                                 PyUnicode_DecodeUTF8(ev->statusReport, strlen(ev->statusReport), "replace"),
+                                 "condition_code", (int)ev->condition,
+                                 "file_status", ev->fsResps[i].status,
+                                 "delivery_code", (int)ev->deliveryCode);
+            key = PyLong_FromLong((long)ev->fsResps[i].action);
+            ok  = item && key && (PyDict_SetItem(py_dict, key, item) == 0);
+            Py_XDECREF(key);
+            Py_XDECREF(item);
+            if (!ok) Py_CLEAR(py_dict);
+        }
+        if (!py_dict) return NULL;
+
+        // Build return value
+        return Py_BuildValue("(i, N)", (int)CfdpTransactionFinishedInd, py_dict);
+
+    // Handle CfdpSegmentsSummaryInd
+    case CfdpSegmentsSummaryInd:
+        py_list = PyList_New(ev->numExtents);
+        for (i = 0; py_list && i < ev->numExtents; i++) {
+            item = Py_BuildValue("(KK)", (unsigned long long)ev->extents[i].start,
+                                         (unsigned long long)ev->extents[i].end);
+            if (!item) {
+                Py_CLEAR(py_list);
+                break;
+            }
+            PyList_SET_ITEM(py_list, i, item);
+        }
+        if (!py_list) return NULL;
+
+        return Py_BuildValue("(i, {s:K, s:K, s:K, s:K, s:K, s:N})", (int)CfdpSegmentsSummaryInd,
+                             "transaction_id", transaction_id,
+                             "segments", ev->segments,
+                             "total_segments", ev->totalSegments,
+                             "received", (unsigned long long)ev->received,
+                             "file_size", (unsigned long long)ev->fileSize,
+                             "extents", py_list);
+
+    default:
+        break;
+    }
+
+    // If you reach this point, you cannot process this event type
+    PyErr_SetString(PyExc_RuntimeError, "Unknown CFDP type.");
+    return NULL;
+}
+
+static PyObject *event_to_python(CfdpEvent *ev) {
+    /* Build the tuple (event type, event parameters, (source entity nbr, transaction nbr))
+       of a CFDP event. Returns NULL and sets the Python exception if error. */
+    PyObject *params = event_params(ev);
+    if (!params) return NULL;
+
+    return Py_BuildValue("(OO(KK))", PyTuple_GET_ITEM(params, 0), PyTuple_GET_ITEM(params, 1),
+                         (unsigned long long)ev->sourceEntityNbr,
+                         (unsigned long long)ev->transactionNbr);
+}
+
+static PyObject *pyion_cfdp_next_events(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpEvent *ev;
+    PyObject *ret;
     int rx_ret;
-    uvast transaction_id, source_entity_nbr;
+
+    // Allocate memory for the event
+    ev = (CfdpEvent *)calloc(1, sizeof(CfdpEvent));
+    if (!ev) return PyErr_NoMemory();
 
     // Receive the next CFDP event. This is a blocking call
     Py_BEGIN_ALLOW_THREADS                                // Release the GIL
-    rx_ret = cfdp_get_event(&type, &time, &reqNbr, &transactionId,
-				sourceFileNameBuf, destFileNameBuf,
-				&fileSize, &messagesToUser, &offset, &length,
-				&recordBoundsRespected, &continuationState,
-				&segMetadataLength, segMetadata,
-				&condition, &progress, &fileStatus,
-				&deliveryCode, &originatingTransactionId,
-				statusReportBuf, &filestoreResponses);
+    rx_ret = read_event(ev);
     Py_END_ALLOW_THREADS                                  // Acquire the GIL
 
     // If reception of event failed, return
     if (rx_ret < 0) {
-        sprintf(err_msg, "Failed while getting CFDP event, check ion.log.");                     
-        PyErr_SetString(PyExc_RuntimeError, err_msg);
+        event_free(ev);
+        PyErr_SetString(PyExc_RuntimeError, "Failed while getting CFDP event, check ion.log.");
         return NULL;
     }
 
-    // If no event, just return
-    if (type == CfdpNoEvent) {
-        return Py_BuildValue("(i, z)", (int)CfdpNoEvent, NULL);
+    // Build the return value
+    ret = event_to_python(ev);
+    event_free(ev);
+
+    return ret;
+}
+
+static PyObject *pyion_cfdp_interrupt_events(PyObject *self, PyObject *args) {   
+    // Interrupt CFDP event handler
+    cfdp_interrupt();
+
+    // Return None to indicate success
+    Py_RETURN_NONE;
+}
+
+/* ============================================================================
+ * === Aggregation of File Segment Indications
+ * ============================================================================ */
+
+static void queue_push(CfdpDispatcher *disp, CfdpEvent *ev) {
+    // Queue an event for the consumers. Must be called holding the lock.
+    if (disp->tail) disp->tail->next = ev; else disp->head = ev;
+    disp->tail = ev;
+    disp->queued++;
+    pthread_cond_broadcast(&(disp->ready));
+}
+
+static CfdpSegAggr **aggr_find(CfdpDispatcher *disp, uvast sourceEntityNbr, uvast transactionNbr) {
+    /* Find the segments received in a transaction. Returns the pointer to the
+       link that points to them (or to the NULL at the end of its bucket if
+       unknown). Must be called holding the lock. */
+    CfdpSegAggr **a = &(disp->aggrs[transactionNbr % MAX_CFDP_ROUTES]);
+
+    while (*a && !((*a)->sourceEntityNbr == sourceEntityNbr && (*a)->transactionNbr == transactionNbr))
+        a = &((*a)->next);
+
+    return a;
+}
+
+static CfdpSegAggr *aggr_get(CfdpDispatcher *disp, CfdpEvent *ev) {
+    // Get (or create) the segments received in the transaction of an event
+    CfdpSegAggr **a = aggr_find(disp, ev->sourceEntityNbr, ev->transactionNbr);
+
+    if (*a) return *a;
+    if (!(*a = (CfdpSegAggr *)calloc(1, sizeof(CfdpSegAggr)))) return NULL;
+    (*a)->sourceEntityNbr = ev->sourceEntityNbr;
+    (*a)->transactionNbr  = ev->transactionNbr;
+    (*a)->entityNbr       = ev->entityNbr;
+    disp->num_aggrs++;
+
+    return *a;
+}
+
+static void aggr_remove(CfdpDispatcher *disp, CfdpSegAggr **a) {
+    // Forget the segments received in a transaction
+    CfdpSegAggr *aggr = *a;
+
+    *a = aggr->next;
+    free(aggr->extents);
+    free(aggr);
+    disp->num_aggrs--;
+}
+
+static int extent_add(CfdpSegAggr *a, uvast offset, unsigned int length) {
+    /* Add the range [offset, offset+length) to the extents received, merging
+       it with the ones it overlaps or touches. Segments usually arrive in order,
+       so the search starts from the end. Returns 0 if error. */
+    uvast start = offset, end = offset + length;
+    CfdpExtent *tmp;
+    int i, j;
+
+    // Find the extents [i, j) that overlap or touch the new range
+    for (j = a->numExtents; j > 0 && a->extents[j-1].start > end; j--);
+    for (i = j; i > 0 && a->extents[i-1].end >= start; i--) {
+        if (a->extents[i-1].start < start) start = a->extents[i-1].start;
+        if (a->extents[i-1].end > end) end = a->extents[i-1].end;
+        a->received -= a->extents[i-1].end - a->extents[i-1].start;
     }
 
-    // Handle CfdpTransactionInd
-    if (type == CfdpTransactionInd) {
-        cfdp_decompress_number(&transaction_id, &(transactionId.transactionNbr));
-        return Py_BuildValue("(i, {s:K})", (int)CfdpTransactionInd, 
-                                           "transaction_id", (unsigned long long)transaction_id);
+    // If it does not overlap any, insert a new extent
+    if (i == j) {
+        if (a->numExtents == a->capExtents) {
+            tmp = (CfdpExtent *)realloc(a->extents, (2*a->capExtents + 4)*sizeof(CfdpExtent));
+            if (!tmp) return 0;
+            a->extents    = tmp;
+            a->capExtents = 2*a->capExtents + 4;
+        }
+        memmove(&(a->extents[i+1]), &(a->extents[i]), (a->numExtents - i)*sizeof(CfdpExtent));
+        a->numExtents++;
+    } else {
+        memmove(&(a->extents[i+1]), &(a->extents[j]), (a->numExtents - j)*sizeof(CfdpExtent));
+        a->numExtents -= (j - i - 1);
     }
 
-    // Handle CfdpEofSentInd
-    if (type == CfdpEofSentInd) {
-        cfdp_decompress_number(&transaction_id, &(transactionId.transactionNbr));
-        return Py_BuildValue("(i, {s:K})", (int)CfdpEofSentInd, 
-                                           "transaction_id", (unsigned long long)transaction_id);
+    // Store the merged extent
+    a->extents[i].start = start;
+    a->extents[i].end   = end;
+    a->received += end - start;
+
+    return 1;
+}
+
+static void aggr_summarize(CfdpDispatcher *disp, CfdpSegAggr *a) {
+    /* Queue a CfdpSegmentsSummaryInd with the segments received in a transaction
+       since the last one. Must be called holding the lock. */
+    CfdpEvent *ev;
+
+    if (a->segments == 0) return;
+    if (!(ev = (CfdpEvent *)calloc(1, sizeof(CfdpEvent)))) return;
+    ev->extents = (CfdpExtent *)malloc((a->numExtents + 1)*sizeof(CfdpExtent));
+    if (!ev->extents) {
+        free(ev);
+        return;
     }
 
-    // Handle CfdpEofRecvInd
-    if (type == CfdpEofRecvInd) {
-        cfdp_decompress_number(&transaction_id, &(transactionId.transactionNbr));
-        return Py_BuildValue("(i, {s:K})", (int)CfdpEofRecvInd, 
-                                           "transaction_id", (unsigned long long)transaction_id);
+    // Fill in the summary
+    ev->type            = CfdpSegmentsSummaryInd;
+    ev->entityNbr       = a->entityNbr;
+    ev->sourceEntityNbr = a->sourceEntityNbr;
+    ev->transactionNbr  = a->transactionNbr;
+    ev->fileSize        = a->fileSize;
+    ev->segments        = a->segments;
+    ev->totalSegments   = a->totalSegments;
+    ev->received        = a->received;
+    ev->numExtents      = a->numExtents;
+    memcpy(ev->extents, a->extents, a->numExtents*sizeof(CfdpExtent));
+
+    queue_push(disp, ev);
+    disp->summaries++;
+    a->segments = 0;
+}
+
+static void aggr_summarize_all(CfdpDispatcher *disp, int force) {
+    /* Summarize all transactions if the aggregation interval has elapsed (or
+       if ``force``). Must be called holding the lock. */
+    struct timespec now;
+    CfdpSegAggr *a;
+    int i;
+
+    if (disp->num_aggrs == 0) return;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!force && (now.tv_sec - disp->last_summary.tv_sec) +
+        (now.tv_nsec - disp->last_summary.tv_nsec)*1e-9 < disp->aggr_interval)
+        return;
+
+    for (i = 0; i < MAX_CFDP_ROUTES; i++)
+        for (a = disp->aggrs[i]; a; a = a->next)
+            aggr_summarize(disp, a);
+    disp->last_summary = now;
+}
+
+static int aggr_event(CfdpDispatcher *disp, CfdpEvent *ev) {
+    /* Coalesce a file segment indication into its transaction. Other events
+       of the transaction are queued after its pending summary. Returns 1 if
+       the event was consumed (and freed). Must be called holding the lock. */
+    CfdpSegAggr **a, *aggr;
+
+    switch ((int)ev->type) {
+    case CfdpFileSegmentRecvInd:
+        if (!(aggr = aggr_get(disp, ev)) || !extent_add(aggr, ev->offset, ev->length))
+            return 0;
+        aggr->segments++;
+        aggr->totalSegments++;
+        disp->segments++;
+        event_free(ev);
+        return 1;
+
+    case CfdpMetadataRecvInd:
+        if ((aggr = aggr_get(disp, ev)) != NULL) aggr->fileSize = ev->fileSize;
+        return 0;
+
+    case CfdpEofRecvInd:
+    case CfdpTransactionFinishedInd:
+    case CfdpAbandonedInd:
+        a = aggr_find(disp, ev->sourceEntityNbr, ev->transactionNbr);
+        if (!(*a)) return 0;
+        aggr_summarize(disp, *a);
+        if (ev->type != CfdpEofRecvInd) aggr_remove(disp, a);
+        return 0;
+
+    default:
+        return 0;
     }
+}
 
-    // Handle CfdpSuspendedInd
-    if (type == CfdpSuspendedInd) {
-        return Py_BuildValue("(i, {s:i})", (int)CfdpSuspendedInd, "condition", (int)condition);
+static void aggr_clear(CfdpDispatcher *disp) {
+    // Forget the segments received in all transactions
+    int i;
+
+    for (i = 0; i < MAX_CFDP_ROUTES; i++)
+        while (disp->aggrs[i]) aggr_remove(disp, &(disp->aggrs[i]));
+}
+
+/* ============================================================================
+ * === Event Dispatcher
+ * ============================================================================ */
+
+static int route_event(CfdpDispatcher *disp, CfdpEvent *ev) {
+    /* Find the entity that owns an event. Transactions started by this node
+       are routed to the entity that started them. Otherwise, the transaction
+       was started by the peer entity (its source). Must be called holding the
+       lock. Returns 1 if the transaction is routed. */
+    CfdpRoute **r, *route;
+
+    r = route_find(disp, ev->sourceEntityNbr, ev->transactionNbr);
+    ev->entityNbr = (*r) ? (*r)->entityNbr : ev->sourceEntityNbr;
+    if (!(*r)) return 0;
+
+    // Forget the route once the transaction has ended
+    if (ev->type == CfdpTransactionFinishedInd || ev->type == CfdpAbandonedInd) {
+        route = *r;
+        *r = route->next;
+        free(route);
+        disp->num_routes--;
     }
 
-    // Handle CfdpResumedInd
-    if (type == CfdpResumedInd) {
-        return Py_BuildValue("(i, {s:K})", (int)CfdpResumedInd, "progress", (unsigned long long)progress);
+    return 1;
+}
+
+static void dispatch_event(CfdpDispatcher *disp, CfdpEvent *ev) {
+    // Track the progress of a routed event and queue it. Must be called holding the lock.
+    progress_event(disp, ev);
+    if (!(disp->aggr_interval > 0 && aggr_event(disp, ev)))
+        queue_push(disp, ev);
+}
+
+static int held_push(CfdpDispatcher *disp, CfdpEvent *ev) {
+    /* Hold an event that is not routed if its transaction was started by this
+       entity (e.g., by a previous process that journaled it), so that it is
+       not delivered to the wrong entity before the transaction is recovered.
+       Once MAX_HELD_EVENTS are held, the oldest one is dispatched as is. Must
+       be called holding the lock. Returns 1 if the event is held. */
+    CfdpEvent *old;
+
+    if (!disp->hold_entity_nbr || ev->sourceEntityNbr != disp->hold_entity_nbr)
+        return 0;
+
+    ev->next = NULL;
+    if (disp->held_tail) disp->held_tail->next = ev; else disp->held_head = ev;
+    disp->held_tail = ev;
+    if (++disp->num_held <= MAX_HELD_EVENTS) return 1;
+
+    old = disp->held_head;
+    disp->held_head = old->next;
+    old->next = NULL;
+    disp->num_held--;
+    dispatch_event(disp, old);
+
+    return 1;
+}
+
+static void held_release(CfdpDispatcher *disp, int all, uvast sourceEntityNbr, uvast transactionNbr) {
+    /* Dispatch the held events of a transaction just routed, in the order they
+       were received (or all of them if ``all``). Must be called holding the lock. */
+    CfdpEvent **e = &(disp->held_head), *ev;
+
+    disp->held_tail = NULL;
+    while ((ev = *e) != NULL) {
+        if (!all && !(ev->sourceEntityNbr == sourceEntityNbr && ev->transactionNbr == transactionNbr)) {
+            disp->held_tail = ev;
+            e = &(ev->next);
+            continue;
+        }
+        *e = ev->next;
+        ev->next = NULL;
+        disp->num_held--;
+        route_event(disp, ev);
+        dispatch_event(disp, ev);
     }
+}
 
-    // Handle CfdpReportInd
-    if (type == CfdpReportInd) {
-        cfdp_decompress_number(&transaction_id, &(transactionId.transactionNbr));
-        return Py_BuildValue("(i, {s:K, s:i})", (int)CfdpReportInd, "transaction_id",
-                                                (unsigned long long)transaction_id,
-                                                "status", (int)fileStatus);
+static void dispatcher_backoff(CfdpDispatcher *disp, long long delay) {
+    // Wait ``delay`` nsec before retrying ``cfdp_get_event``, or until the dispatcher is stopped
+    struct timespec slice = {0, EVENT_WAIT_SLICE};
+
+    for (; delay > 0 && disp->running; delay -= EVENT_WAIT_SLICE)
+        nanosleep(&slice, NULL);
+}
+
+static void *cfdp_dispatcher(void *arg) {
+    /* Dispatcher thread. It consumes all CFDP events of this node, and queues 
+       them along with the entity that owns them. If getting an event fails, it
+       retries with an exponential backoff, so that the events of the transactions
+       in progress are not lost. It does not hold the GIL. */
+    CfdpDispatcher *disp = (CfdpDispatcher *)arg;
+    CfdpEvent *ev;
+    long long delay = EVENT_WAIT_SLICE;
+
+    while (disp->running) {
+        // Get the next event. This blocks until ``cfdp_interrupt`` is called
+        ev = (CfdpEvent *)calloc(1, sizeof(CfdpEvent));
+        if (!ev || read_event(ev) < 0) {
+            if (ev) event_free(ev);
+            pthread_mutex_lock(&(disp->lock));
+            disp->error = 1;
+            disp->errors++;
+            pthread_mutex_unlock(&(disp->lock));
+            dispatcher_backoff(disp, delay);
+            if ((delay *= 2) > EVENT_RETRY_MAX) delay = EVENT_RETRY_MAX;
+            continue;
+        }
+        if (disp->error) {
+            pthread_mutex_lock(&(disp->lock));
+            disp->error = 0;
+            pthread_mutex_unlock(&(disp->lock));
+        }
+        delay = EVENT_WAIT_SLICE;
 
+        // Interruptions have no event
+        if (ev->type == CfdpNoEvent) {
+            event_free(ev);
+            continue;
+        }
+
+        // Route the event and queue it (unless it is coalesced into a summary,
+        // or held until its transaction is recovered)
+        pthread_mutex_lock(&(disp->lock));
+        disp->events++;
+        if (route_event(disp, ev) || !held_push(disp, ev))
+            dispatch_event(disp, ev);
+        progress_purge(disp, monotonic_time());
+        if (disp->aggr_interval > 0) aggr_summarize_all(disp, 0);
+        pthread_mutex_unlock(&(disp->lock));
     }
 
-    // Handle CfdpFaultInd
-    if (type == CfdpFaultInd) {
-        cfdp_decompress_number(&transaction_id, &(transactionId.transactionNbr));
-        return Py_BuildValue("(i, {s:K, s:i, s:K})", (int)CfdpFaultInd, "transaction_id",
-                                                     (unsigned long long)transaction_id,
-                                                     "code", (int)deliveryCode,
-                                                     "progress", (unsigned long long)progress);
+    // Wake up all threads waiting for events
+    pthread_mutex_lock(&(disp->lock));
+    disp->running = 0;
+    pthread_cond_broadcast(&(disp->ready));
+    pthread_mutex_unlock(&(disp->lock));
+
+    return NULL;
+}
+
+static CfdpEvent *dispatcher_pop(CfdpDispatcher *disp, unsigned int max, double timeout) {
+    /* Wait for the events queued by the dispatcher, and pop up to ``max`` of
+       them as a linked list. The GIL is released while waiting, and reacquired
+       every EVENT_WAIT_SLICE to check for signals. Returns NULL and sets the 
+       Python exception if error (TimeoutError if the timeout expires, 
+       ConnectionAbortedError if the dispatcher has stopped). */
+    struct timespec now, deadline, slice;
+    CfdpEvent *ev = NULL, *last;
+    unsigned int n;
+    int stopped = 0, expired = 0;
+
+    // Compute the deadline. A negative timeout waits forever.
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout >= 0) {
+        deadline.tv_sec  += (time_t)timeout;
+        deadline.tv_nsec += (long)((timeout - (time_t)timeout)*1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
     }
 
-    // Handle CfdpAbandonedInd
-    if (type == CfdpAbandonedInd) {
-        cfdp_decompress_number(&transaction_id, &(transactionId.transactionNbr));
-        return Py_BuildValue("(i, {s:K, s:i, s:K})", (int)CfdpAbandonedInd, "transaction_id",
-                                                     (unsigned long long)transaction_id,
-                                                     "code", (int)deliveryCode,
-                                                     "progress", (unsigned long long)progress);
+    while (1) {
+        // Wait for an event for at most one slice, without the GIL
+        Py_BEGIN_ALLOW_THREADS
+        clock_gettime(CLOCK_REALTIME, &slice);
+        slice.tv_nsec += EVENT_WAIT_SLICE;
+        if (slice.tv_nsec >= 1000000000L) {
+            slice.tv_sec++;
+            slice.tv_nsec -= 1000000000L;
+        }
+        if (timeout >= 0 && (slice.tv_sec > deadline.tv_sec ||
+            (slice.tv_sec == deadline.tv_sec && slice.tv_nsec > deadline.tv_nsec)))
+            slice = deadline;
+        pthread_mutex_lock(&(disp->lock));
+        while (!disp->head && disp->running &&
+               pthread_cond_timedwait(&(disp->ready), &(disp->lock), &slice) == 0);
+        if (!disp->head && disp->aggr_interval > 0) aggr_summarize_all(disp, 0);
+        if ((ev = disp->head) != NULL) {
+            for (n = 1, last = ev; n < max && last->next; n++) last = last->next;
+            disp->head = last->next;
+            if (!disp->head) disp->tail = NULL;
+            last->next = NULL;
+            disp->queued -= n;
+        }
+        stopped = !disp->running;
+        pthread_mutex_unlock(&(disp->lock));
+        clock_gettime(CLOCK_REALTIME, &now);
+        expired = (timeout >= 0 && (now.tv_sec > deadline.tv_sec ||
+                   (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)));
+        Py_END_ALLOW_THREADS
+
+        // If an event was found, you are done
+        if (ev) return ev;
+
+        // Check for signals (only effective in the main thread)
+        if (PyErr_CheckSignals() < 0) return NULL;
+
+        if (stopped) {
+            PyErr_SetString(PyExc_ConnectionAbortedError, "CFDP event dispatcher stopped.");
+            return NULL;
+        }
+        if (expired) {
+            PyErr_SetString(PyExc_TimeoutError, "CFDP event wait timed out.");
+            return NULL;
+        }
     }
+}
 
-    // Handle CfdpFileSegmentRecvInd
-    if (type == CfdpFileSegmentRecvInd) {
-        cfdp_decompress_number(&transaction_id, &(transactionId.transactionNbr));
-        return Py_BuildValue("(i, {s:K, s:K, s:I})", (int)CfdpFileSegmentRecvInd,
-                                               "transaction_id", (unsigned long long)transaction_id,
-                                               "offset", (unsigned long long)offset,
-                                               "length", (unsigned int)length);
+static PyObject *pyion_cfdp_dispatcher_start(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpDispatcher *disp;
+    unsigned long long hold_entity_nbr = 0;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "|K", &hold_entity_nbr))
+        return NULL;
+
+    // Allocate memory for the dispatcher and initialize to zeros
+    disp = (CfdpDispatcher *)calloc(1, sizeof(CfdpDispatcher));
+    if (!disp) return PyErr_NoMemory();
+    disp->hold_entity_nbr = (uvast)hold_entity_nbr;
+
+    // Start the dispatcher thread
+    pthread_mutex_init(&(disp->lock), NULL);
+    pthread_cond_init(&(disp->ready), NULL);
+    disp->running = 1;
+    if (pthread_create(&(disp->thread), NULL, cfdp_dispatcher, disp) != 0) {
+        pthread_cond_destroy(&(disp->ready));
+        pthread_mutex_destroy(&(disp->lock));
+        free(disp);
+        PyErr_SetString(PyExc_RuntimeError, "Cannot start CFDP event dispatcher.");
+        return NULL;
     }
 
+    // Return the memory address of the dispatcher
+    return Py_BuildValue("k", disp);
+}
+
+static PyObject *pyion_cfdp_dispatcher_stop(PyObject *self, PyObject *args) {
     // Define variables
-    unsigned char usrmsgBuf[256];
-    PyObject*     py_usrmsgs = PyList_New(0);
+    CfdpDispatcher *disp;
 
-    // Handle CfdpMetadataRecvInd
-    if (type == CfdpMetadataRecvInd) {
-        cfdp_decompress_number(&transaction_id, &(transactionId.transactionNbr));
-        cfdp_decompress_number(&source_entity_nbr, &(originatingTransactionId.sourceEntityNbr));
-
-        // Get all messages
-        while (messagesToUser) {
-            // Get next message
-            if (cfdp_get_usrmsg(&messagesToUser, usrmsgBuf, (int *)&length) < 0) {
-                sprintf(err_msg, "Failed getting user messages, check ion.log.");                     
-                PyErr_SetString(PyExc_RuntimeError, err_msg);
-                return NULL;
-            }
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&disp))
+        return NULL;
 
-            // If empty message, continue
-            if (length == 0) 
-                continue;
+    // Stop the dispatcher thread. ``cfdp_interrupt`` wakes it up if waiting for an event.
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(disp->lock));
+    disp->running = 0;
+    pthread_mutex_unlock(&(disp->lock));
+    cfdp_interrupt();
+    pthread_join(disp->thread, NULL);
+    Py_END_ALLOW_THREADS
 
-            // Indicate end of user message
-            usrmsgBuf[length] = '\0';
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_cfdp_dispatcher_close(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpDispatcher *disp;
+    CfdpEvent *ev;
+    CfdpRoute *route;
+    int i;
 
-            // Add the user message to the list
-            PyList_Append(py_usrmsgs, Py_BuildValue("s", (char *)usrmsgBuf));
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&disp))
+        return NULL;
+
+    // Release all events not consumed or held and all routes
+    while ((ev = disp->head) != NULL) {
+        disp->head = ev->next;
+        event_free(ev);
+    }
+    while ((ev = disp->held_head) != NULL) {
+        disp->held_head = ev->next;
+        event_free(ev);
+    }
+    for (i = 0; i < MAX_CFDP_ROUTES; i++) {
+        while ((route = disp->routes[i]) != NULL) {
+            disp->routes[i] = route->next;
+            free(route);
         }
-        
-        // Build the return value
-        return Py_BuildValue("(i, {s:K, s:K, s:s, s:s, s:O})", 
-                            (int)CfdpMetadataRecvInd, 
-                            "transaction_id", (unsigned long long)transaction_id,
-                            "source_entity_id", (unsigned long long)source_entity_nbr,
-                            "source_file_name", sourceFileNameBuf,
-                            "dest_file_name", destFileNameBuf,
-                            "user_messages", py_usrmsgs);
     }
+    aggr_clear(disp);
+    progress_clear(disp);
 
+    // Free dispatcher memory
+    pthread_cond_destroy(&(disp->ready));
+    pthread_mutex_destroy(&(disp->lock));
+    free(disp);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_cfdp_dispatcher_next(PyObject *self, PyObject *args) {
     // Define variables
-    CfdpAction	action;
-	int			status;
-	char		firstPathName[256];
-	char		secondPathName[256];
-	char		msgBuf[256];
-    PyObject*   py_fs = PyDict_New();
-
-    // Handle CfdpTransactionFinishedInd
-    if (type == CfdpTransactionFinishedInd) {
-        cfdp_decompress_number(&transaction_id, &(transactionId.transactionNbr));
-
-        // Get all filestore responses
-        while (filestoreResponses) {
-            // Get next response
-            if (cfdp_get_fsresp(&filestoreResponses, &action, &status, firstPathName, 
-                                secondPathName, msgBuf) < 0) {
-                sprintf(err_msg, "Failed getting FS response, check ion.log.");                     
-                PyErr_SetString(PyExc_RuntimeError, err_msg);
-                return NULL;
-            }
+    CfdpDispatcher *disp;
+    CfdpEvent *ev;
+    PyObject *ret;
+    double timeout;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kd", (unsigned long *)&disp, &timeout))
+        return NULL;
+
+    // Wait for the next event
+    if (!(ev = dispatcher_pop(disp, 1, timeout)))
+        return NULL;
 
-            // If no action
-            if (action == ((CfdpAction) -1))
-                continue;
+    // Build the return value
+    ret = event_to_python(ev);
+    if (ret) ret = Py_BuildValue("(KN)", (unsigned long long)ev->entityNbr, ret);
+    event_free(ev);
 
-            // Build a value for this action
-            PyObject* py_res = PyDict_New();
-            PyDict_SetItemString(py_res, "status_report", Py_BuildValue("s", statusReportBuf));
-            PyDict_SetItemString(py_res, "condition_code", Py_BuildValue("i", (int)condition));
-            PyDict_SetItemString(py_res, "file_status", Py_BuildValue("i", (int)status));
-            PyDict_SetItemString(py_res, "delivery_code", Py_BuildValue("i", (int)deliveryCode));
+    return ret;
+}
 
-            // Store the result for this action
-            PyDict_SetItem(py_fs, Py_BuildValue("i", (int)action), py_res);
+static PyObject *pyion_cfdp_dispatcher_stats(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpDispatcher *disp;
+    PyObject *ret;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&disp))
+        return NULL;
+
+    pthread_mutex_lock(&(disp->lock));
+    ret = Py_BuildValue("{s:K, s:n, s:n, s:n, s:n, s:K, s:K, s:O, s:O, s:K}", "events", disp->events,
+                        "queued", (Py_ssize_t)disp->queued,
+                        "held", (Py_ssize_t)disp->num_held,
+                        "transactions", (Py_ssize_t)disp->num_routes,
+                        "tracked", (Py_ssize_t)disp->num_progress,
+                        "segments_coalesced", disp->segments,
+                        "summaries", disp->summaries,
+                        "running", disp->running ? Py_True : Py_False,
+                        "error", disp->error ? Py_True : Py_False,
+                        "errors", disp->errors);
+    pthread_mutex_unlock(&(disp->lock));
+
+    return ret;
+}
+
+static void event_drop(CfdpEvent *ev) {
+    /* Report an event that could not be converted to Python with a RuntimeWarning,
+       and clear the exception */
+    PyObject *type, *value, *tb;
+
+    PyErr_Fetch(&type, &value, &tb);
+    if (PyErr_WarnFormat(PyExc_RuntimeWarning, 1, "Dropped CFDP event %d of transaction (%llu, %llu): %S",
+                         (int)ev->type, (unsigned long long)ev->sourceEntityNbr,
+                         (unsigned long long)ev->transactionNbr, value ? value : Py_None) < 0)
+        PyErr_Clear();
+    Py_XDECREF(type);
+    Py_XDECREF(value);
+    Py_XDECREF(tb);
+}
+
+static PyObject *pyion_cfdp_dispatcher_next_many(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpDispatcher *disp;
+    CfdpEvent *ev, *next;
+    PyObject *ret, *item;
+    unsigned int max;
+    double timeout;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kId", (unsigned long *)&disp, &max, &timeout))
+        return NULL;
+    if (max == 0) max = 1;
+
+    // Wait for the next events
+    if (!(ev = dispatcher_pop(disp, max, timeout)))
+        return NULL;
+
+    // Build the list of events. An event that cannot be converted is reported
+    // with a warning and dropped, but the rest are returned. All events are freed.
+    ret = PyList_New(0);
+    for (; ev; ev = next) {
+        next = ev->next;
+        if (ret) {
+            item = event_to_python(ev);
+            if (item) item = Py_BuildValue("(KN)", (unsigned long long)ev->entityNbr, item);
+            if (!item || PyList_Append(ret, item) < 0) event_drop(ev);
+            Py_XDECREF(item);
         }
+        event_free(ev);
+    }
 
-        // Build return value
-        return Py_BuildValue("(i, O)", (int)CfdpTransactionFinishedInd, py_fs);
+    return ret;
+}
+
+static PyObject *pyion_cfdp_dispatcher_aggregate(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpDispatcher *disp;
+    double interval;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kd", (unsigned long *)&disp, &interval))
+        return NULL;
+
+    pthread_mutex_lock(&(disp->lock));
+    if (interval > 0) {
+        // Start (or reconfigure) the aggregation
+        if (disp->aggr_interval <= 0) clock_gettime(CLOCK_MONOTONIC, &(disp->last_summary));
+        disp->aggr_interval = interval;
+    } else {
+        // Report what has been coalesced so far, and stop
+        aggr_summarize_all(disp, 1);
+        aggr_clear(disp);
+        disp->aggr_interval = 0;
     }
+    pthread_mutex_unlock(&(disp->lock));
 
-    // If you reach this point, you cannot process this event type
-    sprintf(err_msg, "Unknown CFDP type.");                     
-    PyErr_SetString(PyExc_RuntimeError, err_msg);
-    return NULL;
+    Py_RETURN_NONE;
 }
 
-static PyObject *pyion_cfdp_interrupt_events(PyObject *self, PyObject *args) {   
-    // Interrupt CFDP event handler
-    cfdp_interrupt();
+static PyObject *pyion_cfdp_dispatcher_progress(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpDispatcher *disp;
+    CfdpProgress *snap, *p;
+    unsigned long long source_entity_nbr = 0, transaction_nbr = 0;
+    PyObject *ret, *item;
+    size_t i, num = 0;
+    double now;
+    int filter;
 
-    // Return None to indicate success
+    // Parse the input tuple. Raises error automatically if not possible
+    filter = PyTuple_Size(args) > 1;
+    if (!PyArg_ParseTuple(args, "k|KK", (unsigned long *)&disp, &source_entity_nbr, &transaction_nbr))
+        return NULL;
+
+    // Copy the records holding the lock, so that the dispatcher is not blocked
+    // while the Python objects are built
+    pthread_mutex_lock(&(disp->lock));
+    now = monotonic_time();
+    progress_purge(disp, now);
+    snap = (CfdpProgress *)malloc((disp->num_progress + 1)*sizeof(CfdpProgress));
+    if (!snap) {
+        pthread_mutex_unlock(&(disp->lock));
+        return PyErr_NoMemory();
+    }
+    if (filter) {
+        p = *progress_find(disp, source_entity_nbr, transaction_nbr);
+        if (p) snap[num++] = *p;
+    } else {
+        for (i = 0; i < MAX_CFDP_ROUTES; i++)
+            for (p = disp->progress[i]; p; p = p->next)
+                snap[num++] = *p;
+    }
+    pthread_mutex_unlock(&(disp->lock));
+
+    // Build the list of dictionaries
+    ret = PyList_New(num);
+    for (i = 0; ret && i < num; i++) {
+        p    = &(snap[i]);
+        item = Py_BuildValue("{s:(KK), s:K, s:O, s:i, s:K, s:K, s:K, s:K, s:K, s:K, s:d, s:d, s:d, s:d}",
+                             "transaction_id", (unsigned long long)p->sourceEntityNbr,
+                                               (unsigned long long)p->transactionNbr,
+                             "entity_nbr", (unsigned long long)p->entityNbr,
+                             "inbound", p->inbound ? Py_True : Py_False,
+                             "state", p->state,
+                             "file_size", (unsigned long long)p->fileSize,
+                             "sent", (unsigned long long)p->sent,
+                             "acked", (unsigned long long)p->acked,
+                             "received", (unsigned long long)p->received,
+                             "events", p->events,
+                             "faults", p->faults,
+                             "elapsed", p->last - p->first,
+                             "inactive", now - p->last,
+                             "throughput", p->state >= CFDP_TR_FINISHED ? 0.0 : progress_rate(p, now, 0),
+                             "avg_throughput", p->last > p->first ? progress_bytes(p)/(p->last - p->first) : 0.0);
+        if (!item) Py_CLEAR(ret); else PyList_SET_ITEM(ret, i, item);
+    }
+    free(snap);
+
+    return ret;
+}
+
+static PyObject *pyion_cfdp_dispatcher_route(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpDispatcher *disp;
+    unsigned long long source_entity_nbr, transaction_nbr, entity_nbr;
+    int ok;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kKKK", (unsigned long *)&disp, &source_entity_nbr,
+                          &transaction_nbr, &entity_nbr))
+        return NULL;
+
+    // Route the transaction, track its progress and dispatch its held events
+    pthread_mutex_lock(&(disp->lock));
+    ok = route_set(disp, source_entity_nbr, transaction_nbr, entity_nbr);
+    if (ok) progress_get(disp, source_entity_nbr, transaction_nbr, entity_nbr, 0, monotonic_time());
+    if (ok) held_release(disp, 0, source_entity_nbr, transaction_nbr);
+    pthread_mutex_unlock(&(disp->lock));
+
+    if (!ok) return PyErr_NoMemory();
     Py_RETURN_NONE;
-}
\ No newline at end of file
+}
+
+static PyObject *pyion_cfdp_dispatcher_release(PyObject *self, PyObject *args) {
+    // Define variables
+    CfdpDispatcher *disp;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&disp))
+        return NULL;
+
+    // Stop holding events, and dispatch the ones held so far
+    pthread_mutex_lock(&(disp->lock));
+    disp->hold_entity_nbr = 0;
+    held_release(disp, 1, 0, 0);
+    pthread_mutex_unlock(&(disp->lock));
+
+    Py_RETURN_NONE;
+}
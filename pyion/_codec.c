@@ -0,0 +1,394 @@
+/* ============================================================================
+ * Optional compression stage for the payloads of the different extension
+ * modules (BP bundles, LTP blocks).
+ *
+ * Compressed payloads are framed with an 8 byte header:
+ *
+ *      magic (2 bytes, "PZ") | codec (1 byte) | version (1 byte) |
+ *      uncompressed length (4 bytes, big endian)
+ *
+ * Payloads that are too small or do not compress are sent unframed, so that
+ * peers without a codec can still read them. The only exception are raw
+ * payloads that happen to start with the magic. They are framed with the
+ * CODEC_NONE codec ("stored") so that the receiver does not mistake them for
+ * compressed data. Therefore, a receiver with a codec enabled can handle mixed
+ * traffic (compressed, stored and unframed).
+ *
+ * Codecs are compiled in if setup.py finds their headers and libraries
+ * (PYION_HAVE_LZ4, PYION_HAVE_ZSTD).
+ *
+ * The uncompressed length of a frame comes from the peer. Before allocating
+ * the output, it is checked against the max size configured for the endpoint
+ * and the max expansion of the codec, so that a small frame cannot make the
+ * receiver allocate gigabytes.
+ *
+ * Statistics are updated with atomic operations since an endpoint can be
+ * used by several threads at once (e.g., a receiver and the send queue).
+ * =========================================================================== */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef PYION_HAVE_LZ4
+#include <lz4.h>
+#endif
+#ifdef PYION_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <Python.h>
+
+/* ============================================================================
+ * === Define global variables and structures
+ * ============================================================================ */
+
+#define CODEC_MAGIC_0      0x50     // 'P'
+#define CODEC_MAGIC_1      0x5A     // 'Z'
+#define CODEC_VERSION      1
+#define CODEC_HDR_SIZE     8
+#define CODEC_MIN_SIZE     64       // Default size below which data is not compressed
+#define CODEC_MAX_SIZE     (64*1024*1024)   // Default max size of a decompressed payload
+#define CODEC_LZ4_MAX_RATIO 255     // Max expansion of LZ4 (one literal byte per 255)
+
+// Update/read a statistic of a codec from any thread
+#define CODEC_ADD(field, v) __atomic_fetch_add(&(field), (unsigned long long)(v), __ATOMIC_RELAXED)
+#define CODEC_GET(field)    __atomic_load_n(&(field), __ATOMIC_RELAXED)
+
+// Codec identifiers. CODEC_NONE disables the stage.
+typedef enum {
+    CODEC_NONE = 0,
+    CODEC_LZ4,
+    CODEC_ZSTD
+} PyionCodecEnum;
+
+// Codec configuration and statistics of an endpoint/access point
+typedef struct {
+    int codec;
+    int level;                          // LZ4: acceleration. ZSTD: compression level
+    size_t min_size;
+    size_t max_size;                    // Larger frames are rejected as corrupted
+
+    // Statistics
+    unsigned long long tx_payloads;
+    unsigned long long tx_compressed;   // Payloads sent compressed
+    unsigned long long tx_bytes_in;     // Bytes given by the application
+    unsigned long long tx_bytes_out;    // Bytes given to ION (headers included)
+    unsigned long long tx_ns;           // CPU time spent compressing
+    unsigned long long rx_payloads;
+    unsigned long long rx_decoded;      // Payloads that were compressed
+    unsigned long long rx_bytes_in;
+    unsigned long long rx_bytes_out;
+    unsigned long long rx_ns;           // CPU time spent decompressing
+    unsigned long long rx_errors;       // Corrupted frames
+} PyionCodec;
+
+/* ============================================================================
+ * === Helper functions
+ * ============================================================================ */
+
+static int codec_available(int codec) {
+    switch (codec) {
+        case CODEC_NONE:
+            return 1;
+#ifdef PYION_HAVE_LZ4
+        case CODEC_LZ4:
+            return 1;
+#endif
+#ifdef PYION_HAVE_ZSTD
+        case CODEC_ZSTD:
+            return 1;
+#endif
+        default:
+            return 0;
+    }
+}
+
+static unsigned long long codec_cpu_ns(void) {
+    // CPU time of the calling thread in nanoseconds
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (unsigned long long)ts.tv_sec*1000000000ULL + (unsigned long long)ts.tv_nsec;
+}
+
+static void codec_write_header(unsigned char *buf, int codec, size_t len) {
+    buf[0] = CODEC_MAGIC_0;
+    buf[1] = CODEC_MAGIC_1;
+    buf[2] = (unsigned char)codec;
+    buf[3] = CODEC_VERSION;
+    buf[4] = (unsigned char)(len >> 24);
+    buf[5] = (unsigned char)(len >> 16);
+    buf[6] = (unsigned char)(len >> 8);
+    buf[7] = (unsigned char)len;
+}
+
+static int codec_is_framed(const unsigned char *buf, size_t len) {
+    return len >= CODEC_HDR_SIZE && buf[0] == CODEC_MAGIC_0 && buf[1] == CODEC_MAGIC_1 &&
+           buf[3] == CODEC_VERSION;
+}
+
+static size_t codec_bound(int codec, size_t len) {
+    // Max size of the compressed data (0 if the codec cannot handle it)
+    switch (codec) {
+#ifdef PYION_HAVE_LZ4
+        case CODEC_LZ4:
+            return (len > LZ4_MAX_INPUT_SIZE) ? 0 : (size_t)LZ4_compressBound((int)len);
+#endif
+#ifdef PYION_HAVE_ZSTD
+        case CODEC_ZSTD:
+            return ZSTD_compressBound(len);
+#endif
+        default:
+            return len;
+    }
+}
+
+static size_t codec_compress(int codec, int level, const char *src, size_t len,
+                             char *dst, size_t cap) {
+    // Returns the compressed size, or 0 on error
+    switch (codec) {
+#ifdef PYION_HAVE_LZ4
+        case CODEC_LZ4: {
+            int n = LZ4_compress_fast(src, dst, (int)len, (int)cap, level > 0 ? level : 1);
+            return (n > 0) ? (size_t)n : 0;
+        }
+#endif
+#ifdef PYION_HAVE_ZSTD
+        case CODEC_ZSTD: {
+            size_t m = ZSTD_compress(dst, cap, src, len, level > 0 ? level : ZSTD_CLEVEL_DEFAULT);
+            return ZSTD_isError(m) ? 0 : m;
+        }
+#endif
+        default:
+            return 0;
+    }
+}
+
+static int codec_size_ok(int codec, const char *src, size_t len, size_t out_len) {
+    // Check the uncompressed size announced by a frame before allocating it
+    switch (codec) {
+        case CODEC_NONE:
+            return len == out_len;
+#ifdef PYION_HAVE_LZ4
+        case CODEC_LZ4:
+            return out_len <= len*CODEC_LZ4_MAX_RATIO;
+#endif
+#ifdef PYION_HAVE_ZSTD
+        case CODEC_ZSTD: {
+            unsigned long long m = ZSTD_getFrameContentSize(src, len);
+            return m == ZSTD_CONTENTSIZE_UNKNOWN || m == (unsigned long long)out_len;
+        }
+#endif
+        default:
+            return 0;
+    }
+}
+
+static int codec_decompress(int codec, const char *src, size_t len, char *dst, size_t out_len) {
+    // Returns 1 if exactly ``out_len`` bytes were decompressed
+    switch (codec) {
+        case CODEC_NONE:
+            if (len != out_len) return 0;
+            memcpy(dst, src, len);
+            return 1;
+#ifdef PYION_HAVE_LZ4
+        case CODEC_LZ4:
+            if (len > LZ4_MAX_INPUT_SIZE || out_len > LZ4_MAX_INPUT_SIZE) return 0;
+            return LZ4_decompress_safe(src, dst, (int)len, (int)out_len) == (int)out_len;
+#endif
+#ifdef PYION_HAVE_ZSTD
+        case CODEC_ZSTD: {
+            size_t m = ZSTD_decompress(dst, out_len, src, len);
+            return !ZSTD_isError(m) && m == out_len;
+        }
+#endif
+        default:
+            return 0;
+    }
+}
+
+/* ============================================================================
+ * === Encode/Decode functions. They do not require the GIL.
+ * ============================================================================ */
+
+static int codec_encode(PyionCodec *c, const char *data, size_t len, char **out, size_t *out_len) {
+    /* Compress ``data`` if worth it. Returns 1 if ``*out`` was malloc'ed and must
+       be freed by the caller, 0 if ``*out`` is ``data`` (sent as is), and -1
+       if memory could not be allocated. */
+    // Define variables
+    unsigned long long t0 = codec_cpu_ns();
+    size_t cap, n = 0;
+    char *buf;
+
+    // By default, send data as is
+    *out     = (char *)data;
+    *out_len = len;
+    CODEC_ADD(c->tx_payloads, 1);
+    CODEC_ADD(c->tx_bytes_in, len);
+
+    // Compress if enabled and the data is large enough
+    if (c->codec != CODEC_NONE && len >= c->min_size && len <= 0xFFFFFFFFUL &&
+        (cap = codec_bound(c->codec, len)) > 0) {
+        buf = (char *)malloc(CODEC_HDR_SIZE + cap);
+        if (!buf) return -1;
+        n = codec_compress(c->codec, c->level, data, len, buf + CODEC_HDR_SIZE, cap);
+
+        // If it does not save anything, discard it
+        if (n > 0 && n + CODEC_HDR_SIZE < len) {
+            codec_write_header((unsigned char *)buf, c->codec, len);
+            *out     = buf;
+            *out_len = n + CODEC_HDR_SIZE;
+            CODEC_ADD(c->tx_compressed, 1);
+            CODEC_ADD(c->tx_bytes_out, *out_len);
+            CODEC_ADD(c->tx_ns, codec_cpu_ns() - t0);
+            return 1;
+        }
+        free(buf);
+    }
+
+    // Raw data that looks like a frame must be stored in a frame
+    if (c->codec != CODEC_NONE && codec_is_framed((const unsigned char *)data, len)) {
+        buf = (char *)malloc(CODEC_HDR_SIZE + len);
+        if (!buf) return -1;
+        codec_write_header((unsigned char *)buf, CODEC_NONE, len);
+        memcpy(buf + CODEC_HDR_SIZE, data, len);
+        *out     = buf;
+        *out_len = len + CODEC_HDR_SIZE;
+        CODEC_ADD(c->tx_bytes_out, *out_len);
+        CODEC_ADD(c->tx_ns, codec_cpu_ns() - t0);
+        return 1;
+    }
+
+    CODEC_ADD(c->tx_bytes_out, len);
+    CODEC_ADD(c->tx_ns, codec_cpu_ns() - t0);
+    return 0;
+}
+
+static int codec_decode_size(PyionCodec *c, const char *data, size_t len, size_t *out_len) {
+    /* Get the size of ``data`` once decoded, so that the caller can allocate the
+       output (e.g., a Python bytes object). Returns 1 if it is framed and must 
+       be decompressed with ``codec_decode_into``, 0 if it is delivered as is, 
+       and -2 if the frame is corrupted. */
+    const unsigned char *hdr = (const unsigned char *)data;
+    size_t n;
+
+    // By default, deliver data as is
+    *out_len = len;
+
+    // If the stage is disabled, you are done
+    if (c->codec == CODEC_NONE) return 0;
+    CODEC_ADD(c->rx_payloads, 1);
+    CODEC_ADD(c->rx_bytes_in, len);
+
+    // If data is not framed, deliver it as is
+    if (!codec_is_framed(hdr, len)) {
+        CODEC_ADD(c->rx_bytes_out, len);
+        return 0;
+    }
+
+    // Get the uncompressed size. It is untrusted, check it before allocating.
+    n = ((size_t)hdr[4] << 24) | ((size_t)hdr[5] << 16) | ((size_t)hdr[6] << 8) | (size_t)hdr[7];
+    if (!codec_available(hdr[2]) || n > c->max_size ||
+        !codec_size_ok(hdr[2], data + CODEC_HDR_SIZE, len - CODEC_HDR_SIZE, n)) {
+        CODEC_ADD(c->rx_errors, 1);
+        return -2;
+    }
+
+    *out_len = n;
+    return 1;
+}
+
+static int codec_decode_into(PyionCodec *c, const char *data, size_t len, char *dst, size_t n) {
+    /* Decompress framed ``data`` into ``dst``, of the ``n`` bytes given by 
+       ``codec_decode_size``. Returns 1 if ok, -2 if the frame is corrupted. */
+    const unsigned char *hdr = (const unsigned char *)data;
+    unsigned long long t0 = codec_cpu_ns();
+
+    if (!codec_decompress(hdr[2], data + CODEC_HDR_SIZE, len - CODEC_HDR_SIZE, dst, n)) {
+        CODEC_ADD(c->rx_errors, 1);
+        return -2;
+    }
+
+    if (hdr[2] != CODEC_NONE) CODEC_ADD(c->rx_decoded, 1);
+    CODEC_ADD(c->rx_bytes_out, n);
+    CODEC_ADD(c->rx_ns, codec_cpu_ns() - t0);
+    return 1;
+}
+
+static int codec_decode(PyionCodec *c, const char *data, size_t len, char **out, size_t *out_len) {
+    /* Decompress ``data`` if it is framed. Returns 1 if ``*out`` was malloc'ed
+       and must be freed by the caller, 0 if ``*out`` is ``data``, -1 if memory
+       could not be allocated, and -2 if the frame is corrupted. */
+    int ret;
+
+    // By default, deliver data as is
+    *out = (char *)data;
+    if ((ret = codec_decode_size(c, data, len, out_len)) <= 0) return ret;
+
+    // Decompress
+    *out = (char *)malloc(*out_len > 0 ? *out_len : 1);
+    if (!*out) return -1;
+    if ((ret = codec_decode_into(c, data, len, *out, *out_len)) < 0) {
+        free(*out);
+        *out = (char *)data;
+    }
+
+    return ret;
+}
+
+/* ============================================================================
+ * === Python helpers
+ * ============================================================================ */
+
+static int codec_configure(PyionCodec *c, int codec, int level, Py_ssize_t min_size,
+                           Py_ssize_t max_size) {
+    // Set the codec. Returns 0 and sets a Python exception if not possible.
+    if (!codec_available(codec)) {
+        pyion_SetExc(PyExc_ValueError, "Codec %d is not available in this build of pyion.", codec);
+        return 0;
+    }
+    if (min_size < 0) {
+        pyion_SetExc(PyExc_ValueError, "Minimum size to compress cannot be negative.");
+        return 0;
+    }
+    if (max_size <= 0) {
+        pyion_SetExc(PyExc_ValueError, "Maximum size to decompress must be positive.");
+        return 0;
+    }
+
+    c->codec    = codec;
+    c->level    = level;
+    c->min_size = (size_t)min_size;
+    c->max_size = (size_t)max_size;
+    return 1;
+}
+
+static PyObject *codec_stats(PyionCodec *c) {
+    // Build a dictionary with the statistics of a codec
+    unsigned long long tx_in = CODEC_GET(c->tx_bytes_in), tx_out = CODEC_GET(c->tx_bytes_out);
+    double ratio = tx_out ? (double)tx_in/(double)tx_out : 1.0;
+
+    return Py_BuildValue("{s:i,s:K,s:K,s:K,s:K,s:d,s:d,s:K,s:K,s:K,s:K,s:d,s:K}",
+                         "codec", c->codec,
+                         "tx_payloads", CODEC_GET(c->tx_payloads),
+                         "tx_compressed", CODEC_GET(c->tx_compressed),
+                         "tx_bytes_in", tx_in,
+                         "tx_bytes_out", tx_out,
+                         "tx_ratio", ratio,
+                         "tx_cpu_time", (double)CODEC_GET(c->tx_ns)*1e-9,
+                         "rx_payloads", CODEC_GET(c->rx_payloads),
+                         "rx_decoded", CODEC_GET(c->rx_decoded),
+                         "rx_bytes_in", CODEC_GET(c->rx_bytes_in),
+                         "rx_bytes_out", CODEC_GET(c->rx_bytes_out),
+                         "rx_cpu_time", (double)CODEC_GET(c->rx_ns)*1e-9,
+                         "rx_errors", CODEC_GET(c->rx_errors));
+}
+
+static void codec_set_exc(int res) {
+    // Translate an error of ``codec_encode``/``codec_decode`` into an exception
+    if (res == -1) {
+        pyion_SetExc(PyExc_MemoryError, "Cannot malloc for codec buffer.");
+    } else {
+        pyion_SetExc(PyExc_IOError, "Corrupted compressed payload.");
+    }
+}
@@ -10,12 +10,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <ion.h>
 #include <zco.h>
 #include <ltp.h>
 #include <Python.h>
 
 #include "_utils.c"
+#include "_codec.c"
 
 /* ============================================================================
  * === _ltp module definitions
@@ -34,21 +38,185 @@ static char ltp_open_docstring[] =
     "Open a connection to the local LTP engine.";
 static char ltp_close_docstring[] =
     "Close a connection to the local LTP engine.\n";
+static char ltp_close_many_docstring[] =
+    "Close several access points at once. Their receivers are stopped in parallel,\n"
+    "and the call returns when all of them have left the access points.\n"
+    "Arguments\n"
+    "---------\n"
+    "Tuple of Long [k]: Memory addresses of the access points to close";
 static char ltp_send_docstring[] =
-    "Send a blob of bytes using LTP.";
+    "Send a blob of bytes using LTP.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Long long [K]: Destination engine number\n"
+    "Int [I]: Length of the red part. LTP_ALL_RED for a fully reliable block, 0 for all green\n"
+    "Buffer [s*]: Data to send (str or any object with the buffer protocol)";
+static char ltp_send_file_docstring[] =
+    "Send a block of a file using LTP without copying it into the SDR heap.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Long long [K]: Destination engine number\n"
+    "Int [I]: Length of the red part. LTP_ALL_RED for a fully reliable block, 0 for all green\n"
+    "String [s]: Absolute path of the file\n"
+    "Long long [K]: Offset of the block in the file\n"
+    "Long long [K]: Length of the block. 0 means until the end of the file";
+static char ltp_aggr_open_docstring[] =
+    "Open an aggregator that packs messages into LTP blocks.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Long long [K]: Destination engine number\n"
+    "Int [n]: Target block size in [bytes]\n"
+    "Double [d]: Max time a message waits in a block in [sec]. Zero or negative to disable";
+static char ltp_aggr_close_docstring[] =
+    "Close an aggregator.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the aggregator\n"
+    "Int [i]: If 1, send the pending messages";
+static char ltp_aggr_send_docstring[] =
+    "Add a message to the block being built by an aggregator.";
+static char ltp_aggr_flush_docstring[] =
+    "Send the block being built by an aggregator. Returns its session number or None.";
+static char ltp_aggr_stats_docstring[] =
+    "Get the statistics of an aggregator.";
+static char ltp_unpack_docstring[] =
+    "Split an aggregated LTP block into a list of messages. Raises ValueError if not aggregated.";
 static char ltp_receive_docstring[] =
-    "Receive a blob of bytes using LTP.";
+    "Receive a blob of bytes using LTP.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Double [d]: Timeout in [sec]. Negative means wait forever";
+static char ltp_receive_into_docstring[] =
+    "Receive a block using LTP into a writable buffer.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Buffer [w*]: Writable buffer\n"
+    "Double [d]: Timeout in [sec]. Negative means wait forever\n"
+    "Returns\n"
+    "-------\n"
+    "Number of bytes written in the buffer";
+static char ltp_receive_segment_docstring[] =
+    "Receive the next red part or green segment of a block using LTP.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Double [d]: Timeout in [sec]. Negative means wait forever\n"
+    "Returns\n"
+    "-------\n"
+    "Tuple (engine id, session number, notice type, offset, data, end of block, reason code)";
+static char ltp_receive_many_docstring[] =
+    "Receive all pending red parts, green segments and cancellations using LTP.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Int [I]: Maximum number of notices to return\n"
+    "Double [d]: Timeout in [sec]. Negative means wait forever\n"
+    "Returns\n"
+    "-------\n"
+    "List of tuples as returned by ltp_receive_segment";
+static char ltp_receive_any_docstring[] =
+    "Receive the next red part, green segment or cancellation from any of several access points.\n"
+    "Arguments\n"
+    "---------\n"
+    "Tuple: Memory addresses of the access points\n"
+    "Double [d]: Timeout in [sec]. Negative means wait forever\n"
+    "Returns\n"
+    "-------\n"
+    "Tuple (index of the access point, tuple as returned by ltp_receive_segment)";
 static char ltp_interrupt_docstring[] =
-    "Interrupt the reception of LTP data.";
+    "Interrupt the reception of LTP data, and wait until the calls in progress\n"
+    "have left the access point (or a 5 second deadline). The access point\n"
+    "remains open.";
+static char ltp_interrupt_many_docstring[] =
+    "Interrupt several access points at once, and wait until all their calls\n"
+    "in progress have left them, with a common deadline.\n"
+    "Arguments\n"
+    "---------\n"
+    "Tuple of Long [k]: Memory addresses of the access points to interrupt";
+static char ltp_set_codec_docstring[] =
+    "Set the compression stage of an access point.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Int [i]: Codec (CODEC_NONE, CODEC_LZ4, CODEC_ZSTD)\n"
+    "Int [i]: Level (LZ4 acceleration, ZSTD level). 0 uses the default\n"
+    "Int [n]: Blocks smaller than this are not compressed\n"
+    "Int [n, optional]: Max size of a decompressed block (default CODEC_MAX_SIZE)";
+static char ltp_codec_stats_docstring[] =
+    "Get the compression statistics of an access point.";
+static char ltp_export_events_docstring[] =
+    "Get the notices of export sessions (completed, cancelled) of a client.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Int [I]: Max number of notices to return\n"
+    "Double [d]: Timeout in [sec] to wait for the first notice. Negative means\n"
+    "            wait forever\n"
+    "Return\n"
+    "------\n"
+    "List of tuples (engine id, session number, notice type, reason code)";
+static char ltp_session_status_docstring[] =
+    "Get the status of an export session.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Int [I]: Session number returned by ``ltp_send``\n"
+    "Return\n"
+    "------\n"
+    "Tuple (status, reason code), or None if the session is unknown";
+static char ltp_session_wait_docstring[] =
+    "Wait for the outcome of export sessions.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Tuple of Int [O]: Session numbers\n"
+    "Int [i]: 1 waits for all sessions, 0 for any session\n"
+    "Double [d]: Timeout in [sec]. Negative means wait forever\n"
+    "Return\n"
+    "------\n"
+    "List of session numbers already resolved (complete or cancelled)";
+static char ltp_session_release_docstring[] =
+    "Forget an export session.\n"
+    "Arguments\n"
+    "---------\n"
+    "Long [k]: Memory address of the access point\n"
+    "Int [I]: Session number";
+static char ltp_notice_stats_docstring[] =
+    "Get the counters of the notice dispatcher of an access point.";
 
 // Declare the functions to wrap
 static PyObject *pyion_ltp_attach(PyObject *self, PyObject *args);
 static PyObject *pyion_ltp_detach(PyObject *self, PyObject *args);
 static PyObject *pyion_ltp_open(PyObject *self, PyObject *args);
 static PyObject *pyion_ltp_close(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_close_many(PyObject *self, PyObject *args);
 static PyObject *pyion_ltp_send(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_send_file(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_aggr_open(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_aggr_close(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_aggr_send(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_aggr_flush(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_aggr_stats(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_unpack(PyObject *self, PyObject *args);
 static PyObject *pyion_ltp_receive(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_receive_into(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_receive_segment(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_receive_many(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_receive_any(PyObject *self, PyObject *args);
 static PyObject *pyion_ltp_interrupt(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_interrupt_many(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_set_codec(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_codec_stats(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_export_events(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_notice_stats(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_session_status(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_session_wait(PyObject *self, PyObject *args);
+static PyObject *pyion_ltp_session_release(PyObject *self, PyObject *args);
 
 // Define member functions of this module
 static PyMethodDef module_methods[] = {
@@ -56,9 +224,29 @@ static PyMethodDef module_methods[] = {
     {"ltp_detach", pyion_ltp_detach, METH_VARARGS, ltp_detach_docstring},
     {"ltp_open", pyion_ltp_open, METH_VARARGS, ltp_open_docstring},
     {"ltp_close", pyion_ltp_close, METH_VARARGS, ltp_close_docstring},
+    {"ltp_close_many", pyion_ltp_close_many, METH_VARARGS, ltp_close_many_docstring},
     {"ltp_send", pyion_ltp_send, METH_VARARGS, ltp_send_docstring},
+    {"ltp_send_file", pyion_ltp_send_file, METH_VARARGS, ltp_send_file_docstring},
+    {"ltp_aggr_open", pyion_ltp_aggr_open, METH_VARARGS, ltp_aggr_open_docstring},
+    {"ltp_aggr_close", pyion_ltp_aggr_close, METH_VARARGS, ltp_aggr_close_docstring},
+    {"ltp_aggr_send", pyion_ltp_aggr_send, METH_VARARGS, ltp_aggr_send_docstring},
+    {"ltp_aggr_flush", pyion_ltp_aggr_flush, METH_VARARGS, ltp_aggr_flush_docstring},
+    {"ltp_aggr_stats", pyion_ltp_aggr_stats, METH_VARARGS, ltp_aggr_stats_docstring},
+    {"ltp_unpack", pyion_ltp_unpack, METH_VARARGS, ltp_unpack_docstring},
     {"ltp_receive", pyion_ltp_receive, METH_VARARGS, ltp_receive_docstring},
+    {"ltp_receive_into", pyion_ltp_receive_into, METH_VARARGS, ltp_receive_into_docstring},
+    {"ltp_receive_segment", pyion_ltp_receive_segment, METH_VARARGS, ltp_receive_segment_docstring},
+    {"ltp_receive_many", pyion_ltp_receive_many, METH_VARARGS, ltp_receive_many_docstring},
+    {"ltp_receive_any", pyion_ltp_receive_any, METH_VARARGS, ltp_receive_any_docstring},
     {"ltp_interrupt", pyion_ltp_interrupt, METH_VARARGS, ltp_interrupt_docstring},
+    {"ltp_interrupt_many", pyion_ltp_interrupt_many, METH_VARARGS, ltp_interrupt_many_docstring},
+    {"ltp_set_codec", pyion_ltp_set_codec, METH_VARARGS, ltp_set_codec_docstring},
+    {"ltp_codec_stats", pyion_ltp_codec_stats, METH_VARARGS, ltp_codec_stats_docstring},
+    {"ltp_export_events", pyion_ltp_export_events, METH_VARARGS, ltp_export_events_docstring},
+    {"ltp_notice_stats", pyion_ltp_notice_stats, METH_VARARGS, ltp_notice_stats_docstring},
+    {"ltp_session_status", pyion_ltp_session_status, METH_VARARGS, ltp_session_status_docstring},
+    {"ltp_session_wait", pyion_ltp_session_wait, METH_VARARGS, ltp_session_wait_docstring},
+    {"ltp_session_release", pyion_ltp_session_release, METH_VARARGS, ltp_session_release_docstring},
     {NULL, NULL, 0, NULL}
 };
 
@@ -88,6 +276,20 @@ PyMODINIT_FUNC PyInit__ltp(void) {
     // If module creation failed, return error
     if (!module) return NULL;
 
+    // Add constants to be used in Python interface
+    PyModule_AddIntMacro(module, CODEC_NONE);
+    PyModule_AddIntMacro(module, CODEC_LZ4);
+    PyModule_AddIntMacro(module, CODEC_ZSTD);
+    PyModule_AddIntConstant(module, "LtpExportSessionComplete", LtpExportSessionComplete);
+    PyModule_AddIntConstant(module, "LtpExportSessionCanceled", LtpExportSessionCanceled);
+    PyModule_AddIntConstant(module, "LtpRecvGreenSegment", LtpRecvGreenSegment);
+    PyModule_AddIntConstant(module, "LtpRecvRedPart", LtpRecvRedPart);
+    PyModule_AddIntConstant(module, "LtpImportSessionCanceled", LtpImportSessionCanceled);
+    PyModule_AddObject(module, "LTP_ALL_RED", PyLong_FromUnsignedLong(LTP_ALL_RED));
+    PyModule_AddIntConstant(module, "EXPORT_PENDING", 0);
+    PyModule_AddIntConstant(module, "EXPORT_COMPLETE", 1);
+    PyModule_AddIntConstant(module, "EXPORT_CANCELED", 2);
+
     return module;
 }
 
@@ -97,6 +299,25 @@ PyMODINIT_FUNC PyInit__ltp(void) {
 
 #define MAX_LTP_SESSIONS 1024
 
+// Outcomes of export sessions not registered (yet) that are kept, and for how
+// long [sec]. A notice can arrive before ``ltp_send`` registers its session.
+#define MAX_EARLY_OUTCOMES 64
+#define EARLY_OUTCOME_TTL  10
+
+// Time between checks for Python signals while waiting for a notice [nsec]
+#define NOTICE_WAIT_SLICE 100000000L
+
+// Max time that closing access points waits for their receivers to leave [sec]
+#define SAP_ACK_TIMEOUT 5
+
+// Reception multiplexer (see ``ltp_receive_any``). Dispatchers increase
+// ``mux_seq`` every time a reception queue gets a notice or an access point
+// stops, so that a single thread can wait for several access points.
+static pthread_mutex_t  mux_lock  = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   mux_ready = PTHREAD_COND_INITIALIZER;
+static unsigned long    mux_seq   = 0;
+static unsigned int     mux_next  = 0;      // First access point to check (round robin)
+
 /* ============================================================================
  * === Define structures for this module
  * ============================================================================ */
@@ -105,13 +326,84 @@ PyMODINIT_FUNC PyInit__ltp(void) {
 typedef enum {
     SAP_IDLE = 0,
     SAP_RUNNING,
-    SAP_CLOSING
+    SAP_CLOSING,
+    SAP_INTERRUPTING
 } LtpStateEnum;
 
+// An LTP notice, as returned by ``ltp_get_notice``
+typedef struct LtpNotice {
+    LtpNoticeType type;
+    LtpSessionId sessionId;
+    unsigned char reasonCode;
+    unsigned char endOfBlock;
+    unsigned int dataOffset;
+    unsigned int dataLength;
+    Object data;
+    struct LtpNotice *next;
+} LtpNotice;
+
+// FIFO of notices
+typedef struct {
+    LtpNotice *head;
+    LtpNotice *tail;
+    size_t count;
+} LtpNoticeQueue;
+
+// Queues of the notice dispatcher. Notices related to the reception of data
+// (red parts, green segments, import cancellations) go to NOTICE_Q_RECV, and
+// notices related to sent blocks go to NOTICE_Q_EXPORT.
+typedef enum {
+    NOTICE_Q_RECV = 0,
+    NOTICE_Q_EXPORT,
+    NUM_NOTICE_QUEUES
+} LtpNoticeQueueEnum;
+
+// Outcome of an export session (i.e., a block sent)
+typedef enum {
+    EXPORT_PENDING = 0,
+    EXPORT_COMPLETE,
+    EXPORT_CANCELED
+} LtpExportStatusEnum;
+
+// Export session tracked by the dispatcher, indexed by session number
+typedef struct LtpExportSession {
+    unsigned int sessionNbr;
+    LtpExportStatusEnum status;
+    int reasonCode;
+    struct LtpExportSession *next;
+} LtpExportSession;
+
+// Outcome of an export session that was not registered when it was resolved
+typedef struct {
+    unsigned int sessionNbr;
+    LtpExportStatusEnum status;
+    int reasonCode;
+    time_t when;                // 0 if this slot is empty
+} LtpEarlyOutcome;
+
 // State of the LTP service access point
 typedef struct {
     unsigned int clientId;      // 1=BP, 2=SDA, 3=CFDP, other numbers available
     LtpStateEnum status;
+    PyionCodec codec;           // Compression stage of ``ltp_send``/``ltp_receive``
+
+    // Notice dispatcher
+    pthread_t dispatcher;
+    int dispatching;            // 1 while the dispatcher must keep running
+    int users;                  // Calls waiting on/consuming notices
+    int closer_waiting;         // 1 while ``ltp_close`` waits for the users to leave
+    int disp_error;             // Return code of ``ltp_get_notice`` if it failed
+    pthread_mutex_t lock;
+    pthread_cond_t notice_ready;
+    LtpNoticeQueue queues[NUM_NOTICE_QUEUES];
+    unsigned long long notices[NUM_NOTICE_QUEUES];
+    unsigned long long dropped;
+
+    // Export sessions of blocks sent with ``ltp_send`` not yet released
+    LtpExportSession *sessions[MAX_LTP_SESSIONS];
+    size_t num_sessions;
+    LtpEarlyOutcome early[MAX_EARLY_OUTCOMES];    // Ring of unregistered outcomes
+    unsigned int early_next;
 } LtpSAP;
 
 /* ============================================================================
@@ -139,6 +431,305 @@ static PyObject *pyion_ltp_detach(PyObject *self, PyObject *args) {
     Py_RETURN_NONE;
 }
 
+/* ============================================================================
+ * === Notice Dispatcher
+ *
+ * Each access point has a dispatcher thread that calls ``ltp_get_notice`` in
+ * a loop (without the GIL) for as long as the access point is open, and 
+ * routes each notice to a queue:
+ *  - NOTICE_Q_RECV: LtpRecvRedPart, LtpRecvGreenSegment, LtpImportSessionCanceled.
+ *    Consumed by ``ltp_receive``.
+ *  - NOTICE_Q_EXPORT: LtpExportSessionComplete, LtpExportSessionCanceled.
+ *    Consumed by ``ltp_export_events``. If nobody consumes them, only the
+ *    last MAX_LTP_SESSIONS are kept.
+ * Other notices are discarded. Consumers wait on ``notice_ready`` and do not
+ * need a thread per call.
+ * ============================================================================ */
+
+static void notice_push(LtpNoticeQueue *q, LtpNotice *n) {
+    n->next = NULL;
+    if (q->tail) q->tail->next = n; else q->head = n;
+    q->tail = n;
+    q->count++;
+}
+
+static LtpNotice *notice_pop(LtpNoticeQueue *q) {
+    LtpNotice *n = q->head;
+    if (!n) return NULL;
+    q->head = n->next;
+    if (!q->head) q->tail = NULL;
+    q->count--;
+    n->next = NULL;
+    return n;
+}
+
+static void notice_unpop(LtpNoticeQueue *q, LtpNotice *n) {
+    // Put a notice back at the head of the queue
+    n->next = q->head;
+    q->head = n;
+    if (!q->tail) q->tail = n;
+    q->count++;
+}
+
+static void notice_free(LtpNotice *n) {
+    // Release the notice's data (if any) and free it
+    if (n->data) ltp_release_data(n->data);
+    free(n);
+}
+
+static int notice_queue_of(LtpNoticeType type) {
+    // Returns the queue for this notice type, or -1 if it is discarded
+    switch (type) {
+        case LtpRecvRedPart:
+        case LtpRecvGreenSegment:
+        case LtpImportSessionCanceled:
+            return NOTICE_Q_RECV;
+        case LtpExportSessionComplete:
+        case LtpExportSessionCanceled:
+            return NOTICE_Q_EXPORT;
+        default:
+            return -1;
+    }
+}
+
+static LtpExportSession *session_find(LtpSAP *state, unsigned int sessionNbr, int create) {
+    /* Find an export session. If it does not exist and ``create`` is true, add
+       it as pending. Must be called holding the lock. */
+    LtpExportSession **slot = &(state->sessions[sessionNbr % MAX_LTP_SESSIONS]), *es;
+
+    for (es = *slot; es; es = es->next)
+        if (es->sessionNbr == sessionNbr) return es;
+    if (!create) return NULL;
+
+    es = (LtpExportSession *)malloc(sizeof(LtpExportSession));
+    if (!es) return NULL;
+    es->sessionNbr = sessionNbr;
+    es->status     = EXPORT_PENDING;
+    es->reasonCode = 0;
+    es->next       = *slot;
+    *slot = es;
+    state->num_sessions++;
+
+    return es;
+}
+
+static void session_release(LtpSAP *state, unsigned int sessionNbr) {
+    // Forget an export session. Must be called holding the lock.
+    LtpExportSession **prev = &(state->sessions[sessionNbr % MAX_LTP_SESSIONS]), *es;
+
+    for (es = *prev; es; prev = &(es->next), es = es->next) {
+        if (es->sessionNbr != sessionNbr) continue;
+        *prev = es->next;
+        state->num_sessions--;
+        free(es);
+        return;
+    }
+}
+
+static void session_register(LtpSAP *state, unsigned int sessionNbr) {
+    /* Track an export session until it is released. If its outcome arrived
+       before (recently), apply it. Must be called holding the lock. */
+    LtpExportSession *es = session_find(state, sessionNbr, 1);
+    LtpEarlyOutcome *eo;
+    time_t now = time(NULL);
+    int i;
+
+    if (!es) return;
+    for (i = 0; i < MAX_EARLY_OUTCOMES; i++) {
+        eo = &(state->early[i]);
+        if (eo->when == 0 || eo->sessionNbr != sessionNbr) continue;
+        if (now - eo->when <= EARLY_OUTCOME_TTL) {
+            es->status     = eo->status;
+            es->reasonCode = eo->reasonCode;
+        }
+        eo->when = 0;
+    }
+}
+
+static void session_resolve(LtpSAP *state, LtpNotice *n) {
+    /* Record the outcome of an export session. Only registered sessions are
+       updated. Outcomes of other sessions (e.g., released by a fire-and-forget
+       ``ltp_send``, or sent by an aggregator) go to a small ring, in case their
+       session is registered shortly after. Must be called holding the lock. */
+    LtpExportSession *es = session_find(state, n->sessionId.sessionNbr, 0);
+    LtpExportStatusEnum status;
+    LtpEarlyOutcome *eo;
+
+    status = (n->type == LtpExportSessionComplete) ? EXPORT_COMPLETE : EXPORT_CANCELED;
+    if (es) {
+        es->status     = status;
+        es->reasonCode = (int)n->reasonCode;
+        return;
+    }
+
+    eo = &(state->early[state->early_next++ % MAX_EARLY_OUTCOMES]);
+    eo->sessionNbr = n->sessionId.sessionNbr;
+    eo->status     = status;
+    eo->reasonCode = (int)n->reasonCode;
+    eo->when       = time(NULL);
+}
+
+static void mux_notify(void) {
+    // Wake up the threads waiting in ``ltp_receive_any``
+    pthread_mutex_lock(&mux_lock);
+    mux_seq++;
+    pthread_cond_broadcast(&mux_ready);
+    pthread_mutex_unlock(&mux_lock);
+}
+
+static void *notice_dispatcher(void *arg) {
+    // Define variables
+    LtpSAP *state = (LtpSAP *)arg;
+    LtpNotice *n = NULL;
+    int ok, q;
+
+    while (1) {
+        // Get a new notice holder
+        if (!n) n = (LtpNotice *)malloc(sizeof(LtpNotice));
+        if (!n) {
+            ok = -1;
+        } else {
+            memset((char *)n, 0, sizeof(LtpNotice));
+            ok = ltp_get_notice(state->clientId, &(n->type), &(n->sessionId), &(n->reasonCode),
+                                &(n->endOfBlock), &(n->dataOffset), &(n->dataLength), &(n->data));
+        }
+
+        pthread_mutex_lock(&(state->lock));
+
+        // If the access point is being closed or LTP failed, you are done
+        if (!state->dispatching || ok < 0) {
+            if (ok < 0) state->disp_error = ok;
+            state->dispatching = 0;
+            pthread_cond_broadcast(&(state->notice_ready));
+            pthread_mutex_unlock(&(state->lock));
+            mux_notify();
+            break;
+        }
+
+        // Route the notice. Interruptions (LtpNoNotice) and other notices are dropped.
+        q = notice_queue_of(n->type);
+        if (q == NOTICE_Q_EXPORT) session_resolve(state, n);
+        if (q >= 0) {
+            notice_push(&(state->queues[q]), n);
+            state->notices[q]++;
+            n = NULL;
+
+            // Bound the export queue
+            if (state->queues[NOTICE_Q_EXPORT].count > MAX_LTP_SESSIONS) {
+                notice_free(notice_pop(&(state->queues[NOTICE_Q_EXPORT])));
+                state->dropped++;
+            }
+            pthread_cond_broadcast(&(state->notice_ready));
+        } else if (n->data) {
+            ltp_release_data(n->data);
+        }
+
+        pthread_mutex_unlock(&(state->lock));
+        if (q == NOTICE_Q_RECV) mux_notify();
+    }
+
+    // Clean up
+    if (n) notice_free(n);
+    return NULL;
+}
+
+// Condition that a caller of ``wait_until`` is waiting for. It is evaluated
+// while holding the access point's lock.
+typedef int (*LtpWaitCond)(LtpSAP *state, void *arg);
+
+static int wait_until(LtpSAP *state, LtpWaitCond cond, void *arg, double timeout) {
+    /* Wait until ``cond`` is true. The GIL is released while waiting, and 
+       reacquired every NOTICE_WAIT_SLICE to check for signals (e.g., SIGINT).
+       Returns 1 with the lock HELD if the condition is met. Otherwise, returns
+       0 and sets a Python exception. Must be called holding the GIL. */
+    // Define variables
+    struct timespec now, deadline, slice;
+    LtpStateEnum status = SAP_RUNNING;
+    int met = 0, stop = 0;
+
+    // Compute the deadline. A negative timeout waits forever.
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout >= 0) {
+        deadline.tv_sec  += (time_t)timeout;
+        deadline.tv_nsec += (long)((timeout - (time_t)timeout)*1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    while (1) {
+        Py_BEGIN_ALLOW_THREADS
+        pthread_mutex_lock(&(state->lock));
+
+        // Compute the end of this slice
+        clock_gettime(CLOCK_REALTIME, &slice);
+        slice.tv_nsec += NOTICE_WAIT_SLICE;
+        if (slice.tv_nsec >= 1000000000L) {
+            slice.tv_sec++;
+            slice.tv_nsec -= 1000000000L;
+        }
+        if (timeout >= 0 && (slice.tv_sec > deadline.tv_sec ||
+            (slice.tv_sec == deadline.tv_sec && slice.tv_nsec > deadline.tv_nsec)))
+            slice = deadline;
+
+        // Wait for the condition or a change of state
+        while (state->status == SAP_RUNNING && !(met = cond(state, arg)) && state->dispatching) {
+            if (pthread_cond_timedwait(&(state->notice_ready), &(state->lock), &slice) != 0) break;
+        }
+
+        // If the condition is met keep the lock, the caller releases it
+        status = state->status;
+        met  = (status == SAP_RUNNING) && cond(state, arg);
+        stop = met || !state->dispatching || status != SAP_RUNNING;
+        if (!met) pthread_mutex_unlock(&(state->lock));
+        Py_END_ALLOW_THREADS
+
+        // If the condition is met or the access point has stopped, you are done
+        if (stop) break;
+
+        // Check for signals (only effective in the main thread)
+        if (PyErr_CheckSignals() < 0) return 0;
+
+        // Check the timeout
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (timeout >= 0 && (now.tv_sec > deadline.tv_sec ||
+            (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec))) {
+            PyErr_SetString(PyExc_TimeoutError, "LTP wait timed out.");
+            return 0;
+        }
+    }
+
+    // Handle exit without meeting the condition
+    if (met) return 1;
+    if (status == SAP_CLOSING) {
+        PyErr_SetString(PyExc_ConnectionAbortedError, "LTP reception closed.");
+    } else if (status == SAP_INTERRUPTING) {
+        PyErr_SetString(PyExc_InterruptedError, "LTP reception interrupted.");
+    } else {
+        pyion_SetExc(PyExc_RuntimeError, "Error getting LTP notice (err code=%d).", state->disp_error);
+    }
+
+    return 0;
+}
+
+static int queue_not_empty(LtpSAP *state, void *arg) {
+    return state->queues[*(int *)arg].head != NULL;
+}
+
+static LtpNotice *wait_for_notice(LtpSAP *state, int q, double timeout) {
+    /* Wait until the dispatcher puts a notice in queue ``q``. Returns NULL and
+       sets a Python exception if nothing is received. Must be called holding
+       the GIL. */
+    LtpNotice *n;
+
+    if (!wait_until(state, queue_not_empty, &q, timeout)) return NULL;
+    n = notice_pop(&(state->queues[q]));
+    pthread_mutex_unlock(&(state->lock));
+
+    return n;
+}
+
 /* ============================================================================
  * === Open/Close Endpoint Functions
  * ============================================================================ */
@@ -174,19 +765,136 @@ static PyObject *pyion_ltp_open(PyObject *self, PyObject *args) {
     state->clientId = clientId;
     state->status = SAP_IDLE;
 
+    // Start the notice dispatcher
+    pthread_mutex_init(&(state->lock), NULL);
+    pthread_cond_init(&(state->notice_ready), NULL);
+    state->dispatching = 1;
+    if (pthread_create(&(state->dispatcher), NULL, notice_dispatcher, state) != 0) {
+        ltp_close(clientId);
+        pthread_cond_destroy(&(state->notice_ready));
+        pthread_mutex_destroy(&(state->lock));
+        free(state);
+        PyErr_SetString(PyExc_RuntimeError, "Cannot start LTP notice dispatcher.");
+        return NULL;
+    }
+
     // Return the memory address of the LTP state as an unsined long
     PyObject *ret = Py_BuildValue("k", state);
     return ret;
 }
 
 static void close_access_point(LtpSAP *state) {
+    // Define variables
+    LtpNotice *n;
+    int q;
+
+    // Stop the dispatcher. ltp_interrupt wakes it up if waiting for a notice.
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(state->lock));
+    state->dispatching = 0;
+    pthread_mutex_unlock(&(state->lock));
+    ltp_interrupt(state->clientId);
+    pthread_join(state->dispatcher, NULL);
+    Py_END_ALLOW_THREADS
+
+    // Release all notices not consumed and forget all sessions
+    for (q = 0; q < NUM_NOTICE_QUEUES; q++)
+        while ((n = notice_pop(&(state->queues[q]))) != NULL) notice_free(n);
+    for (q = 0; q < MAX_LTP_SESSIONS; q++)
+        while (state->sessions[q]) session_release(state, state->sessions[q]->sessionNbr);
+
     // Close this SAP
     ltp_close(state->clientId);
 
     // Free state memory
+    pthread_cond_destroy(&(state->notice_ready));
+    pthread_mutex_destroy(&(state->lock));
     free(state);
 }
 
+static void enter_access_point(LtpSAP *state) {
+    /* Register a call that consumes notices (e.g., ``ltp_receive``). An
+       interruption only applies to the calls in progress, so the first call
+       after they have all left runs normally. */
+    pthread_mutex_lock(&(state->lock));
+    if (state->status == SAP_IDLE || (state->status == SAP_INTERRUPTING && state->users == 0))
+        state->status = SAP_RUNNING;
+    state->users++;
+    pthread_mutex_unlock(&(state->lock));
+}
+
+static void leave_access_point(LtpSAP *state) {
+    /* Unregister a call that consumes notices. The last one to leave a closing
+       access point acknowledges it to ``ltp_close``. If the closer gave up
+       waiting, the last one to leave closes it. Interrupted access points are
+       never freed here, they remain open. */
+    int do_close = 0;
+
+    pthread_mutex_lock(&(state->lock));
+    state->users--;
+    if (state->users == 0) {
+        if (state->status != SAP_CLOSING) state->status = SAP_IDLE;
+        do_close = (state->status == SAP_CLOSING) && !state->closer_waiting;
+        pthread_cond_broadcast(&(state->notice_ready));
+    }
+    pthread_mutex_unlock(&(state->lock));
+
+    if (do_close) close_access_point(state);
+}
+
+static void stop_receiving(LtpSAP *state, LtpStateEnum how) {
+    /* Mark an access point as closing (``how`` = SAP_CLOSING), or a running one
+       as interrupted (``how`` = SAP_INTERRUPTING), and wake up its receivers */
+    pthread_mutex_lock(&(state->lock));
+    if (how == SAP_CLOSING || state->status == SAP_RUNNING) state->status = how;
+    pthread_cond_broadcast(&(state->notice_ready));
+    pthread_mutex_unlock(&(state->lock));
+    mux_notify();
+}
+
+static void close_access_points(LtpSAP **saps, Py_ssize_t num) {
+    /* Close several access points. All receivers are stopped first, and then
+       this call waits for them to leave with a common deadline. Access points
+       still in use after the deadline are closed by their last user. */
+    // Define variables
+    struct timespec deadline;
+    Py_ssize_t i;
+    int idle;
+
+    Py_BEGIN_ALLOW_THREADS
+
+    // Phase 1: Stop all receivers
+    for (i = 0; i < num; i++) {
+        pthread_mutex_lock(&(saps[i]->lock));
+        saps[i]->closer_waiting = 1;
+        pthread_mutex_unlock(&(saps[i]->lock));
+        stop_receiving(saps[i], SAP_CLOSING);
+    }
+
+    // Compute the absolute deadline
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SAP_ACK_TIMEOUT;
+
+    // Phase 2: Wait for the receivers to leave. Forget the access points that
+    // are still in use, their last user closes them.
+    for (i = 0; i < num; i++) {
+        pthread_mutex_lock(&(saps[i]->lock));
+        while (saps[i]->users > 0)
+            if (pthread_cond_timedwait(&(saps[i]->notice_ready), &(saps[i]->lock), &deadline) != 0)
+                break;
+        idle = (saps[i]->users == 0);
+        saps[i]->closer_waiting = 0;
+        pthread_mutex_unlock(&(saps[i]->lock));
+        if (!idle) saps[i] = NULL;
+    }
+
+    Py_END_ALLOW_THREADS
+
+    // Phase 3: Close the idle access points
+    for (i = 0; i < num; i++)
+        if (saps[i]) close_access_point(saps[i]);
+}
+
 static PyObject *pyion_ltp_close(PyObject *self, PyObject *args) {
     // Define variables
     LtpSAP *state;
@@ -195,17 +903,55 @@ static PyObject *pyion_ltp_close(PyObject *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "k", (unsigned long *)&state))
         return NULL;
 
-    // If endpoint is in idle state, just close
-    if (state->status == SAP_IDLE) {
-        close_access_point(state);
-        Py_RETURN_NONE;
+    // Close the access point once all calls using it have left
+    close_access_points(&state, 1);
+    
+    Py_RETURN_NONE;
+}
+
+static LtpSAP **parse_access_points(PyObject *args, Py_ssize_t *num) {
+    /* Parse a tuple of access point memory addresses. Returns an array that
+       must be freed by the caller, or NULL and sets the Python exception. */
+    // Define variables
+    PyObject   *py_saps;
+    LtpSAP     **saps;
+    Py_ssize_t i;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "O!", &PyTuple_Type, &py_saps))
+        return NULL;
+
+    // Get the memory address of all access points. Allocate at least one.
+    *num = PyTuple_Size(py_saps);
+    saps = (LtpSAP **)malloc((*num + 1)*sizeof(LtpSAP *));
+    if (!saps) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (i = 0; i < *num; i++) {
+        saps[i] = (LtpSAP *)PyLong_AsUnsignedLong(PyTuple_GET_ITEM(py_saps, i));
+        if (PyErr_Occurred()) {
+            free(saps);
+            return NULL;
+        }
     }
 
-    // We assume that if you reach this point, you are always in 
-    // running state.
-    state->status = SAP_CLOSING;
-    ltp_interrupt(state->clientId);
-    
+    return saps;
+}
+
+static PyObject *pyion_ltp_close_many(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP     **saps;
+    Py_ssize_t num;
+
+    // Parse the input tuple
+    if (!(saps = parse_access_points(args, &num)))
+        return NULL;
+
+    // Close all access points in parallel
+    close_access_points(saps, num);
+
+    free(saps);
     Py_RETURN_NONE;
 }
 
@@ -213,6 +959,32 @@ static PyObject *pyion_ltp_close(PyObject *self, PyObject *args) {
  * === Interrupt Endpoint Functions
  * ============================================================================ */
 
+static void interrupt_access_points(LtpSAP **saps, Py_ssize_t num) {
+    /* Interrupt several access points. The calls in progress are woken up
+       first (they raise InterruptedError), and then this call waits for them
+       to leave with a common deadline. The access points remain open until
+       ``ltp_close``. Call it without holding the GIL. */
+    // Define variables
+    struct timespec deadline;
+    Py_ssize_t i;
+
+    // Phase 1: Wake up the calls in progress
+    for (i = 0; i < num; i++) stop_receiving(saps[i], SAP_INTERRUPTING);
+
+    // Compute the absolute deadline
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += SAP_ACK_TIMEOUT;
+
+    // Phase 2: Wait for them to leave. The last one resets the access point.
+    for (i = 0; i < num; i++) {
+        pthread_mutex_lock(&(saps[i]->lock));
+        while (saps[i]->users > 0 && saps[i]->status == SAP_INTERRUPTING)
+            if (pthread_cond_timedwait(&(saps[i]->notice_ready), &(saps[i]->lock), &deadline) != 0)
+                break;
+        pthread_mutex_unlock(&(saps[i]->lock));
+    }
+}
+
 static PyObject *pyion_ltp_interrupt(PyObject *self, PyObject *args) {
     // Define variables
     LtpSAP *state;
@@ -221,45 +993,154 @@ static PyObject *pyion_ltp_interrupt(PyObject *self, PyObject *args) {
     if (!PyArg_ParseTuple(args, "k", (unsigned long *)&state))
         return NULL;
 
-    // If access point is already closing, you can return
-    if (state->status != SAP_RUNNING)
-        Py_RETURN_NONE;
+    // Interrupt the access point once the calls in progress have left
+    Py_BEGIN_ALLOW_THREADS
+    interrupt_access_points(&state, 1);
+    Py_END_ALLOW_THREADS
 
-    // Mark that you have transitioned to interruping state
-    state->status = SAP_CLOSING;
-    ltp_interrupt(state->clientId);
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_ltp_interrupt_many(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP     **saps;
+    Py_ssize_t num;
+
+    // Parse the input tuple
+    if (!(saps = parse_access_points(args, &num)))
+        return NULL;
+
+    // Interrupt all access points in parallel
+    Py_BEGIN_ALLOW_THREADS
+    interrupt_access_points(saps, num);
+    Py_END_ALLOW_THREADS
+
+    free(saps);
+    Py_RETURN_NONE;
+}
+
+/* ============================================================================
+ * === Compression Functions
+ * ============================================================================ */
+
+static PyObject *pyion_ltp_set_codec(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP *state;
+    int codec, level;
+    Py_ssize_t min_size, max_size = CODEC_MAX_SIZE;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kiin|n", (unsigned long *)&state, &codec, &level, &min_size,
+                          &max_size))
+        return NULL;
+
+    // Configure the compression stage
+    if (!codec_configure(&(state->codec), codec, level, min_size, max_size))
+        return NULL;
 
     Py_RETURN_NONE;
 }
 
+static PyObject *pyion_ltp_codec_stats(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP *state;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&state))
+        return NULL;
+
+    return codec_stats(&(state->codec));
+}
+
 /* ============================================================================
  * === Send Functionality
  * ============================================================================ */
 
+static PyObject *send_zco(LtpSAP *state, unsigned long long destEngineId, Object item,
+                          unsigned int redLength) {
+    // Define variables
+    char                err_msg[150];
+    LtpSessionId        sessionId;
+    int                 ok;
+
+    // Send using LTP protocol. The first ``redLength`` bytes are sent as RED LTP
+    // (reliable), and the rest as GREEN LTP (unreliable).
+    // NOTE 1: SessionId is filled by ``ltp_send``. It is tracked by the dispatcher.
+    // NOTE 2: In general, ltp_send does not block. However, if you exceed the max
+    //         number of export sessions defined in ltprc, then it will.
+    Py_BEGIN_ALLOW_THREADS
+    ok = ltp_send((uvast)destEngineId, state->clientId, item, redLength, &sessionId);
+    Py_END_ALLOW_THREADS
+
+    // Handle error in ltp_send
+    if (ok <= 0) {
+        sprintf(err_msg, "Error while sending the data through LTP (err code=%i)", ok);
+        PyErr_SetString(PyExc_RuntimeError, err_msg);
+        return NULL;
+    }
+
+    // Register the session so that its outcome is kept until released
+    pthread_mutex_lock(&(state->lock));
+    session_register(state, sessionId.sessionNbr);
+    pthread_mutex_unlock(&(state->lock));
+    
+    // Return the session number
+    return Py_BuildValue("I", sessionId.sessionNbr);
+}
+
 static PyObject *pyion_ltp_send(PyObject *self, PyObject *args) {
     // Define variables
     char                err_msg[150];
     LtpSAP              *state;
-    LtpSessionId        sessionId;
     unsigned long long  destEngineId;
     Sdr                 sdr;
     Object              extent;
     Object			    item = 0;
-    char                *data;
-    int                 data_size, ok;
+    Py_buffer           data;
+    char                *block;
+    int                 encoded = 0;
+    unsigned int        redLength;
+    size_t              block_size = 0;
+
+    // Parse input arguments. First one is SAP memory address for this endpoint.
+    // The data can be any object with the buffer protocol, so that bytearrays, 
+    // memoryviews or numpy arrays are not copied into a bytes object first.
+    if (!PyArg_ParseTuple(args, "kKIs*", (unsigned long *)&state, &destEngineId, &redLength, &data))
+        return NULL;
 
-    // Parse input arguments. First one is SAP memory address for this endpoint
-    if (!PyArg_ParseTuple(args, "kKs#", (unsigned long *)&state, &destEngineId, &data, &data_size))
+    // Compress the block if enabled. Release the GIL while doing so.
+    // NOTE: Only all-red blocks are compressed. Otherwise, the red length and
+    //       the offsets of the green segments would not refer to the user's data.
+    if (redLength == LTP_ALL_RED) {
+        Py_BEGIN_ALLOW_THREADS
+        encoded = codec_encode(&(state->codec), (char *)data.buf, (size_t)data.len, &block, &block_size);
+        Py_END_ALLOW_THREADS
+    } else {
+        block      = (char *)data.buf;
+        block_size = (size_t)data.len;
+    }
+
+    // Handle error while compressing
+    if (encoded < 0) {
+        PyBuffer_Release(&data);
+        codec_set_exc(encoded);
         return NULL;
+    }
 
     // Get ION SDR
     sdr = getIonsdr();
 
     // Start SDR transaction
-    if (!sdr_pybegin_xn(sdr)) return NULL;
+    if (!sdr_pybegin_xn(sdr)) {
+        if (encoded > 0) free(block);
+        PyBuffer_Release(&data);
+        return NULL;
+    }
 
-    // Allocate SDR memory
-    extent = sdr_insert(sdr, data, (size_t)data_size);
+    // Allocate SDR memory. This is the only copy of the data.
+    extent = sdr_insert(sdr, block, block_size);
+    if (encoded > 0) free(block);
+    PyBuffer_Release(&data);
     if (!extent) {
         sdr_cancel_xn(sdr);
         sprintf(err_msg, "SDR memory could not be allocated");
@@ -271,7 +1152,7 @@ static PyObject *pyion_ltp_send(PyObject *self, PyObject *args) {
     if (!sdr_pyend_xn(sdr)) return NULL;
 
     // Create ZCO object (not blocking because there is no attendant)
-    item = ionCreateZco(ZcoSdrSource, extent, 0, data_size,
+    item = ionCreateZco(ZcoSdrSource, extent, 0, block_size,
                         0, 0, ZcoOutbound, NULL); 
 
     // Handler error while creating ZCO object
@@ -281,166 +1162,1007 @@ static PyObject *pyion_ltp_send(PyObject *self, PyObject *args) {
         return NULL;
     }
 
-    // Send using LTP protocol. All data is sent as RED LTP by definition.
-    // NOTE 1: SessionId is filled by ``ltp_send``, but you do not care about it
-    // NOTE 2: In general, ltp_send does not block. However, if you exceed the max
-    //         number of export sessions defined in ltprc, then it will.
-    Py_BEGIN_ALLOW_THREADS
-    ok = ltp_send((uvast)destEngineId, state->clientId, item, LTP_ALL_RED, &sessionId);
-    Py_END_ALLOW_THREADS
-
-    // Handle error in ltp_send
-    if (ok <= 0) {
-        sprintf(err_msg, "Error while sending the data through LTP (err code=%i)", ok);
-        PyErr_SetString(PyExc_RuntimeError, err_msg);
-        return NULL;
-    }
-    
-    Py_RETURN_NONE;
+    // Send the block
+    return send_zco(state, destEngineId, item, redLength);
 }
 
-/* ============================================================================
- * === Receive Functionality
- * ============================================================================ */
-
-static PyObject *receive_data(LtpSAP *state){
+static PyObject *pyion_ltp_send_file(PyObject *self, PyObject *args) {
     // Define variables
-    char            err_msg[150];
-    ZcoReader	    reader;
-    Sdr             sdr;
-    LtpNoticeType	type;
-	LtpSessionId	sessionId;
-	unsigned char	reasonCode;
-	unsigned char	endOfBlock;
-	unsigned int	dataOffset;
-	unsigned int	dataLength;
-	Object		    data;
-    int             receiving_block, notice, do_malloc;
-    vast            len, data_size;
-
-    // Create a pre-allocated buffer for small block sizes. Otherwise, use malloc to
-    // get dynamic memory
-    char prealloc_payload[1024];
-    char *payload;
-
-    // Initialize pre-allocated buffer
-    memset(prealloc_payload, 0, sizeof(prealloc_payload));
-
-    // Mark as running
-    receiving_block = 1;
-    state->status = SAP_RUNNING;
-
-    // Process incoming indications
-    while ((state->status == SAP_RUNNING) && (receiving_block == 1)) {
-        // Get the next LTP notice
-        Py_BEGIN_ALLOW_THREADS                                // Release the GIL
-        notice = ltp_get_notice(state->clientId, &type, &sessionId, &reasonCode, 
-                                &endOfBlock, &dataOffset, &dataLength, &data);
-        Py_END_ALLOW_THREADS                                  // Acquire the GIL
-
-        // Handle error while receiving notices
-        if (notice < 0) {
-            PyErr_SetString(PyExc_RuntimeError, "Error getting LTP notice");
-            return NULL;
-        }
+    char                err_msg[300];
+    LtpSAP              *state;
+    unsigned long long  destEngineId, offset, length;
+    unsigned int        redLength;
+    char                *file_path;
+    struct stat         st;
+    Sdr                 sdr;
+    Object              fileRef;
+    Object			    item = 0;
 
-        // Handle different notice types
-        switch (type) {
-            case LtpExportSessionComplete:      // Transmit success
-                // Do not mark reception of block complete here. This should be done by the 
-                // LtpRecvRedPart case.
-                break;
-            case LtpImportSessionCanceled:      // Cancelled sessions. No data has been received yet.
-                // Release any data and throw exception
-                ltp_release_data(data);
-                sprintf(err_msg, "LTP import session cancelled (reason code=%d)", (unsigned int)reasonCode);
-                PyErr_SetString(PyExc_RuntimeError, err_msg);
-                return NULL;
-            case LtpExportSessionCanceled:      // Transmit failure. Some data might have been received already.
-                // Release any data and throw exception
-                ltp_release_data(data);
-                sprintf(err_msg, "LTP export session cancelled (reason code=%d)", (unsigned int)reasonCode);
-                PyErr_SetString(PyExc_RuntimeError, err_msg);
-                return NULL;
-            case LtpRecvRedPart:
-                // If this is not the end of the block, you are dealing with a block that is
-                // partially green, partially red. This is not allowed.
-                if (!endOfBlock) {
-                    ltp_release_data(data);
-                    PyErr_SetString(PyExc_NotImplementedError, "An LTP block cannot have green parts");
-                    return NULL;
-                }
-                
-                // Mark that reception of block has ended
-                receiving_block = 0;
-                break;
-            case LtpRecvGreenSegment:
-                // Release any data and throw exception
-                ltp_release_data(data);
-                PyErr_SetString(PyExc_NotImplementedError, "Only red part of LTP is supported");
-                return NULL;
-            default:
-                break;
-        }
+    // Parse input arguments. A length of 0 means until the end of the file
+    if (!PyArg_ParseTuple(args, "kKIsKK", (unsigned long *)&state, &destEngineId, &redLength,
+                          &file_path, &offset, &length))
+        return NULL;
 
-        // Make sure other tasks have a chance to run
-        sm_TaskYield();
+    // Check the block boundaries against the file size
+    if (stat(file_path, &st) < 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_OSError, file_path);
+        return NULL;
     }
-
-    // If you exited because of closing, throw error
-    if (state->status == SAP_CLOSING) {
-        PyErr_SetString(PyExc_ConnectionAbortedError, "LTP reception closed.");
+    if (offset > (unsigned long long)st.st_size) {
+        PyErr_SetString(PyExc_ValueError, "Offset is beyond the end of the file");
         return NULL;
     }
-
-    // If no block received by now and you are not closing, error.
-    if (receiving_block == -1) {
-        PyErr_SetString(PyExc_RuntimeError, "LTP block was not delivered as expected.");
+    if (length == 0) length = (unsigned long long)st.st_size - offset;
+    if (length == 0 || offset + length > (unsigned long long)st.st_size) {
+        sprintf(err_msg, "Invalid block [%llu, %llu) for file of %llu bytes", offset,
+                offset + length, (unsigned long long)st.st_size);
+        PyErr_SetString(PyExc_ValueError, err_msg);
         return NULL;
     }
 
     // Get ION SDR
     sdr = getIonsdr();
 
-    // Get content data size
+    // Start SDR transaction
     if (!sdr_pybegin_xn(sdr)) return NULL;
-    data_size = zco_source_data_length(sdr, data);
-    sdr_exit_xn(sdr);
 
-    // Check if we need to allocate memory dynamically
-    do_malloc = (data_size > 1024);
+    // Create a reference to the file. The block is read from the file as LTP
+    // segments it, so it is never copied into the SDR heap.
+    fileRef = zco_create_file_ref(sdr, file_path, NULL, ZcoOutbound);
+    if (!fileRef) {
+        sdr_cancel_xn(sdr);
+        sprintf(err_msg, "Cannot create ZCO file reference to %s", file_path);
+        PyErr_SetString(PyExc_RuntimeError, err_msg);
+        return NULL;
+    }
 
-    // Allocate memory for payload
-    payload = do_malloc ? (char*)malloc(data_size) : prealloc_payload;
+    // End SDR transaction
+    if (!sdr_pyend_xn(sdr)) return NULL;
 
-    // Prepare to receive next block
-    zco_start_receiving(data, &reader);
+    // Create ZCO object (not blocking because there is no attendant)
+    item = ionCreateZco(ZcoFileSource, fileRef, (vast)offset, (vast)length,
+                        0, 0, ZcoOutbound, NULL);
 
-    // Get bundle data
+    // The file reference is destroyed once the ZCO no longer needs it. The file
+    // itself is not deleted.
     if (!sdr_pybegin_xn(sdr)) return NULL;
-    len = zco_receive_source(sdr, &reader, data_size, payload);
+    zco_destroy_file_ref(sdr, fileRef);
     if (!sdr_pyend_xn(sdr)) return NULL;
 
-    // Handle error while getting the payload
+    // Handler error while creating ZCO object
+    if (!item || item == (Object)ERROR) {
+        sprintf(err_msg, "ZCO object creation failed");
+        PyErr_SetString(PyExc_RuntimeError, err_msg);
+        return NULL;
+    }
+
+    // Send the block
+    return send_zco(state, destEngineId, item, redLength);
+}
+
+/* ============================================================================
+ * === Block Aggregation
+ *
+ * LTP is most efficient with large blocks, but each call to ``ltp_send`` uses
+ * one of the span's export sessions. An aggregator packs small client messages
+ * into one all-red block, which is sent when:
+ *  - The next message would make the block exceed ``size_limit`` bytes (a
+ *    larger message is sent in a block of its own).
+ *  - The oldest message in the block has waited ``time_limit`` seconds. This
+ *    is checked by a flusher thread.
+ *  - The block is flushed explicitly or the aggregator is closed.
+ *
+ * Block format (all integers are big endian):
+ *      'P' 'A' | version (1) | reserved (0) | u32 count | count x (u32 len | data)
+ *
+ * ``ltp_unpack`` splits a received block back into its messages.
+ *
+ * A full block is swapped out of the aggregator under its lock, and sent
+ * without holding it, so producers are not blocked by ION. The buffer of the
+ * last block sent is kept as a spare for the next one.
+ *
+ * .. Warning:: LtpAggregators store the LtpSAP of the access point that sends
+ *              the blocks. Close them before closing the access point.
+ * ============================================================================ */
+
+#define AGGR_HDR_SIZE       8
+#define AGGR_REC_HDR_SIZE   4
+#define AGGR_VERSION        1
+
+typedef struct {
+    LtpSAP *state;
+    uvast destEngineId;
+    size_t size_limit;                  // Target block size [bytes]
+    double time_limit;                  // Max wait of a message [sec]. <= 0 to disable
+    char *block;                        // Block being built
+    size_t capacity;
+    char *spare;                        // Buffer of a block already sent, if any
+    size_t used;
+    unsigned int count;                 // Messages in the block
+    struct timespec first;              // Time the first message was added
+    int running;
+    pthread_t flusher;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;             // Signaled when a block is started or on close
+
+    // Statistics
+    unsigned long long messages;
+    unsigned long long bytes;
+    unsigned long long blocks;
+    unsigned long long timed_flushes;
+    unsigned long long errors;
+    int last_err_code;
+} LtpAggregator;
+
+static void aggr_put_u32(char *buf, unsigned int v) {
+    unsigned char *p = (unsigned char *)buf;
+    p[0] = (v >> 24) & 0xFF; p[1] = (v >> 16) & 0xFF; p[2] = (v >> 8) & 0xFF; p[3] = v & 0xFF;
+}
+
+static unsigned int aggr_get_u32(const char *buf) {
+    const unsigned char *p = (const unsigned char *)buf;
+    return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) | ((unsigned int)p[2] << 8) | p[3];
+}
+
+static void aggr_reset(LtpAggregator *a) {
+    a->block[0] = 'P';
+    a->block[1] = 'A';
+    a->block[2] = AGGR_VERSION;
+    a->block[3] = 0;
+    a->used     = AGGR_HDR_SIZE;
+    a->count    = 0;
+}
+
+// A block swapped out of the aggregator to be sent
+typedef struct {
+    char *buf;
+    size_t used;
+    size_t capacity;
+} LtpAggrBlock;
+
+static int aggr_take_block(LtpAggregator *a, LtpAggrBlock *blk) {
+    /* Swap the block being built out of the aggregator and start a new one.
+       Returns 1 if a block was taken, 0 if there is nothing to send and -2 if
+       a new buffer cannot be allocated (the block is kept). Must be called
+       holding the aggregator lock. */
+    char *next;
+
+    // If nothing to send, you are done
+    if (a->count == 0) return 0;
+
+    // Get a buffer for the next block
+    next = a->spare ? a->spare : (char *)malloc(a->size_limit);
+    if (!next) return -2;
+    a->spare = NULL;
+
+    // Finalize the header of this block and start a new one
+    aggr_put_u32(a->block + 4, a->count);
+    blk->buf      = a->block;
+    blk->used     = a->used;
+    blk->capacity = a->capacity;
+    a->block      = next;
+    a->capacity   = a->size_limit;
+    aggr_reset(a);
+
+    return 1;
+}
+
+static int aggr_send_block(LtpAggregator *a, LtpAggrBlock *blk, unsigned int *sessionNbr,
+                           int *err_code) {
+    /* Send a block taken with ``aggr_take_block`` and release its buffer.
+       Returns 1 if the block was sent and -1 on error (its messages are
+       dropped). Must be called without holding the aggregator lock or the GIL. */
+    LtpSessionId    sessionId;
+    Sdr             sdr;
+    Object          extent, item;
+    char            *block;
+    size_t          block_size;
+    int             encoded, ok = -1;
+
+    // Compress if enabled
+    encoded = codec_encode(&(a->state->codec), blk->buf, blk->used, &block, &block_size);
+    if (encoded < 0) goto done;
+
+    // Insert the block in the SDR heap
+    sdr = getIonsdr();
+    if (!sdr_begin_xn(sdr)) {
+        if (encoded > 0) free(block);
+        goto done;
+    }
+    extent = sdr_insert(sdr, block, block_size);
+    if (encoded > 0) free(block);
+    if (!extent) {
+        sdr_cancel_xn(sdr);
+        goto done;
+    }
+    if (sdr_end_xn(sdr) < 0) goto done;
+
+    // Create ZCO object and send it
+    item = ionCreateZco(ZcoSdrSource, extent, 0, block_size, 0, 0, ZcoOutbound, NULL);
+    if (!item || item == (Object)ERROR) goto done;
+    ok = ltp_send(a->destEngineId, a->state->clientId, item, LTP_ALL_RED, &sessionId);
+    if (ok > 0 && sessionNbr) *sessionNbr = sessionId.sessionNbr;
+
+done:
+    // Update statistics and keep the buffer for the next block if possible
+    pthread_mutex_lock(&(a->lock));
+    if (ok > 0) {
+        a->blocks++;
+    } else {
+        a->errors++;
+        a->last_err_code = ok;
+    }
+    if (!a->spare && blk->capacity == a->size_limit) {
+        a->spare = blk->buf;
+        blk->buf = NULL;
+    }
+    pthread_mutex_unlock(&(a->lock));
+    free(blk->buf);
+    if (err_code) *err_code = ok;
+
+    return (ok > 0) ? 1 : -1;
+}
+
+static void *aggr_flusher(void *arg) {
+    // Define variables
+    LtpAggregator *a = (LtpAggregator *)arg;
+    struct timespec deadline, now;
+    LtpAggrBlock blk;
+
+    pthread_mutex_lock(&(a->lock));
+    while (a->running) {
+        // Wait until a block is started
+        if (a->count == 0 || a->time_limit <= 0) {
+            pthread_cond_wait(&(a->changed), &(a->lock));
+            continue;
+        }
+
+        // Wait until the first message of the block expires
+        deadline = a->first;
+        deadline.tv_sec  += (time_t)a->time_limit;
+        deadline.tv_nsec += (long)((a->time_limit - (time_t)a->time_limit)*1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&(a->changed), &(a->lock), &deadline);
+        if (!a->running || a->count == 0) continue;
+
+        // If the block has not been sent (and a new one started) meanwhile, send it
+        clock_gettime(CLOCK_REALTIME, &now);
+        if ((now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec))
+            && aggr_take_block(a, &blk) > 0) {
+            a->timed_flushes++;
+            pthread_mutex_unlock(&(a->lock));
+            aggr_send_block(a, &blk, NULL, NULL);
+            pthread_mutex_lock(&(a->lock));
+        }
+    }
+    pthread_mutex_unlock(&(a->lock));
+
+    return NULL;
+}
+
+static PyObject *pyion_ltp_aggr_open(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP              *state;
+    LtpAggregator       *a;
+    unsigned long long  destEngineId;
+    Py_ssize_t          size_limit;
+    double              time_limit;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kKnd", (unsigned long *)&state, &destEngineId, &size_limit, &time_limit))
+        return NULL;
+
+    // Check the size limit
+    if (size_limit <= AGGR_HDR_SIZE + AGGR_REC_HDR_SIZE) {
+        pyion_SetExc(PyExc_ValueError, "LTP aggregation size limit must be larger than %d bytes.",
+                     AGGR_HDR_SIZE + AGGR_REC_HDR_SIZE);
+        return NULL;
+    }
+
+    // Allocate memory for the aggregator and initialize to zeros
+    a = (LtpAggregator *)malloc(sizeof(LtpAggregator));
+    if (a == NULL) {
+        pyion_SetExc(PyExc_RuntimeError, "Cannot malloc for LTP aggregator.");
+        return NULL;
+    }
+    memset((char *)a, 0, sizeof(LtpAggregator));
+    a->block = (char *)malloc((size_t)size_limit);
+    if (a->block == NULL) {
+        free(a);
+        pyion_SetExc(PyExc_RuntimeError, "Cannot malloc for LTP aggregator.");
+        return NULL;
+    }
+
+    // Fill it
+    a->state        = state;
+    a->destEngineId = (uvast)destEngineId;
+    a->size_limit   = (size_t)size_limit;
+    a->capacity     = (size_t)size_limit;
+    a->time_limit   = time_limit;
+    aggr_reset(a);
+
+    // Initialize synchronization primitives
+    pthread_mutex_init(&(a->lock), NULL);
+    pthread_cond_init(&(a->changed), NULL);
+
+    // Start the flusher
+    a->running = 1;
+    if (pthread_create(&(a->flusher), NULL, aggr_flusher, a) != 0) {
+        pthread_cond_destroy(&(a->changed));
+        pthread_mutex_destroy(&(a->lock));
+        free(a->block);
+        free(a);
+        pyion_SetExc(PyExc_RuntimeError, "Cannot start LTP aggregator flusher.");
+        return NULL;
+    }
+
+    // Return the memory address of the aggregator as an unsigned long
+    return Py_BuildValue("k", a);
+}
+
+static PyObject *pyion_ltp_aggr_close(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpAggregator *a;
+    LtpAggrBlock blk;
+    int flush, taken = 0;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "ki", (unsigned long *)&a, &flush))
+        return NULL;
+
+    // Stop the flusher and send whatever is pending if requested
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(a->lock));
+    a->running = 0;
+    pthread_cond_broadcast(&(a->changed));
+    if (flush) taken = aggr_take_block(a, &blk);
+    pthread_mutex_unlock(&(a->lock));
+    pthread_join(a->flusher, NULL);
+    if (taken > 0) aggr_send_block(a, &blk, NULL, NULL);
+    Py_END_ALLOW_THREADS
+
+    // Free the aggregator
+    pthread_cond_destroy(&(a->changed));
+    pthread_mutex_destroy(&(a->lock));
+    free(a->block);
+    free(a->spare);
+    free(a);
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_ltp_aggr_send(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpAggregator   *a;
+    LtpAggrBlock    blk;
+    Py_buffer       data;
+    size_t          need;
+    char            *block;
+    int             ok = 1, full = 0, err_code = 0;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "ks*", (unsigned long *)&a, &data))
+        return NULL;
+
+    // Check that the message can be framed
+    if ((unsigned long long)data.len > 0xFFFFFFFFULL) {
+        PyBuffer_Release(&data);
+        pyion_SetExc(PyExc_ValueError, "Message is too large for LTP aggregation.");
+        return NULL;
+    }
+    need = AGGR_REC_HDR_SIZE + (size_t)data.len;
+
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(a->lock));
+
+    // If the message does not fit in the current block, send the block first.
+    // If that fails, the message is not appended.
+    while (ok > 0 && a->count > 0 && a->used + need > a->size_limit) {
+        ok = aggr_take_block(a, &blk);
+        if (ok <= 0) break;
+        pthread_mutex_unlock(&(a->lock));
+        ok = aggr_send_block(a, &blk, NULL, &err_code);
+        pthread_mutex_lock(&(a->lock));
+    }
+
+    // Messages larger than the size limit are sent in a block of their own
+    if (ok > 0 && a->used + need > a->capacity) {
+        block = (char *)realloc(a->block, a->used + need);
+        if (block) {
+            a->block    = block;
+            a->capacity = a->used + need;
+        } else {
+            ok = -2;
+        }
+    }
+
+    // Append the message
+    if (ok > 0) {
+        aggr_put_u32(a->block + a->used, (unsigned int)data.len);
+        memcpy(a->block + a->used + AGGR_REC_HDR_SIZE, data.buf, (size_t)data.len);
+        a->used += need;
+        a->messages++;
+        a->bytes += (unsigned long long)data.len;
+        if (a->count++ == 0) {
+            clock_gettime(CLOCK_REALTIME, &(a->first));
+            pthread_cond_broadcast(&(a->changed));
+        }
+
+        // If the block is full, send it now. If a buffer for the next block
+        // cannot be allocated, the flusher sends it later.
+        if (a->used >= a->size_limit) full = (aggr_take_block(a, &blk) > 0);
+    }
+
+    pthread_mutex_unlock(&(a->lock));
+    if (full) ok = aggr_send_block(a, &blk, NULL, &err_code);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&data);
+
+    // Handle errors
+    if (ok == -2) {
+        pyion_SetExc(PyExc_MemoryError, "Cannot grow LTP aggregation block.");
+        return NULL;
+    }
+    if (ok < 0) {
+        pyion_SetExc(PyExc_RuntimeError, "Error while sending aggregated LTP block (err code=%i).",
+                     err_code);
+        return NULL;
+    }
+
+    Py_RETURN_NONE;
+}
+
+static PyObject *pyion_ltp_aggr_flush(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpAggregator   *a;
+    LtpAggrBlock    blk;
+    unsigned int    sessionNbr = 0;
+    int             ok, err_code = 0;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&a))
+        return NULL;
+
+    // Send the current block
+    Py_BEGIN_ALLOW_THREADS
+    pthread_mutex_lock(&(a->lock));
+    ok = aggr_take_block(a, &blk);
+    pthread_mutex_unlock(&(a->lock));
+    if (ok > 0) ok = aggr_send_block(a, &blk, &sessionNbr, &err_code);
+    Py_END_ALLOW_THREADS
+
+    // Handle errors
+    if (ok == -2) {
+        pyion_SetExc(PyExc_MemoryError, "Cannot allocate the next LTP aggregation block.");
+        return NULL;
+    }
+    if (ok < 0) {
+        pyion_SetExc(PyExc_RuntimeError, "Error while sending aggregated LTP block (err code=%i).",
+                     err_code);
+        return NULL;
+    }
+    if (ok == 0) Py_RETURN_NONE;
+
+    // Register the session so that its outcome is kept until released
+    pthread_mutex_lock(&(a->state->lock));
+    session_register(a->state, sessionNbr);
+    pthread_mutex_unlock(&(a->state->lock));
+
+    return Py_BuildValue("I", sessionNbr);
+}
+
+static PyObject *pyion_ltp_aggr_stats(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpAggregator *a;
+    PyObject *ret;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&a))
+        return NULL;
+
+    pthread_mutex_lock(&(a->lock));
+    ret = Py_BuildValue("{s:I,s:n,s:K,s:K,s:K,s:K,s:K,s:i}",
+                        "pending_messages", a->count,
+                        "pending_bytes", (Py_ssize_t)(a->used - AGGR_HDR_SIZE - AGGR_REC_HDR_SIZE*a->count),
+                        "messages", a->messages,
+                        "bytes", a->bytes,
+                        "blocks", a->blocks,
+                        "timed_flushes", a->timed_flushes,
+                        "errors", a->errors,
+                        "last_err_code", a->last_err_code);
+    pthread_mutex_unlock(&(a->lock));
+
+    return ret;
+}
+
+static PyObject *pyion_ltp_unpack(PyObject *self, PyObject *args) {
+    // Define variables
+    Py_buffer       data;
+    const char      *buf;
+    size_t          pos, len;
+    unsigned int    count, i;
+    PyObject        *ret = NULL, *item;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "y*", &data))
+        return NULL;
+    buf = (const char *)data.buf;
+
+    // Check the header
+    if (data.len < AGGR_HDR_SIZE || buf[0] != 'P' || buf[1] != 'A' || buf[2] != AGGR_VERSION)
+        goto invalid;
+    count = aggr_get_u32(buf + 4);
+
+    // Check that the records fill the block exactly before building anything
+    for (i = 0, pos = AGGR_HDR_SIZE; i < count; i++) {
+        if ((size_t)data.len - pos < AGGR_REC_HDR_SIZE) goto invalid;
+        len = aggr_get_u32(buf + pos);
+        pos += AGGR_REC_HDR_SIZE;
+        if ((size_t)data.len - pos < len) goto invalid;
+        pos += len;
+    }
+    if (pos != (size_t)data.len) goto invalid;
+
+    // Split the block
+    ret = PyList_New(count);
+    for (i = 0, pos = AGGR_HDR_SIZE; ret && i < count; i++) {
+        len  = aggr_get_u32(buf + pos);
+        item = PyBytes_FromStringAndSize(buf + pos + AGGR_REC_HDR_SIZE, (Py_ssize_t)len);
+        if (!item) {
+            Py_CLEAR(ret);
+            break;
+        }
+        PyList_SET_ITEM(ret, i, item);
+        pos += AGGR_REC_HDR_SIZE + len;
+    }
+
+    PyBuffer_Release(&data);
+    return ret;
+
+invalid:
+    PyBuffer_Release(&data);
+    PyErr_SetString(PyExc_ValueError, "Data is not an aggregated LTP block.");
+    return NULL;
+}
+
+/* ============================================================================
+ * === Receive Functionality
+ * ============================================================================ */
+
+static vast notice_read(Object data, char *buf, vast size){
+    /* Copy ``size`` bytes of a notice's data into ``buf``. Returns the number
+       of bytes copied, or -1 with a Python exception set. Must be called
+       holding the GIL, which is released while copying. */
+    ZcoReader	    reader;
+    Sdr             sdr = getIonsdr();
+    vast            len;
+
+    // Prepare to receive the block. A new reader always starts at the
+    // beginning of the data, so the same notice can be read again.
+    zco_start_receiving(data, &reader);
+
+    // Get block data
+    if (!sdr_pybegin_xn(sdr)) return -1;
+    Py_BEGIN_ALLOW_THREADS
+    len = zco_receive_source(sdr, &reader, size, buf);
+    Py_END_ALLOW_THREADS
+    if (!sdr_pyend_xn(sdr)) return -1;
+
+    // Handle error while getting the payload
     if (len < 0) {
-        sprintf(err_msg, "Error extracting data from block");
-        PyErr_SetString(PyExc_IOError, err_msg);
+        PyErr_SetString(PyExc_IOError, "Error extracting data from block");
+        return -1;
+    }
+
+    return len;
+}
+
+static vast notice_length(Object data){
+    // Get the length of a notice's data. Returns -1 with a Python exception set on error
+    Sdr     sdr = getIonsdr();
+    vast    data_size;
+
+    if (!sdr_pybegin_xn(sdr)) return -1;
+    data_size = zco_source_data_length(sdr, data);
+    sdr_exit_xn(sdr);
 
-        // Clean up tasks
-        if (do_malloc) free(payload);
+    return data_size;
+}
+
+static PyObject *notice_payload(LtpSAP *state, Object data, int decode){
+    /* Extract the data of a reception notice and release it. If ``decode``
+       is true, the data is decompressed with the access point's codec. The
+       data is copied from the ZCO directly into a bytes object of the exact
+       size, so no intermediate buffer is used. */
+    PyObject        *ret, *out;
+    vast            len, data_size;
+    int             decoded;
+    char            *output;
+    size_t          output_size;
+
+    // Get content data size
+    data_size = notice_length(data);
+    if (data_size < 0) {
+        ltp_release_data(data);
         return NULL;
     }
 
-    // Build return object
-    PyObject *ret = Py_BuildValue("y#", payload, len);
+    // Allocate the bytes object and fill it with the block's data
+    ret = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)data_size);
+    if (!ret) {
+        ltp_release_data(data);
+        return NULL;
+    }
+    len = notice_read(data, PyBytes_AS_STRING(ret), data_size);
 
     // Release LTP object now that you are done with it.
     ltp_release_data(data);
 
-    // Deallocate memory
-    if (do_malloc) free(payload);
+    // Handle error while getting the payload
+    if (len < 0) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    if (len < data_size && _PyBytes_Resize(&ret, (Py_ssize_t)len) < 0) return NULL;
+
+    // If there is no codec, you are done
+    if (!decode || state->codec.codec == CODEC_NONE) return ret;
+
+    // If the block is compressed, decompress it straight into a new bytes object
+    decoded = codec_decode_size(&(state->codec), PyBytes_AS_STRING(ret), (size_t)len, &output_size);
+    if (decoded > 0 && (out = PyBytes_FromStringAndSize(NULL, (Py_ssize_t)output_size)) == NULL) {
+        Py_DECREF(ret);
+        return NULL;
+    }
+    if (decoded > 0) {
+        output = PyBytes_AS_STRING(out);
+        Py_BEGIN_ALLOW_THREADS
+        decoded = codec_decode_into(&(state->codec), PyBytes_AS_STRING(ret), (size_t)len, output, output_size);
+        Py_END_ALLOW_THREADS
+        Py_DECREF(ret);
+        ret = out;
+    }
+
+    // Handle error while decompressing
+    if (decoded < 0) {
+        Py_DECREF(ret);
+        codec_set_exc(decoded);
+        return NULL;
+    }
+
+    return ret;
+}
+
+static LtpNotice *wait_for_block(LtpSAP *state, double timeout){
+    /* Wait for the next all-red block. Returns NULL and sets a Python exception
+       if another notice is received instead. */
+    char            err_msg[150];
+    LtpNotice       *notice;
+
+    // Wait for the dispatcher to get a reception notice
+    notice = wait_for_notice(state, NOTICE_Q_RECV, timeout);
+    if (!notice) return NULL;
+
+    // Handle different notice types
+    switch (notice->type) {
+        case LtpImportSessionCanceled:      // Cancelled sessions. No data has been received yet.
+            // Release any data and throw exception
+            sprintf(err_msg, "LTP import session cancelled (reason code=%d)", (unsigned int)notice->reasonCode);
+            notice_free(notice);
+            PyErr_SetString(PyExc_RuntimeError, err_msg);
+            return NULL;
+        case LtpRecvRedPart:
+            // If this is not the end of the block, you are dealing with a block that is
+            // partially green, partially red. Use ``ltp_receive_segment`` instead.
+            if (!notice->endOfBlock) {
+                notice_free(notice);
+                PyErr_SetString(PyExc_NotImplementedError, "LTP block has green parts. Use ltp_receive_segment");
+                return NULL;
+            }
+            return notice;
+        default:
+            // Release any data and throw exception
+            notice_free(notice);
+            PyErr_SetString(PyExc_NotImplementedError, "LTP block has green parts. Use ltp_receive_segment");
+            return NULL;
+    }
+}
+
+static PyObject *receive_data(LtpSAP *state, double timeout){
+    // Define variables
+    LtpNotice       *notice;
+	Object		    data;
+
+    // Wait for the dispatcher to get a block
+    notice = wait_for_block(state, timeout);
+    if (!notice) return NULL;
+
+    // Take ownership of the block's data
+    data = notice->data;
+    free(notice);
+
+    // Extract and decompress the block
+    return notice_payload(state, data, 1);
+}
+
+static PyObject *receive_into(LtpSAP *state, Py_buffer *buf, double timeout){
+    /* Receive a block into a buffer provided by the caller. If the buffer is
+       too small, the block is put back in the queue and BufferError is raised,
+       so that the caller can retry with a larger buffer. Blocks that cannot be
+       read are dropped. */
+    LtpNotice       *notice;
+    vast            len, data_size;
+    int             decoded = 0;
+    char            *raw = NULL, *output = NULL;
+    size_t          output_size = 0;
+
+    // Wait for the dispatcher to get a block
+    notice = wait_for_block(state, timeout);
+    if (!notice) return NULL;
+
+    // Get content data size
+    data_size = notice_length(notice->data);
+    if (data_size < 0) goto fail;
+
+    // Without a codec, copy the ZCO straight into the caller's buffer
+    if (state->codec.codec == CODEC_NONE) {
+        if (data_size > (vast)buf->len) {
+            pyion_SetExc(PyExc_BufferError, "LTP block of %lld bytes does not fit in buffer of %lld bytes.",
+                         (long long)data_size, (long long)buf->len);
+            goto requeue;
+        }
+        len = notice_read(notice->data, (char *)buf->buf, data_size);
+        if (len < 0) goto fail;
+        notice_free(notice);
+        return Py_BuildValue("n", (Py_ssize_t)len);
+    }
+
+    // Otherwise, the block must be decompressed before its size is known
+    raw = (char *)malloc(data_size > 0 ? data_size : 1);
+    if (!raw) {
+        PyErr_NoMemory();
+        goto fail;
+    }
+    len = notice_read(notice->data, raw, data_size);
+    if (len < 0) goto fail;
+
+    Py_BEGIN_ALLOW_THREADS
+    decoded = codec_decode(&(state->codec), raw, (size_t)len, &output, &output_size);
+    Py_END_ALLOW_THREADS
+
+    if (decoded < 0) {
+        codec_set_exc(decoded);
+        goto fail;
+    }
+    if (output_size > (size_t)buf->len) {
+        pyion_SetExc(PyExc_BufferError, "LTP block of %lld bytes does not fit in buffer of %lld bytes.",
+                     (long long)output_size, (long long)buf->len);
+        if (decoded > 0) free(output);
+        goto requeue;
+    }
+
+    // Copy the block and clean up
+    memcpy(buf->buf, output, output_size);
+    if (decoded > 0) free(output);
+    free(raw);
+    notice_free(notice);
+    return Py_BuildValue("n", (Py_ssize_t)output_size);
+
+requeue:
+    // Give the block back to the dispatcher's queue
+    free(raw);
+    pthread_mutex_lock(&(state->lock));
+    notice_unpop(&(state->queues[NOTICE_Q_RECV]), notice);
+    pthread_cond_broadcast(&(state->notice_ready));
+    pthread_mutex_unlock(&(state->lock));
+    return NULL;
+
+fail:
+    // The block cannot be delivered. Drop it.
+    free(raw);
+    notice_free(notice);
+    return NULL;
+}
+
+static PyObject *segment_record(LtpSAP *state, LtpNotice *notice){
+    /* Build the (engine id, session number, notice type, offset, data, end of
+       block, reason code) tuple of a reception notice. It takes ownership of
+       the notice. */
+    LtpNotice       info;
+    PyObject        *payload;
+    unsigned int    offset;
+
+    // Take ownership of the notice's data
+    info = *notice;
+    free(notice);
+
+    // Cancelled import sessions carry no data. Report them so that the caller
+    // can discard any segment already received for this block.
+    if (info.type == LtpImportSessionCanceled) {
+        if (info.data) ltp_release_data(info.data);
+        return Py_BuildValue("KIiIOOi", (unsigned long long)info.sessionId.sourceEngineId,
+                             info.sessionId.sessionNbr, (int)info.type, 0, Py_None,
+                             Py_True, (int)info.reasonCode);
+    }
+
+    // The red part always starts at the beginning of the block. Only all-red
+    // blocks can be compressed.
+    if (info.type == LtpRecvRedPart) {
+        offset  = 0;
+        payload = notice_payload(state, info.data, info.endOfBlock);
+    } else {
+        offset  = info.dataOffset;
+        payload = notice_payload(state, info.data, 0);
+    }
+    if (!payload) return NULL;
+
+    return Py_BuildValue("KIiINNi", (unsigned long long)info.sessionId.sourceEngineId,
+                         info.sessionId.sessionNbr, (int)info.type, offset, payload,
+                         PyBool_FromLong(info.endOfBlock), 0);
+}
+
+static PyObject *receive_segment(LtpSAP *state, double timeout){
+    LtpNotice       *notice;
+
+    // Wait for the dispatcher to get a reception notice
+    notice = wait_for_notice(state, NOTICE_Q_RECV, timeout);
+    if (!notice) return NULL;
+
+    return segment_record(state, notice);
+}
+
+static PyObject *receive_many(LtpSAP *state, unsigned int max_blocks, double timeout){
+    /* Drain up to ``max_blocks`` reception notices at once. Blocks until at least
+       one is available. If a notice cannot be extracted, the exception is raised
+       and the notices not processed yet are put back in the queue. */
+    LtpNotice       *notice, *batch = NULL, **tail = &batch, *last;
+    LtpNoticeQueue  *q = &(state->queues[NOTICE_Q_RECV]);
+    unsigned int    n = 1, i;
+    int             qid = NOTICE_Q_RECV;
+    PyObject        *ret, *item;
+
+    // Wait for the first notice. The lock is held on success
+    if (!wait_until(state, queue_not_empty, &qid, timeout)) return NULL;
+
+    // Get all notices already pending in one go
+    batch = notice_pop(q);
+    tail  = &(batch->next);
+    while (n < max_blocks && (notice = notice_pop(q)) != NULL) {
+        *tail = notice;
+        tail  = &(notice->next);
+        n++;
+    }
+    pthread_mutex_unlock(&(state->lock));
+
+    // Build the list of records
+    ret = PyList_New(n);
+    if (!ret) goto requeue;
+    for (i = 0; batch; i++) {
+        notice = batch;
+        batch  = notice->next;
+        item   = segment_record(state, notice);
+        if (!item) {
+            Py_CLEAR(ret);
+            goto requeue;
+        }
+        PyList_SET_ITEM(ret, i, item);
+    }
 
     return ret;
+
+requeue:
+    // Put the remaining notices back at the head of the queue, in order
+    if (!batch) return NULL;
+    for (n = 1, last = batch; last->next; last = last->next) n++;
+    pthread_mutex_lock(&(state->lock));
+    last->next = q->head;
+    q->head    = batch;
+    if (!q->tail) q->tail = last;
+    q->count  += n;
+    pthread_mutex_unlock(&(state->lock));
+    return NULL;
+}
+
+static PyObject *receive_any(LtpSAP **saps, int *left, unsigned int num, double timeout){
+    /* Wait until any of the access points receives a notice. Returns the tuple
+       (index of the access point, record as in ``segment_record``). Access
+       points that are closing are left right away (and marked in ``left``),
+       so that ``ltp_close`` does not wait for this call. Must be called
+       holding the GIL. */
+    struct timespec now, deadline, slice;
+    LtpNotice       *notice = NULL;
+    unsigned int    k, i = 0, alive, start;
+    int             dead, interrupted = 0;
+    unsigned long   seq;
+    PyObject        *rec;
+
+    // Compute the deadline. A negative timeout waits forever.
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    if (timeout >= 0) {
+        deadline.tv_sec  += (time_t)timeout;
+        deadline.tv_nsec += (long)((timeout - (time_t)timeout)*1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    while (1) {
+        // Get the sequence number before checking the queues, so that no
+        // notice is missed in between
+        pthread_mutex_lock(&mux_lock);
+        seq   = mux_seq;
+        start = mux_next;
+        pthread_mutex_unlock(&mux_lock);
+
+        // Check all access points, starting with a different one each time
+        for (k = 0, alive = 0; k < num && !notice; k++) {
+            i = (start + k) % num;
+            if (left[i]) continue;
+            pthread_mutex_lock(&(saps[i]->lock));
+            dead = !(saps[i]->status == SAP_RUNNING && saps[i]->dispatching);
+            if (saps[i]->status == SAP_INTERRUPTING) interrupted = 1;
+            if (!dead) {
+                alive++;
+                notice = notice_pop(&(saps[i]->queues[NOTICE_Q_RECV]));
+            }
+            pthread_mutex_unlock(&(saps[i]->lock));
+            if (dead) {
+                left[i] = 1;
+                leave_access_point(saps[i]);
+            }
+        }
+
+        // If a notice was found, you are done
+        if (notice) break;
+        if (!alive && interrupted) {
+            PyErr_SetString(PyExc_InterruptedError, "LTP reception interrupted.");
+            return NULL;
+        }
+        if (!alive) {
+            PyErr_SetString(PyExc_ConnectionAbortedError, "LTP reception closed in all access points.");
+            return NULL;
+        }
+
+        // Wait for a change in any access point, without the GIL
+        Py_BEGIN_ALLOW_THREADS
+        clock_gettime(CLOCK_REALTIME, &slice);
+        slice.tv_nsec += NOTICE_WAIT_SLICE;
+        if (slice.tv_nsec >= 1000000000L) {
+            slice.tv_sec++;
+            slice.tv_nsec -= 1000000000L;
+        }
+        if (timeout >= 0 && (slice.tv_sec > deadline.tv_sec ||
+            (slice.tv_sec == deadline.tv_sec && slice.tv_nsec > deadline.tv_nsec)))
+            slice = deadline;
+        pthread_mutex_lock(&mux_lock);
+        while (mux_seq == seq && pthread_cond_timedwait(&mux_ready, &mux_lock, &slice) == 0);
+        pthread_mutex_unlock(&mux_lock);
+        Py_END_ALLOW_THREADS
+
+        // Check for signals (only effective in the main thread)
+        if (PyErr_CheckSignals() < 0) return NULL;
+
+        // Check the timeout
+        clock_gettime(CLOCK_REALTIME, &now);
+        if (timeout >= 0 && (now.tv_sec > deadline.tv_sec ||
+            (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec))) {
+            PyErr_SetString(PyExc_TimeoutError, "LTP wait timed out.");
+            return NULL;
+        }
+    }
+
+    // Next time, start with the access point after this one
+    pthread_mutex_lock(&mux_lock);
+    mux_next = i + 1;
+    pthread_mutex_unlock(&mux_lock);
+
+    rec = segment_record(saps[i], notice);
+    if (!rec) return NULL;
+    return Py_BuildValue("IN", i, rec);
 }
 
 static PyObject *pyion_ltp_receive(PyObject *self, PyObject *args) {
@@ -448,20 +2170,329 @@ static PyObject *pyion_ltp_receive(PyObject *self, PyObject *args) {
     LtpSAP   *state;
     PyObject *ret;
     
+    double   timeout;
+    
     // Parse the input tuple. Raises error automatically if not possible
-    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&state))
+    if (!PyArg_ParseTuple(args, "kd", (unsigned long *)&state, &timeout))
         return NULL;
 
     // Trigger reception of data
-    ret = receive_data(state);
+    enter_access_point(state);
+    ret = receive_data(state, timeout);
 
     // Close if necessary. Otherwise set to IDLE
-    if (state->status == SAP_CLOSING) {
-        close_access_point(state);
-    } else {
-        state->status = SAP_IDLE;
-    }
+    leave_access_point(state);
 
     // Return value
     return ret;
-}
\ No newline at end of file
+}
+
+static PyObject *pyion_ltp_receive_into(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP    *state;
+    PyObject  *ret;
+    Py_buffer buf;
+    double    timeout;
+    
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kw*d", (unsigned long *)&state, &buf, &timeout))
+        return NULL;
+
+    // Trigger reception of data
+    enter_access_point(state);
+    ret = receive_into(state, &buf, timeout);
+    leave_access_point(state);
+
+    // Return number of bytes received
+    PyBuffer_Release(&buf);
+    return ret;
+}
+
+static PyObject *pyion_ltp_receive_many(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP       *state;
+    PyObject     *ret;
+    unsigned int max_blocks;
+    double       timeout;
+    
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kId", (unsigned long *)&state, &max_blocks, &timeout))
+        return NULL;
+
+    // Trigger reception of all pending notices
+    enter_access_point(state);
+    ret = receive_many(state, max_blocks > 0 ? max_blocks : 1, timeout);
+    leave_access_point(state);
+
+    return ret;
+}
+
+static PyObject *pyion_ltp_receive_any(PyObject *self, PyObject *args) {
+    // Define variables
+    PyObject     *py_saps, *ret = NULL;
+    LtpSAP       **saps;
+    int          *left;
+    Py_ssize_t   num, i;
+    double       timeout;
+    
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "O!d", &PyTuple_Type, &py_saps, &timeout))
+        return NULL;
+
+    // Get the memory address of all access points
+    num = PyTuple_Size(py_saps);
+    if (num == 0) {
+        PyErr_SetString(PyExc_ValueError, "No LTP access points to receive from.");
+        return NULL;
+    }
+    saps = (LtpSAP **)malloc(num*sizeof(LtpSAP *));
+    left = (int *)calloc(num, sizeof(int));
+    if (!saps || !left) {
+        free(saps);
+        free(left);
+        return PyErr_NoMemory();
+    }
+    for (i = 0; i < num; i++) {
+        saps[i] = (LtpSAP *)PyLong_AsUnsignedLong(PyTuple_GET_ITEM(py_saps, i));
+        if (PyErr_Occurred()) {
+            free(saps);
+            free(left);
+            return NULL;
+        }
+    }
+
+    // Trigger reception from any access point
+    for (i = 0; i < num; i++) enter_access_point(saps[i]);
+    ret = receive_any(saps, left, (unsigned int)num, timeout);
+    for (i = 0; i < num; i++)
+        if (!left[i]) leave_access_point(saps[i]);
+
+    free(saps);
+    free(left);
+    return ret;
+}
+
+static PyObject *pyion_ltp_receive_segment(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP   *state;
+    PyObject *ret;
+    double   timeout;
+    
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kd", (unsigned long *)&state, &timeout))
+        return NULL;
+
+    // Trigger reception of the next red part or green segment
+    enter_access_point(state);
+    ret = receive_segment(state, timeout);
+    leave_access_point(state);
+
+    return ret;
+}
+
+static PyObject *pyion_ltp_export_events(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP       *state;
+    LtpNotice    *notice, *batch = NULL, **tail = &batch;
+    unsigned int max_events, n = 1, i;
+    double       timeout;
+    PyObject     *ret, *item;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kId", (unsigned long *)&state, &max_events, &timeout))
+        return NULL;
+
+    // Wait for the first notice
+    enter_access_point(state);
+    notice = wait_for_notice(state, NOTICE_Q_EXPORT, timeout);
+    if (!notice) {
+        leave_access_point(state);
+        return NULL;
+    }
+
+    // Get all other notices already pending
+    *tail = notice;
+    tail  = &(notice->next);
+    pthread_mutex_lock(&(state->lock));
+    while (n < max_events && (notice = notice_pop(&(state->queues[NOTICE_Q_EXPORT]))) != NULL) {
+        *tail = notice;
+        tail  = &(notice->next);
+        n++;
+    }
+    pthread_mutex_unlock(&(state->lock));
+    leave_access_point(state);
+
+    // Build the list of events
+    ret = PyList_New(n);
+    for (i = 0, notice = batch; notice; i++, notice = batch) {
+        batch = notice->next;
+        item  = Py_BuildValue("(KIii)", (unsigned long long)notice->sessionId.sourceEngineId,
+                              notice->sessionId.sessionNbr, (int)notice->type,
+                              (int)notice->reasonCode);
+        if (ret && item) {
+            PyList_SET_ITEM(ret, i, item);
+        } else {
+            Py_XDECREF(item);
+            Py_CLEAR(ret);
+        }
+        notice_free(notice);
+    }
+
+    return ret;
+}
+
+static PyObject *pyion_ltp_notice_stats(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP   *state;
+    PyObject *ret;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "k", (unsigned long *)&state))
+        return NULL;
+
+    // Build the dictionary while holding the lock
+    pthread_mutex_lock(&(state->lock));
+    ret = Py_BuildValue("{s:n,s:n,s:n,s:K,s:K,s:K,s:i}",
+                        "recv_pending", (Py_ssize_t)state->queues[NOTICE_Q_RECV].count,
+                        "sessions", (Py_ssize_t)state->num_sessions,
+                        "export_pending", (Py_ssize_t)state->queues[NOTICE_Q_EXPORT].count,
+                        "recv_notices", state->notices[NOTICE_Q_RECV],
+                        "export_notices", state->notices[NOTICE_Q_EXPORT],
+                        "dropped", state->dropped,
+                        "dispatching", state->dispatching);
+    pthread_mutex_unlock(&(state->lock));
+
+    return ret;
+}
+
+/* ============================================================================
+ * === Export Session Functionality
+ * ============================================================================ */
+
+// Export sessions that a call to ``ltp_session_wait`` is waiting for
+typedef struct {
+    unsigned int *nbrs;
+    Py_ssize_t num;
+    int all;
+} LtpSessionWait;
+
+static Py_ssize_t sessions_resolved(LtpSAP *state, LtpSessionWait *w, unsigned int *out) {
+    /* Count the resolved sessions, and copy their numbers to ``out`` if not NULL.
+       Unknown sessions count as resolved. Must be called holding the lock. */
+    LtpExportSession *es;
+    Py_ssize_t i, n = 0;
+
+    for (i = 0; i < w->num; i++) {
+        es = session_find(state, w->nbrs[i], 0);
+        if (es && es->status == EXPORT_PENDING) continue;
+        if (out) out[n] = w->nbrs[i];
+        n++;
+    }
+
+    return n;
+}
+
+static int sessions_ready(LtpSAP *state, void *arg) {
+    LtpSessionWait *w = (LtpSessionWait *)arg;
+    Py_ssize_t n = sessions_resolved(state, w, NULL);
+    return w->all ? (n == w->num) : (n > 0);
+}
+
+static PyObject *pyion_ltp_session_status(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP           *state;
+    LtpExportSession *es;
+    unsigned int     sessionNbr;
+    int              found, status = 0, reason = 0;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kI", (unsigned long *)&state, &sessionNbr))
+        return NULL;
+
+    // Find the session
+    pthread_mutex_lock(&(state->lock));
+    es = session_find(state, sessionNbr, 0);
+    found = (es != NULL);
+    if (found) {
+        status = (int)es->status;
+        reason = es->reasonCode;
+    }
+    pthread_mutex_unlock(&(state->lock));
+
+    // If not found, return None
+    if (!found) Py_RETURN_NONE;
+
+    return Py_BuildValue("(ii)", status, reason);
+}
+
+static PyObject *pyion_ltp_session_wait(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP         *state;
+    PyObject       *py_nbrs, *ret, *item;
+    LtpSessionWait w;
+    double         timeout;
+    Py_ssize_t     i, num;
+    int            ok;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kO!id", (unsigned long *)&state, &PyTuple_Type, &py_nbrs,
+                          &(w.all), &timeout))
+        return NULL;
+
+    // Get the session numbers. The second half of the array gets the resolved ones.
+    w.num  = PyTuple_Size(py_nbrs);
+    w.nbrs = (unsigned int *)malloc((2*w.num + 1)*sizeof(unsigned int));
+    if (!w.nbrs) return PyErr_NoMemory();
+    for (i = 0; i < w.num; i++) {
+        w.nbrs[i] = (unsigned int)PyLong_AsUnsignedLong(PyTuple_GET_ITEM(py_nbrs, i));
+        if (PyErr_Occurred()) {
+            free(w.nbrs);
+            return NULL;
+        }
+    }
+
+    // Wait. If the timeout expires, return the sessions resolved so far.
+    enter_access_point(state);
+    ok = wait_until(state, sessions_ready, &w, timeout);
+    if (!ok && PyErr_ExceptionMatches(PyExc_TimeoutError)) {
+        PyErr_Clear();
+        pthread_mutex_lock(&(state->lock));
+        ok = 1;
+    }
+
+    // Copy the resolved sessions holding the lock, so that the notice dispatcher
+    // is not blocked while the Python objects are built
+    num = 0;
+    if (ok) {
+        num = sessions_resolved(state, &w, w.nbrs + w.num);
+        pthread_mutex_unlock(&(state->lock));
+    }
+    leave_access_point(state);
+
+    // Build the list of resolved sessions
+    ret = ok ? PyList_New(num) : NULL;
+    for (i = 0; ret && i < num; i++) {
+        item = PyLong_FromUnsignedLong(w.nbrs[w.num + i]);
+        if (!item) Py_CLEAR(ret); else PyList_SET_ITEM(ret, i, item);
+    }
+    free(w.nbrs);
+
+    return ret;
+}
+
+static PyObject *pyion_ltp_session_release(PyObject *self, PyObject *args) {
+    // Define variables
+    LtpSAP       *state;
+    unsigned int sessionNbr;
+
+    // Parse the input tuple. Raises error automatically if not possible
+    if (!PyArg_ParseTuple(args, "kI", (unsigned long *)&state, &sessionNbr))
+        return NULL;
+
+    // Forget the session
+    pthread_mutex_lock(&(state->lock));
+    session_release(state, sessionNbr);
+    pthread_mutex_unlock(&(state->lock));
+
+    Py_RETURN_NONE;
+}
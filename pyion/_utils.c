@@ -32,7 +32,7 @@ static void pyion_SetExc(PyObject *exception, const char *fmt, ...) {
     va_start(args, fmt);
 
     // Create the error string
-    sprintf(err_msg, fmt, args);
+    vsnprintf(err_msg, sizeof(err_msg), fmt, args);
 
     // Set the Python error
     PyErr_SetString(exception, err_msg);
@@ -48,7 +48,7 @@ static void pyion_vSetExc(PyObject *exception, const char *fmt, va_list args) {
     char err_msg[150];
 
     // Create the error string
-    sprintf(err_msg, fmt, args);
+    vsnprintf(err_msg, sizeof(err_msg), fmt, args);
 
     // Set the Python error
     PyErr_SetString(exception, err_msg);
@@ -63,7 +63,7 @@ static void pyion_debug(const char *fmt, ...) {
     va_start(args, fmt);
 
     // Create the error string
-    sprintf(err_msg, fmt, args);
+    vsnprintf(err_msg, sizeof(err_msg), fmt, args);
 
     // Print result
     puts(err_msg);
@@ -10,6 +10,8 @@
 """
 
 # General imports
+import os
+import time
 from unittest.mock import Mock
 from warnings import warn
 
@@ -27,8 +29,10 @@ except ImportError:
 _cgr    = ['cgr_list_contacts', 'cgr_list_ranges', 'cgr_add_contact', 
            'cgr_add_range', 'cgr_delete_contact', 'cgr_delete_range']
 _bp     = ['bp_endpoint_exists', 'bp_add_endpoint', 'bp_list_endpoints']
-_ltp    = ['ltp_span_exists', 'ltp_update_span', 'ltp_info_span']
-_cfdp   = ['cfdp_update_pdu_size']
+_ltp    = ['ltp_span_exists', 'ltp_update_span', 'ltp_info_span', 'ltp_span_sampler',
+           'LtpSpanSampler']
+_cfdp   = ['cfdp_update_pdu_size', 'cfdp_get_pdu_size', 'cfdp_optimal_pdu_size', 
+           'cfdp_tune_pdu_size', 'cfdp_benchmark_pdu_size']
 __all__ = _cgr + _bp + _ltp + _cfdp
 
 # ============================================================================
@@ -224,13 +228,171 @@ def ltp_update_span(engine_nbr, max_segment_size, ip_addr, udp_port, udp_rate=0,
     _admin.ltp_update_span(engine_nbr, max_export_sessions, max_import_sessions, max_segment_size,
                             agg_size_limit, agg_time_limit, lso_cmd, q_lat, int(purge))
 
+def ltp_span_sampler(period=1.0, capacity=3600):
+    """ Start sampling the live state of all LTP spans (active sessions, 
+        queued segments and bytes, segments sent and retransmitted). Samples
+        are taken by a native thread and do not require the GIL.
+
+        :param float period: Time between samples in [sec]. Defaults to 1 sec.
+        :param int capacity: Number of samples kept per span (at most 2**20).
+                             Older samples are overwritten. Defaults to 3600.
+        :return LtpSpanSampler: Stop it when no longer needed.
+    """
+    return LtpSpanSampler(_admin.ltp_sampler_start(float(period), int(capacity)))
+
+class LtpSpanSampler():
+    """ Time series of the live state of the LTP spans. Do not instantiate
+        it manually, use ``ltp_span_sampler``.
+    """
+    def __init__(self, sampler_addr):
+        self._sampler_addr = sampler_addr
+
+    def __del__(self):
+        self.stop()
+
+    @property
+    def is_running(self):
+        """ Returns True if the sampler has not been stopped """
+        return self._sampler_addr is not None
+
+    def series(self, engine_nbr=None):
+        """ Get the samples collected so far, from oldest to newest
+
+            :param int engine_nbr: Peer engine number. Defaults to None (all spans)
+            :return Dict: If ``engine_nbr`` is None, {engine number: series}. 
+                          Otherwise, the series of that span. A series is a
+                          dictionary with lists ``time``, ``export_sessions``,
+                          ``import_sessions``, ``queued_segments``, ``buffered_bytes``,
+                          ``segments_sent`` and ``retransmissions`` (the last two
+                          are cumulative, and -1 if ION does not keep span statistics).
+        """
+        if not self.is_running:
+            raise RuntimeError('LTP span sampler is stopped')
+        series = _admin.ltp_sampler_series(self._sampler_addr, 0 if engine_nbr is None else engine_nbr)
+        alloc_errors = _admin.ltp_sampler_stats(self._sampler_addr)['alloc_errors']
+        if alloc_errors > 0:
+            warn('LTP span sampler could not allocate memory for a span {} times. '
+                 'Some spans may be missing or incomplete.'.format(alloc_errors))
+        if engine_nbr is None: return series
+        if engine_nbr not in series:
+            raise KeyError('No samples for LTP span to engine {}.'.format(engine_nbr))
+        return series[engine_nbr]
+
+    @property
+    def stats(self):
+        """ Number of samples taken and errors. ``alloc_errors`` counts the
+            samples lost because a span series could not be allocated.
+            Returns a dictionary
+        """
+        if not self.is_running: return {}
+        return _admin.ltp_sampler_stats(self._sampler_addr)
+
+    def stop(self):
+        """ Stop the sampler and free its memory """
+        if not self.is_running: return
+        _admin.ltp_sampler_stop(self._sampler_addr)
+        self._sampler_addr = None
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.stop()
+
 # ============================================================================
 # === CFDP-related functions
 # ============================================================================
 
+# Largest CFDP PDU size considered when tuning it [bytes]
+CFDP_MAX_PDU_SIZE = 65000
+
+# Overhead of a CFDP file data PDU: fixed header, entity IDs and transaction
+# sequence number (up to 8 bytes each), and segment offset [bytes]
+CFDP_PDU_OVERHEAD = 4 + 3*8 + 4
+
 def cfdp_update_pdu_size(pdu_size):
-    """ Update the PDU size of the local CFDP engine
+    """ Update the PDU size of the local CFDP engine. It applies to new transactions.
+
+        :param int: Max PDU size in [bytes]. Must be positive, otherwise 
+                    ``ValueError`` is raised.
+        :return int: Max PDU size in effect in [bytes]
+    """
+    return _admin.cfdp_pdu_size(int(pdu_size))
+
+def cfdp_get_pdu_size():
+    """ Get the PDU size of the local CFDP engine
+
+        :return int: Max PDU size in [bytes]
+    """
+    return _admin.cfdp_pdu_size()
+
+def cfdp_optimal_pdu_size(engine_nbr, bundle_overhead=64, pdu_overhead=CFDP_PDU_OVERHEAD,
+                          max_pdu_size=CFDP_MAX_PDU_SIZE):
+    """ Derive the PDU size that makes the best use of the LTP span toward
+        a peer. Each CFDP file data PDU travels in one bundle, which LTP splits
+        into segments of ``max_segment_size``. The PDU size is chosen so that
+        PDU and bundle fill a whole number of segments (i.e., no nearly empty
+        last segment), using as many segments as ``max_pdu_size`` allows to
+        amortize the per-PDU and per-bundle overhead.
+
+        :param int engine_nbr: Peer LTP engine number.
+        :param int bundle_overhead: Bytes added by BP to each PDU (primary and
+                                    payload block headers, extension blocks).
+        :param int pdu_overhead: Bytes of the CFDP PDU header.
+        :param int max_pdu_size: Largest PDU size allowed in [bytes].
+        :return int: PDU size in [bytes]
+    """
+    seg_size = _admin.ltp_span_segment_size(engine_nbr)
+    overhead = bundle_overhead + pdu_overhead
+
+    # Number of LTP segments per PDU (at least one, even if not full)
+    num_segs = max(1, (max_pdu_size + overhead) // seg_size)
+    return max(1, min(max_pdu_size, num_segs*seg_size - overhead))
 
-        :param int: Max PDU size in [bytes]
+def cfdp_tune_pdu_size(engine_nbr, **kwargs):
+    """ Set the PDU size of the local CFDP engine to the optimal one for
+        the LTP span toward a peer (see ``cfdp_optimal_pdu_size``). It
+        applies to new transactions.
+
+        :param int engine_nbr: Peer LTP engine number.
+        :param **kwargs: See ``cfdp_optimal_pdu_size``
+        :return int: PDU size in [bytes]
+    """
+    return cfdp_update_pdu_size(cfdp_optimal_pdu_size(engine_nbr, **kwargs))
+
+def cfdp_benchmark_pdu_size(entity, pdu_sizes, file_size=10485760, dest_file='/tmp/pyion_pdu_bench',
+                            repeats=1, timeout=600):
+    """ Measure the CFDP throughput with different PDU sizes, by sending a file
+        of random data with an entity (typically, to this same node over a 
+        loopback span). The original PDU size is restored at the end.
+
+        :param Entity entity: CFDP entity used to send the file.
+        :param list pdu_sizes: PDU sizes to test in [bytes].
+        :param int file_size: Size of the file sent in [bytes].
+        :param str dest_file: Name of the file at the receiving node.
+        :param int repeats: Number of files sent per PDU size.
+        :param float timeout: Max time per file in [sec].
+        :return List[Tuple]: (PDU size, throughput in [bytes/sec]) for each size.
+                             The throughput is 0 if all transactions failed.
     """
-    _admin.cfdp_update_pdu_size(pdu_size)
\ No newline at end of file
+    data, orig, results = os.urandom(file_size), cfdp_get_pdu_size(), []
+
+    try:
+        for pdu_size in pdu_sizes:
+            cfdp_update_pdu_size(pdu_size)
+            elapsed, ok = 0.0, 0
+            for _ in range(repeats):
+                start = time.time()
+                tr    = entity.cfdp_send_bytes(data, dest_file)
+                try:
+                    tr.result(timeout=timeout)
+                    elapsed += time.time() - start
+                    ok      += 1
+                except (TimeoutError, ConnectionError) as e:
+                    if not tr.done(): tr.cancel()
+                    warn('CFDP transaction with PDU size {} failed: {}'.format(pdu_size, e))
+            results.append((pdu_size, ok*file_size/elapsed if ok else 0.0))
+    finally:
+        cfdp_update_pdu_size(orig)
+
+    return results
\ No newline at end of file
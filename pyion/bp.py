@@ -11,6 +11,7 @@
 """
 
 # General imports
+from collections import namedtuple
 from unittest.mock import Mock
 import os
 from pathlib import Path
@@ -30,7 +31,13 @@ except ImportError:
 	_bp = Mock()
 
 # Define all methods/vars exposed at pyion
-__all__ = ['Endpoint']
+__all__ = ['Endpoint', 'SendQueue', 'Tracker', 'BpReport']
+
+# Administrative record returned by ``Endpoint.bp_receive_reports``. Times are
+# in seconds since the DTN epoch (2000/01/01). For status reports, ``flags``
+# are ``BpReportsEnum`` flags. For custody signals, it is 1 if custody was accepted.
+BpReport = namedtuple('BpReport', ['kind', 'source_eid', 'creation_time', 'creation_count',
+								   'frag_offset', 'frag_length', 'flags', 'reason', 'time'])
 
 # ============================================================================
 # === Endpoint object
@@ -48,7 +55,8 @@ class Endpoint():
 						 C Extension. Do not modify or potential memory leak 						
 	"""
 	def __init__(self, proxy, eid, sap_addr, TTL, priority, report_eid,
-				 custody, report_flags, ack_req, retx_timer, detained, chunk_size):
+				 custody, report_flags, ack_req, retx_timer, detained, chunk_size,
+				 sub_priority=1):
 		""" Endpoint initializer  """
 		# Store variables
 		self.proxy        = proxy
@@ -64,10 +72,9 @@ class Endpoint():
 		self.retx_timer   = retx_timer
 		self.chunk_size   = chunk_size
 		self.detained     = detained
+		self.sub_priority = sub_priority	# Also known as ``ordinal``
 
-		# TODO: This properties are hard-coded because they are not 
-		# yet supported
-		self.sub_priority = 1	# Also known as ``ordinal``
+		# TODO: This property is hard-coded because it is not yet supported
 		self.criticality  = ~int(BpEcsEnumeration.BP_MINIMUM_LATENCY)
 
 		# Mark if the endpoint is blocked 
@@ -110,16 +117,21 @@ class Endpoint():
 	@utils.in_ion_folder
 	def bp_send(self, dest_eid, data, TTL=None, priority=None,
 				report_eid=None, custody=None, report_flags=None,
-				ack_req=None, retx_timer=None, chunk_size=None):
+				ack_req=None, retx_timer=None, chunk_size=None,
+				sub_priority=None):
 		""" Send data through the proxy
 
 			:param dest_eid: Destination EID for this data
 			:param data: Data to send as ``bytes``, ``bytearray`` or a ``memoryview``
 			:param **kwargs: See ``Proxy.bp_open``
+			:return: Handle (creation time, creation count) of the bundle, or list
+					 of handles if sent in chunks. See ``Tracker``. The handle is
+					 None if this endpoint is not detained.
 		"""
 		# Get default values if necessary
 		if TTL is None: TTL = self.TTL
 		if priority is None: priority = self.priority
+		if sub_priority is None: sub_priority = self.sub_priority
 		if report_eid is None: report_eid = self.report_eid
 		if custody is None: custody = self.custody
 		if report_flags is None: report_flags = self.report_flags
@@ -131,12 +143,14 @@ class Endpoint():
 		if retx_timer>0 and not self.detained:
 			raise ConnectionError('This endpoint is not detained. You cannot set up custodial timers.')
 
+		# Bundles are indexed in the proxy's tracker, if any
+		tracker = self.proxy._tracker_addr
+
 		# If you need to send in full, do it
 		if chunk_size is None:
-			_bp.bp_send(self._sap_addr, dest_eid, report_eid, TTL, priority,
+			return _bp.bp_send(self._sap_addr, dest_eid, report_eid, TTL, priority,
 							  custody, report_flags, int(ack_req), retx_timer, 
-							  data)
-			return
+							  sub_priority, tracker, data)
 
 		# If data is a string, then encode it to get a bytes object
 		if isinstance(data, str): data = data.encode('utf-8')
@@ -147,10 +161,25 @@ class Endpoint():
 		# Send data in chuncks of chunk_size bytes
 		# NOTE: If data is not a multiple of chunk_size, the memoryview
 		#  		object returns the correct end of the buffer.
-		for i in range(0, len(memv), chunk_size):
-			_bp.bp_send(self._sap_addr, dest_eid, report_eid, TTL, priority,
+		return [_bp.bp_send(self._sap_addr, dest_eid, report_eid, TTL, priority,
 							  custody, report_flags, int(ack_req), retx_timer,
-							  memv[i:(i+chunk_size)].tobytes())
+							  sub_priority, tracker, memv[i:(i+chunk_size)].tobytes())
+				for i in range(0, len(memv), chunk_size)]
+
+	@utils._chk_is_open
+	def bp_enqueue(self, dest_eid, data, **kwargs):
+		""" Send data through the proxy's priority send queue. This call
+			does not wait for the data to be handed to BP.
+
+			.. Tip:: Use ``chunk_size`` to send large transfers. Chunks of
+					 different transfers with the same priority are interleaved,
+					 and higher priority data is sent in between chunks.
+
+			:param dest_eid: Destination EID for this data
+			:param data: Data to send as ``bytes``, ``bytearray`` or a ``memoryview``
+			:param **kwargs: See ``Endpoint.bp_send``
+		"""
+		self.proxy.bp_send_queue().send(self, dest_eid, data, **kwargs)
 
 	def bp_send_file(self, dest_eid, file_path, **kwargs):
 		""" Convenience function to send a file
@@ -262,6 +291,70 @@ class Endpoint():
 
 		return self.result
 
+	@utils._chk_is_open
+	def bp_receive_reports(self, max_records=1024, timeout=None):
+		""" Receive status reports and custody signals sent to this endpoint
+			(i.e., this endpoint is the ``report_eid`` of other endpoints). This 
+			is a BLOCKING call until at least one bundle is received, and then all
+			records already pending are returned at once. Bundles that are not
+			administrative records are dropped. If the proxy has a ``Tracker``,
+			it is updated with these records. If an error or interruption ends
+			a batch that has records, they are returned and the error is raised
+			by the next call.
+
+			:param max_records: Max number of records to return
+			:param timeout: Max time to wait for the first record in [sec]. 
+							Defaults to None, i.e., wait forever
+			:return: List of tuples with the same fields as ``BpReport``
+		"""
+		# Open another thread because otherwise you cannot handle a SIGINT
+		timeout = -1 if timeout is None else int(timeout)
+		th = Thread(target=self._bp_receive_reports, args=(max_records, timeout), daemon=True)
+		th.start()
+		th.join()
+
+		# If exception, raise it
+		if isinstance(self.result, Exception):
+			raise self.result
+
+		return self.result
+
+	@utils.in_ion_folder
+	def _bp_receive_reports(self, max_records, timeout):
+		""" Receive a batch of administrative records """
+		try:
+			self.result = _bp.bp_receive_reports(self._sap_addr, max_records, timeout,
+												 self.proxy._tracker_addr)
+		except BaseException as e:
+			self.result = e
+
+	@utils._chk_is_open
+	def set_codec(self, codec, level=0, min_size=None, max_size=None):
+		""" Compress the payload of the bundles sent by ``bp_send``, and
+			decompress the payload of bundles received by ``bp_receive``. 
+			Small or incompressible payloads are sent as is, so the receiving
+			endpoint must also have a codec (any) to handle mixed traffic.
+
+			:param codec: ``CodecEnum`` value. ``CodecEnum.NONE`` disables it
+			:param level: LZ4 acceleration or zstd level. Defaults to 0 (codec default)
+			:param min_size: Payloads with fewer bytes are not compressed. Defaults to 64
+			:param max_size: Received payloads that decompress to more bytes are
+							 rejected as corrupted. Defaults to 64 MB
+		"""
+		if min_size is None: min_size = _bp.CODEC_MIN_SIZE
+		if max_size is None: max_size = _bp.CODEC_MAX_SIZE
+		_bp.bp_set_codec(self._sap_addr, int(codec), int(level), int(min_size), int(max_size))
+
+	@property
+	def codec_stats(self):
+		""" Compression statistics of this endpoint (payloads and bytes in/out,
+			compression ratio and CPU time in [sec] for sending and receiving)
+
+			:return: Dictionary
+		"""
+		if not self.is_open: return {}
+		return _bp.bp_codec_stats(self._sap_addr)
+
 	def __enter__(self):
 		""" Allows an endpoint to be used as context manager """
 		return self
@@ -276,3 +369,222 @@ class Endpoint():
 	def __repr__(self):
 		return '<Endpoint: {} ({})>'.format(self.eid, self._sap_addr)
 
+# ============================================================================
+# === SendQueue object
+# ============================================================================
+
+class SendQueue():
+	""" Multi-class send queue shared by all endpoints of a proxy. Do not 
+		instantiate it manually, use ``BpProxy.bp_send_queue`` instead.
+
+		Data is sent by a dispatcher thread in the C Extension. It always
+		serves the highest ``BpPriorityEnum`` class first and, within a class,
+		the highest sub-priority (ordinal). Note that ION itself only honors
+		the ordinal for bundles with expedited priority.
+
+		:ivar proxy: Proxy that created this queue.
+		:ivar _queue_addr: Memory address of the BpSendQueue object used by the 
+						   C Extension. Do not modify or potential memory leak
+	"""
+	def __init__(self, proxy, queue_addr):
+		""" SendQueue initializer """
+		self.proxy       = proxy
+		self._queue_addr = queue_addr
+		self.node_dir    = proxy.node_dir
+
+	@property
+	def is_open(self):
+		""" Returns True if this queue is opened """
+		return (self.proxy is not None and self._queue_addr is not None)
+
+	@utils._chk_is_open
+	def send(self, ept, dest_eid, data, TTL=None, priority=None, sub_priority=None,
+			 report_eid=None, custody=None, report_flags=None, ack_req=None,
+			 retx_timer=None, chunk_size=None):
+		""" Enqueue data to be sent through an endpoint
+
+			:param ept: Endpoint object to send the data from
+			:param dest_eid: Destination EID for this data
+			:param data: Data to send as ``str``, ``bytes``, ``bytearray`` or a ``memoryview``
+			:param **kwargs: See ``Proxy.bp_open``
+		"""
+		# Get default values if necessary
+		if TTL is None: TTL = ept.TTL
+		if priority is None: priority = ept.priority
+		if sub_priority is None: sub_priority = ept.sub_priority
+		if report_eid is None: report_eid = ept.report_eid
+		if custody is None: custody = ept.custody
+		if report_flags is None: report_flags = ept.report_flags
+		if ack_req is None: ack_req = ept.ack_req
+		if retx_timer is None: retx_timer = ept.retx_timer
+		if chunk_size is None: chunk_size = ept.chunk_size
+
+		# If this endpoint is not detained, you cannot use a retx_timer
+		if retx_timer>0 and not ept.detained:
+			raise ConnectionError('This endpoint is not detained. You cannot set up custodial timers.')
+
+		# If data is a string, then encode it to get a bytes object
+		if isinstance(data, str): data = data.encode('utf-8')
+
+		_bp.bp_queue_send(self._queue_addr, ept._sap_addr, dest_eid, report_eid, TTL,
+						  int(priority), sub_priority, int(custody), int(report_flags),
+						  int(ack_req), retx_timer, ept.proxy._tracker_addr, chunk_size or 0, data)
+
+	@utils._chk_is_open
+	def flush(self, timeout=None):
+		""" Block until all enqueued data has been handed to BP
+
+			:param timeout: Time to wait in [seconds]. Defaults to forever
+			:return: True if the queue is empty
+		"""
+		return _bp.bp_queue_flush(self._queue_addr, -1.0 if timeout is None else float(timeout))
+
+	@utils._chk_is_open
+	def purge(self, ept):
+		""" Drop all data enqueued by an endpoint that has not been sent yet
+
+			:param ept: Endpoint object
+		"""
+		_bp.bp_queue_purge(self._queue_addr, ept._sap_addr)
+
+	@property
+	def stats(self):
+		""" Counters of this queue. Entries with one value per class of service
+			are ordered as (bulk, standard, expedited).
+
+			:return: Dictionary
+		"""
+		if not self.is_open: return {}
+		return _bp.bp_queue_stats(self._queue_addr)
+
+	def _close(self):
+		""" Stop the dispatcher and free C memory. Any data not sent is lost.
+
+			.. Danger:: DO NOT call this function directly. Use the Proxy ``close``
+						function instead
+		"""
+		if not self.is_open:
+			return
+		_bp.bp_queue_close(self._queue_addr)
+		self._queue_addr = None
+		self.proxy       = None
+
+	def __str__(self):
+		return '<SendQueue: {}>'.format('Open' if self.is_open else 'Closed')
+
+	def __repr__(self):
+		return '<SendQueue: {}>'.format(self._queue_addr)
+
+# ============================================================================
+# === Tracker object
+# ============================================================================
+
+class Tracker():
+	""" Index of the bundles sent by the endpoints of a proxy that are still
+		waiting for a report. Do not instantiate it manually, use 
+		``BpProxy.bp_tracker`` instead.
+
+		Bundles are identified by the handle returned by ``Endpoint.bp_send``,
+		i.e., a tuple (creation time, creation count). The index is updated
+		when reports are received with ``Endpoint.bp_receive_reports`` from
+		the bundles' report-to endpoint. Bundles whose TTL elapses without a
+		report are dropped and counted as expired.
+
+		:ivar proxy: Proxy that created this tracker.
+		:ivar _tracker_addr: Memory address of the BpTracker object used by the 
+							 C Extension. Do not modify or potential memory leak
+	"""
+	def __init__(self, proxy, tracker_addr):
+		""" Tracker initializer """
+		self.proxy         = proxy
+		self._tracker_addr = tracker_addr
+		self.node_dir      = proxy.node_dir
+
+	@property
+	def is_open(self):
+		""" Returns True if this tracker is opened """
+		return (self.proxy is not None and self._tracker_addr is not None)
+
+	@utils._chk_is_open
+	def lookup(self, handle):
+		""" Check if a bundle is still outstanding
+
+			:param handle: Tuple (creation time, creation count)
+			:return: None if delivered (or unknown), (size, remaining TTL) otherwise
+		"""
+		return _bp.bp_tracker_lookup(self._tracker_addr, handle[0], handle[1])
+
+	@utils._chk_is_open
+	def wait_delivered(self, n, timeout=None):
+		""" Block until ``n`` bundles have been delivered since this tracker
+			was created (see ``stats['completed']``)
+
+			:param n: Number of bundles
+			:param timeout: Time to wait in [seconds]. Defaults to forever
+			:return: True if ``n`` bundles were delivered
+		"""
+		return self._wait(0, n, timeout)
+
+	@utils._chk_is_open
+	def wait_all(self, timeout=None, max_in_flight=0):
+		""" Block until at most ``max_in_flight`` bundles are outstanding
+
+			:param timeout: Time to wait in [seconds]. Defaults to forever
+			:param max_in_flight: Number of bundles still allowed in flight
+			:return: True if the condition was met
+		"""
+		return self._wait(1, max_in_flight, timeout)
+
+	def _wait(self, mode, n, timeout):
+		""" Wait in another thread, otherwise you cannot handle a SIGINT """
+		timeout = -1.0 if timeout is None else float(timeout)
+		th = Thread(target=self._wait_thread, args=(mode, n, timeout), daemon=True)
+		th.start()
+		th.join()
+
+		# If exception, raise it
+		if isinstance(self.result, Exception):
+			raise self.result
+
+		return self.result
+
+	def _wait_thread(self, mode, n, timeout):
+		""" Wait for the tracker condition """
+		try:
+			self.result = _bp.bp_tracker_wait(self._tracker_addr, mode, n, timeout)
+		except BaseException as e:
+			self.result = e
+
+	@property
+	def outstanding(self):
+		""" Handles of all outstanding bundles """
+		if not self.is_open: return []
+		return _bp.bp_tracker_outstanding(self._tracker_addr)
+
+	@property
+	def stats(self):
+		""" Counters of this tracker (bundles in flight and their bytes, 
+			completed, failed, expired, and custody refusals)
+
+			:return: Dictionary
+		"""
+		if not self.is_open: return {}
+		return _bp.bp_tracker_stats(self._tracker_addr)
+
+	def _close(self):
+		""" Free C memory.
+
+			.. Danger:: DO NOT call this function directly. Use the Proxy ``close``
+						function instead
+		"""
+		if not self.is_open:
+			return
+		_bp.bp_tracker_close(self._tracker_addr)
+		self._tracker_addr = None
+		self.proxy         = None
+
+	def __str__(self):
+		return '<Tracker: {}>'.format('Open' if self.is_open else 'Closed')
+
+	def __repr__(self):
+		return '<Tracker: {}>'.format(self._tracker_addr)
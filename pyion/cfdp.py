@@ -11,15 +11,23 @@
 """
 
 # General imports
+from collections import namedtuple
+import heapq
+import json
+import os
 from unittest.mock import Mock
-from pathlib import Path
-from threading import Event, Thread
+from pathlib import Path, PurePosixPath
+import shutil
+import tarfile
+import tempfile
+from threading import Condition, Event, Lock, Timer
+import time
 from warnings import warn
 
 # Module imports
 import pyion
 import pyion.utils as utils
-from pyion.constants import CfdpEventEnum
+from pyion.constants import CfdpConditionEnum, CfdpDeliverCodeEnum, CfdpEventEnum
 
 # Import C Extension
 try:
@@ -29,7 +37,22 @@ except ImportError:
 	_cfdp = Mock()
 
 # Define all methods/vars exposed at pyion
-__all__ = ['Entity']
+__all__ = ['Entity', 'Transaction', 'TransactionJournal', 'TreeReport', 'unpack_tree']
+
+# Outcome of ``Entity.cfdp_send_tree``. ``failed`` lists the source files that
+# could not be delivered, and ``throughput`` is in [bytes/sec].
+TreeReport = namedtuple('TreeReport', ['files', 'sent', 'failed', 'transactions',
+									   'retries', 'bytes', 'elapsed', 'throughput'])
+
+# Events journaled as progress of a transaction (see ``TransactionJournal``)
+_JOURNALED_EVENTS = (CfdpEventEnum.CFDP_EOF_SENT_IND, CfdpEventEnum.CFDP_SUSPENDED_IND,
+					 CfdpEventEnum.CFDP_RESUMED_IND, CfdpEventEnum.CFDP_FAULT_IND)
+
+# Prefix of the archives of small files created by ``Entity.cfdp_send_tree``
+_TREE_ARCHIVE = '.pyion_tree_'
+
+# Prefix of the memory files created by ``Entity.cfdp_send_bytes``
+_MEMORY_FILE = 'pyion_cfdp_'
 
 # ============================================================================
 # === Entity class
@@ -50,6 +73,10 @@ class Entity():
 		self.closure_lat  = closure_latency
 		self.seg_metadata = seg_metadata
 
+		# Map {CfdpConditionEnum: CfdpFaultHandlerEnum} used by default in
+		# the transactions of this entity. Conditions not in it use ION's defaults.
+		self.fault_handlers = {}
+
 		# Map {event_id}: event handler function
 		self.event_handers = {}
 
@@ -57,9 +84,20 @@ class Entity():
 		self._end_transaction = Event()
 		self._ok_transaction = False
 
-		# Start a thread to monitor all events
-		self.th = Thread(target=self._monitor_events, daemon=True)
-		self.th.start()
+		# Map {(source entity nbr, transaction nbr): Transaction} of the
+		# transactions started by this entity that have not finished
+		self._transactions = {}
+		self._tr_lock      = Lock()
+		self._tr_ended     = Condition(self._tr_lock)
+
+		# Journal of the transactions started by this entity (see ``CfdpProxy.cfdp_journal``)
+		self.journal = None
+
+		# Time [sec] that the memory file of ``cfdp_send_bytes`` (and the archives
+		# of ``cfdp_send_tree``) are kept after their transaction ends. ION references
+		# the file until its last block is acknowledged, and LTP reads it again for
+		# each retransmission.
+		self.memory_file_linger = 60
 
 	def __del__(self):
 		# If you have already been closed, return
@@ -84,25 +122,36 @@ class Entity():
 		self._param_addr = None
 		self.endpoint    = None
 
-		# Stop the thread monitoring CFDP events
-		_cfdp.cfdp_interrupt_events()
-
-		# Wait until the event thread has finished
-		self.th.join()
-
 		# Mark end of transactions to wake up threads
 		self._mark_transaction_end(False)
+		with self._tr_ended:
+			for tr in list(self._transactions.values()):
+				tr._mark_end(False)
+			self._transactions.clear()
+			self._tr_ended.notify_all()
 		
 	@utils._chk_is_open
 	@utils.in_ion_folder
 	def cfdp_send(self, source_file, dest_file=None, mode=None,
-				  closure_lat=None, seg_metadata=None):
+				  closure_lat=None, seg_metadata=None, **options):
 		""" Send a file using CFDP to the peer engine for this entity
 
 			:param source_file: str or Path of file to send
 			:param dest_file: str or Path. Name of file at receiving
 							  engine. It defaults to source_file
+			:param fault_handlers: Dictionary {CfdpConditionEnum: CfdpFaultHandlerEnum}.
+								   Updates ``Entity.fault_handlers`` for this transaction. 
+								   E.g., use CFDP_SUSPEND or CFDP_IGNORE so that long 
+								   transfers survive transient faults.
+			:param flow_label: bytes. Flow label of the transaction
+			:param records: Segment the file in whole records, so that each
+							file segment can be used on its own. Either a 
+							delimiter (e.g., ``b'\\n'``) or a record length [bytes].
+							Records longer than ``segment_length`` are split.
+			:param segment_length: Max length of the segments with ``records``.
+								   Defaults to 65000 bytes.
 			:param **kwargs: See ``proxy.cfdp_send``
+			:return: Transaction handle
 		"""
 		# Initialize variables
 		src_file = Path(source_file).resolve().absolute()
@@ -114,28 +163,112 @@ class Entity():
 		if not src_file.exists():
 			raise IOError('Source file {} does not exist'.format(src_file))
 
+		return self._send(src_file, dst_file, mode, closure_lat, seg_metadata, **options)
+
+	@utils._chk_is_open
+	@utils.in_ion_folder
+	def cfdp_send_bytes(self, buffer, dest_file, mode=None, closure_lat=None,
+						seg_metadata=None, **options):
+		""" Send data from memory using CFDP, without writing it to disk first.
+			The data is copied into a uniquely named, read-only file in 
+			``/dev/shm``, which is deleted ``memory_file_linger`` seconds after
+			the transaction ends. The file survives a restart of this process,
+			so the transaction can be recovered from the journal.
+
+			:param buffer: bytes or any object with the buffer protocol
+			:param dest_file: str or Path. Name of file at receiving engine
+			:param **kwargs: See ``cfdp_send``
+			:return: Transaction handle
+		"""
+		# Copy the data into a memory file
+		path = _memory_file(buffer)
+
+		# Send it, and delete the memory file once ION no longer needs it
+		try:
+			tr = self._send(path, dest_file, mode, closure_lat, seg_metadata, **options)
+		except:
+			_unlink(path)
+			raise
+		tr.add_done_callback(self._release_memory_file)
+		return tr
+
+	def _release_memory_file(self, tr):
+		""" Delete the memory file of a transaction after ``memory_file_linger`` """
+		th = Timer(self.memory_file_linger, _unlink, args=(tr.source_file,))
+		th.daemon = True
+		th.start()
+
+	def _release_tree_dir(self, tmp_dir, transactions):
+		""" Delete the archives of ``cfdp_send_tree`` ``memory_file_linger`` seconds
+			after the transactions that may still read them have ended (e.g., 
+			they were cancelled, which ION does asynchronously)
+		"""
+		pending, lock = [t for t in transactions if not t.done()], Lock()
+		if not pending:
+			shutil.rmtree(tmp_dir, ignore_errors=True)
+			return
+
+		def _ended(tr):
+			with lock:
+				pending.remove(tr)
+				if pending: return
+			th = Timer(self.memory_file_linger, shutil.rmtree, args=(tmp_dir,),
+					   kwargs={'ignore_errors': True})
+			th.daemon = True
+			th.start()
+
+		for tr in list(pending): tr.add_done_callback(_ended)
+
+	def _send(self, src_file, dst_file, mode, closure_lat, seg_metadata, fault_handlers=None,
+			  flow_label=None, records=None, segment_length=65000):
+		""" Start a CFDP send transaction. See ``cfdp_send`` """
 		# Set default values if necessary
 		if mode is None: mode = self.mode
 		if closure_lat is None: closure_lat = self.closure_lat
 		if seg_metadata is None: seg_metadata = self.seg_metadata
 
+		# Build the options of the put
+		handlers = self._fault_handlers(fault_handlers)
+		if records is None:
+			fmt, arg = _cfdp.CFDP_RECORDS_NONE, 0
+		elif isinstance(records, int):
+			fmt, arg = _cfdp.CFDP_RECORDS_FIXED, records
+		elif len(records) == 1:
+			fmt, arg = _cfdp.CFDP_RECORDS_DELIMITED, records[0]
+		else:
+			raise ValueError('Records must have a 1-byte delimiter or a fixed length')
+
 		# Mark that the current transaction has not succeeded yet
 		self._ok_transaction = False
 
-		# Trigger CFDP send
-		_cfdp.cfdp_send(self._param_addr, str(src_file), str(dst_file), 
-							  closure_lat, seg_metadata, mode)
+		# Trigger CFDP send. Hold the lock so that the transaction is tracked
+		# before the event monitor can see its end.
+		with self._tr_lock:
+			key = _cfdp.cfdp_send(self._param_addr, str(src_file), str(dst_file), 
+								  closure_lat, seg_metadata, mode, handlers, 
+								  flow_label or b'', fmt, arg, segment_length)
+			return self._new_transaction(key, src_file, dst_file)
 
 	@utils._chk_is_open
 	@utils.in_ion_folder
 	def cfdp_request(self, source_file, dest_file=None, mode=None,
-				  	 closure_lat=None, seg_metadata=None):
+				  	 closure_lat=None, seg_metadata=None, fault_handlers=None,
+				  	 flow_label=None, unacknowledged=True, record_bounds=False):
 		""" Request a file to be sent to this node using CFDP
 
 			:param source_file: str or Path of file to request
 			:param dest_file: str or Path. Name of file at this node 
 							  once it is received. Defaults to ``source_file``
+			:param fault_handlers: Fault handlers of the peer's transaction. See ``cfdp_send``
+			:param flow_label: bytes. Flow label of the peer's transaction
+			:param unacknowledged: If False, request the file in acknowledged 
+								   mode (ION only implements unacknowledged mode)
+			:param record_bounds: If True, request that the peer respects the 
+								  record boundaries of the file
 			:param **kwargs: See ``proxy.cfdp_send``
+			:return: Transaction handle. Note that it tracks the transaction
+					 that carries the request to the peer, not the transaction
+					 that the peer starts to send the file.
 		"""
 		# Set default values if necessary
 		if mode is None: mode = self.mode
@@ -145,58 +278,130 @@ class Entity():
 		# Mark that the current transaction has not succeeded yet
 		self._ok_transaction = False
 
-		# Trigger CFDP request
-		_cfdp.cfdp_request(self._param_addr, str(source_file), str(dest_file), 
-								 closure_lat, seg_metadata, mode)
+		# Trigger CFDP request (see ``cfdp_send`` for the lock)
+		with self._tr_lock:
+			key = _cfdp.cfdp_request(self._param_addr, str(source_file), str(dest_file), 
+									 closure_lat, seg_metadata, mode, 
+									 self._fault_handlers(fault_handlers), flow_label or b'',
+									 int(unacknowledged), int(record_bounds))
+			return self._new_transaction(key, source_file, dest_file, kind='request')
+
+	def _fault_handlers(self, fault_handlers):
+		""" Merge the fault handlers of a transaction with the entity's defaults
+
+			:param fault_handlers: Dictionary {CfdpConditionEnum: CfdpFaultHandlerEnum} or None
+			:return: Tuple of (condition, handler), or None if there are none
+		"""
+		handlers = dict(self.fault_handlers)
+		if fault_handlers: handlers.update(fault_handlers)
+		return tuple((int(c), int(h)) for c, h in handlers.items()) or None
+
+	def _new_transaction(self, key, source_file, dest_file, kind='send'):
+		""" Create and track the handle of a transaction started by this entity """
+		tr = Transaction(self, key[0], key[1], source_file, dest_file)
+		self._transactions[key] = tr
+		if self.journal is not None: self.journal.started(self.entity_nbr, tr, kind)
+		return tr
+
+	def _adopt_transaction(self, key, source_file, dest_file):
+		""" Track the handle of a transaction started by a previous process
+			(see ``CfdpProxy.cfdp_recover``). It is not journaled again.
+		"""
+		with self._tr_lock:
+			tr = self._transactions.get(key)
+			if tr is None:
+				tr = Transaction(self, key[0], key[1], source_file, dest_file)
+				self._transactions[key] = tr
+				if _is_memory_file(source_file): tr.add_done_callback(self._release_memory_file)
+		return tr
+
+	@property
+	def transactions(self):
+		""" Tuple of transactions started by this entity that have not finished """
+		return tuple(self._transactions.values())
 
 	@utils._chk_is_open
 	@utils.in_ion_folder
-	def cfdp_cancel(self):
-		""" Cancel the current CFDP transaction """
-		_cfdp.cfdp_cancel(self._param_addr)
+	def cfdp_cancel(self, transaction=None):
+		""" Cancel a CFDP transaction
+
+			:param transaction: Transaction handle. Defaults to the last one
+		"""
+		_cfdp.cfdp_cancel(self._param_addr, *self._transaction_key(transaction))
 
 	@utils._chk_is_open
 	@utils.in_ion_folder
-	def cfdp_suspend(self):
-		""" Suspend the current CFDP transaction """
-		_cfdp.cfdp_suspend(self._param_addr)
+	def cfdp_suspend(self, transaction=None):
+		""" Suspend a CFDP transaction
+
+			:param transaction: Transaction handle. Defaults to the last one
+		"""
+		_cfdp.cfdp_suspend(self._param_addr, *self._transaction_key(transaction))
 
 	@utils._chk_is_open
 	@utils.in_ion_folder
-	def cfdp_resume(self):
-		""" Resume the current CFDP transaction """
-		_cfdp.cfdp_resume(self._param_addr)
+	def cfdp_resume(self, transaction=None):
+		""" Resume a CFDP transaction
+
+			:param transaction: Transaction handle. Defaults to the last one
+		"""
+		_cfdp.cfdp_resume(self._param_addr, *self._transaction_key(transaction))
 
 	@utils._chk_is_open
 	@utils.in_ion_folder
-	def cfdp_report(self):
-		""" Request issuance on the transmission/reception progress of the current CFDP
+	def cfdp_report(self, transaction=None):
+		""" Request issuance on the transmission/reception progress of a CFDP
 			transaction.
+
+			:param transaction: Transaction handle. Defaults to the last one
 		"""
-		_cfdp.cfdp_report(self._param_addr)
+		_cfdp.cfdp_report(self._param_addr, *self._transaction_key(transaction))
+
+	@staticmethod
+	def _transaction_key(transaction):
+		""" Arguments that identify a transaction in the C Extension """
+		return () if transaction is None else transaction.key
 
 	@utils._chk_is_open
 	def add_usr_message(self, msg):
 		""" Add a user message to all CFDP PDUs in the next transaction 
 
-			:param str: User message to add
+			:param msg: User message to add (up to 255 bytes). ``bytes`` (or any
+						object with the buffer protocol) is sent as is, and ``str``
+						is encoded as UTF-8 and null-terminated. It is received
+						as ``bytes`` in the ``user_messages`` of the metadata
+						(a ``str`` keeps its null terminator).
 		"""
 		_cfdp.cfdp_add_usr_msg(self._param_addr, msg)
 
+	@utils._chk_is_open
+	def add_usr_messages(self, msgs):
+		""" Add several user messages to the next transaction in a single call
+
+			:param msgs: List or tuple of user messages (see ``add_usr_message``).
+						 If any of them is invalid, none is added.
+		"""
+		_cfdp.cfdp_add_usr_msgs(self._param_addr, msgs)
+
 	@utils._chk_is_open
 	def add_filestore_request(self, action, file1, file2=None):
-		""" Add a user message to all CFDP PDUs in the next transaction 
+		""" Add a filestore request to the next transaction 
 
 			:param action: See ``pyion.CFDP_CREATE_FILE``, etc.
 			:param file1: String or Path-object
 			:param file2: None, string or Path-object.
 		"""
-		# Transform files to string
-		file1 = str(file1)
-		if file2 is not None: file2 = str(file2)
+		_cfdp.cfdp_add_filestore_request(self._param_addr, int(action), file1, file2)
+
+	@utils._chk_is_open
+	def add_filestore_requests(self, requests):
+		""" Add several filestore requests to the next transaction in a single call
 
-		# Call pyion function
-		_cfdp.cfdp_add_filestore_request(self._param_addr, action, file1, file2)
+			:param requests: List or tuple of ``(action, file1)`` or ``(action, file1, file2)``.
+							 See ``add_filestore_request``. If any of them is invalid,
+							 none is added.
+		"""
+		_cfdp.cfdp_add_filestore_requests(self._param_addr, requests)
 	
 	def register_event_handler(self, event, func):
 		""" Register and event handler for this entity
@@ -211,7 +416,8 @@ class Entity():
 
 	def wait_for_transaction_end(self, timeout=None):
 		""" Blocks the calling thread until the transaction has
-			finished or the timeout expires.
+			finished or the timeout expires. To wait for a specific
+			transaction, use its handle instead (see ``Transaction.wait``).
 
 			:param timeout: Time to wait in [seconds]
 			:return: True if transaction finished successfully
@@ -236,40 +442,180 @@ class Entity():
 		# Reset the event
 		self._end_transaction.clear()
 
-	def _monitor_events(self):
-		""" Monitor all CFDP events """
-		while self.is_open:
-			# Get the next event
-			evt, ev_params = _cfdp.cfdp_next_event()
-
-			# Create event type class from integer code
-			evt = CfdpEventEnum(evt)
+	def _handle_event(self, evt, ev_params, key):
+		""" Handle a CFDP event routed to this entity by the proxy's event
+			dispatcher (see ``CfdpProxy._dispatch_events``)
 
-			# If no event, continue
-			if evt == CfdpEventEnum.CFDP_NO_EVENT:
-				continue
+			:param evt: Event type (integer code)
+			:param ev_params: Dictionary with the event parameters
+			:param key: Tuple (source entity nbr, transaction nbr)
+		"""
+		# Create event type class from integer code
+		evt = CfdpEventEnum(evt)
 
-			# If you have an event handler for this event type, use it
-			try:
-				func = self.event_handers[evt]
-				func(evt, ev_params)
-			except KeyError:
-				pass
+		# If no event, continue
+		if evt == CfdpEventEnum.CFDP_NO_EVENT:
+			return
 
-			# If you have a handler for all events, use it
-			try:
-				func = self.event_handers[CfdpEventEnum.CFDP_ALL_IND]
-				func(evt, ev_params)
-			except KeyError:
-				pass
-
-			# If transaction finished ok, report it
-			if evt == CfdpEventEnum.CFDP_TRANSACTION_FINISHED_IND:
-				self._mark_transaction_end(True)
-
-			# If transaction failed, report it
-			if evt == CfdpEventEnum.CFDP_ABANDONED_IND:
-				self._mark_transaction_end(False)
+		# If you have an event handler for this event type, use it
+		try:
+			func = self.event_handers[evt]
+			func(evt, ev_params)
+		except KeyError:
+			pass
+
+		# If you have a handler for all events, use it
+		try:
+			func = self.event_handers[CfdpEventEnum.CFDP_ALL_IND]
+			func(evt, ev_params)
+		except KeyError:
+			pass
+
+		# Remember faults. The transaction can still finish successfully if its
+		# fault handler ignores them.
+		if evt == CfdpEventEnum.CFDP_FAULT_IND:
+			tr = self._transactions.get(key)
+			if tr is not None: tr.fault = ev_params
+
+		# Journal the progress of the transactions started by this entity
+		if (self.journal is not None and key in self._transactions and 
+			evt in _JOURNALED_EVENTS):
+			self.journal.progress(key, evt.name, ev_params.get('progress'))
+
+		# If transaction finished, report whether the file was delivered
+		if evt == CfdpEventEnum.CFDP_TRANSACTION_FINISHED_IND:
+			success = _finished_ok(ev_params)
+			self._mark_transaction_end(success)
+			self._end_of(key, success)
+
+		# If transaction failed, report it
+		if evt == CfdpEventEnum.CFDP_ABANDONED_IND:
+			self._mark_transaction_end(False)
+			self._end_of(key, False)
+
+	def _end_of(self, key, success):
+		""" Resolve the handle of a transaction started by this entity, if any
+
+			:param key: Tuple (source entity nbr, transaction nbr)
+			:param success: True/False
+		"""
+		with self._tr_ended:
+			tr = self._transactions.pop(key, None)
+			if tr is None: return
+			tr._mark_end(success)
+			self._tr_ended.notify_all()
+		if self.journal is not None: self.journal.ended(key, tr._ok)
+
+	def cfdp_send_tree(self, src_dir, dst_dir, max_in_flight=8, retries=3, retry_delay=1.0,
+					   pattern='*', archive_below=None, archive_size=1048576, timeout=None,
+					   **kwargs):
+		""" Send all files in a directory tree, keeping up to ``max_in_flight``
+			transactions in progress at once. Transactions that are abandoned
+			or do not deliver the file are resubmitted up to ``retries`` times, waiting
+			``retry_delay`` seconds (doubled after each attempt) before each one.
+
+			The directory structure must exist at the receiving node. Small files
+			can be packed into tar archives to amortize the overhead of each 
+			transaction. The receiver unpacks them with ``pyion.cfdp.unpack_tree``.
+
+			:param src_dir: str or Path of the directory to send
+			:param dst_dir: str or Path of the directory at the receiving node
+			:param max_in_flight: Max number of transactions in progress
+			:param retries: Max number of times a file is resubmitted
+			:param retry_delay: Time before the first resubmission [sec]
+			:param pattern: Glob pattern of the files to send
+			:param archive_below: Files smaller than this [bytes] are sent in 
+								  archives of up to ``archive_size`` bytes. 
+								  None to send each file in its own transaction.
+			:param timeout: Time to wait for the whole tree [sec]. If it expires,
+							the transactions in progress are cancelled and
+							``TimeoutError`` is raised. Their archives are deleted
+							``memory_file_linger`` seconds after they end.
+			:param **kwargs: See ``cfdp_send``
+			:return: TreeReport
+		"""
+		# Initialize variables
+		src_dir   = Path(src_dir).resolve()
+		dst_dir   = PurePosixPath(dst_dir)
+		files     = sorted(f for f in src_dir.rglob(pattern) if f.is_file())
+		tmp_dir   = None
+		in_flight = {}
+		start     = time.time()
+		deadline  = None if timeout is None else start + timeout
+
+		# Units to send as (source file, dest file, files it carries)
+		units, small = [], []
+		for f in files:
+			rel = PurePosixPath(f.relative_to(src_dir).as_posix())
+			if archive_below is not None and f.stat().st_size < archive_below:
+				small.append((f, rel))
+			else:
+				units.append((f, str(dst_dir / rel), [f]))
+
+		try:
+			# Pack the small files into archives
+			if small:
+				tmp_dir = tempfile.mkdtemp(prefix='pyion_tree_')
+				units.extend(_pack_tree(small, tmp_dir, dst_dir, archive_size))
+
+			# Queue of (time ready, unit index, attempt)
+			queue     = [(start, i, 0) for i in range(len(units))]
+			sent, failed, nbytes, count, nretries = 0, [], 0, 0, 0
+
+			while queue or in_flight:
+				# Fill the window with the units ready to be sent
+				now = time.time()
+				while queue and queue[0][0] <= now and len(in_flight) < max_in_flight:
+					_, i, attempt = heapq.heappop(queue)
+					try:
+						tr = self.cfdp_send(units[i][0], dest_file=units[i][1], **kwargs)
+						in_flight[tr] = (i, attempt)
+						count += 1
+					except (IOError, RuntimeError) as e:
+						self._retry_unit(queue, units, failed, i, attempt, retries, retry_delay, e)
+						nretries += attempt < retries
+
+				# Give up if the time for the whole tree has expired
+				now = time.time()
+				if deadline is not None and now >= deadline:
+					for tr in in_flight: tr.cancel()
+					raise TimeoutError('{} files of {} not sent yet'.format(len(files) - sent - len(failed), src_dir))
+
+				# Wait until a transaction ends, a unit is ready to be resent, or the deadline
+				waits = [] if deadline is None else [deadline - now]
+				if queue and len(in_flight) < max_in_flight: waits.append(queue[0][0] - now)
+				wait = max(0.0, min(waits)) if waits else None
+				with self._tr_ended:
+					self._tr_ended.wait_for(lambda: not self.is_open or any(tr.done() for tr in in_flight),
+											timeout=wait)
+				if not self.is_open:
+					raise ConnectionAbortedError('Entity closed while sending {}'.format(src_dir))
+
+				# Collect the transactions that have ended
+				for tr in [tr for tr in in_flight if tr.done()]:
+					i, attempt = in_flight.pop(tr)
+					if tr._ok:
+						sent   += len(units[i][2])
+						nbytes += Path(units[i][0]).stat().st_size
+					else:
+						self._retry_unit(queue, units, failed, i, attempt, retries, retry_delay, tr)
+						nretries += attempt < retries
+		finally:
+			if tmp_dir is not None: self._release_tree_dir(tmp_dir, in_flight)
+
+		# Report the outcome
+		elapsed = time.time() - start
+		return TreeReport(len(files), sent, failed, count, nretries, nbytes, elapsed,
+						  nbytes/elapsed if elapsed > 0 else 0.0)
+
+	@staticmethod
+	def _retry_unit(queue, units, failed, i, attempt, retries, retry_delay, reason):
+		""" Resubmit a unit of ``cfdp_send_tree`` that failed, or give up on it """
+		if attempt < retries:
+			heapq.heappush(queue, (time.time() + retry_delay*2**attempt, i, attempt+1))
+		else:
+			warn('Cannot send {} over CFDP: {}'.format(units[i][0], reason))
+			failed.extend(units[i][2])
 	
 	def __enter__(self):
 		""" Allows an endpoint to be used as context manager """
@@ -283,4 +629,324 @@ class Entity():
 		return '<Entity: {} ({})>'.format(self.entity_nbr, 'Open' if self.is_open else 'Closed')
 
 	def __repr__(self):
-		return '<Entity: {} ({})>'.format(self.entity_nbr, self._param_addr)
\ No newline at end of file
+		return '<Entity: {} ({})>'.format(self.entity_nbr, self._param_addr)
+
+# ============================================================================
+# === Transaction class
+# ============================================================================
+
+class Transaction():
+	""" Handle to a CFDP transaction started with ``Entity.cfdp_send`` or 
+		``Entity.cfdp_request``. Do not instantiate it manually. It is resolved
+		by the entity's event monitor when the transaction finishes or is 
+		abandoned, so that many transactions can be in flight at once.
+
+		:ivar entity: Entity that started the transaction
+		:ivar source_entity_nbr: Source entity number of the transaction
+		:ivar transaction_nbr: Transaction number
+		:ivar source_file: Source file name
+		:ivar dest_file: Destination file name
+		:ivar fault: Parameters of the CFDP_FAULT_IND of this transaction, if any.
+					 The transaction is still successful if it finishes with
+					 no error and the file complete (e.g., the fault was ignored).
+	"""
+	def __init__(self, entity, source_entity_nbr, transaction_nbr, source_file,
+				 dest_file):
+		self.entity            = entity
+		self.source_entity_nbr = source_entity_nbr
+		self.transaction_nbr   = transaction_nbr
+		self.source_file       = source_file
+		self.dest_file         = dest_file
+		self.fault             = None
+		self._done             = Event()
+		self._ok               = None
+		self._callbacks        = []
+		self._cb_lock          = Lock()
+
+	@property
+	def key(self):
+		""" Tuple (source entity nbr, transaction nbr) """
+		return (self.source_entity_nbr, self.transaction_nbr)
+
+	def cancel(self):
+		""" Cancel this transaction """
+		self.entity.cfdp_cancel(self)
+
+	def suspend(self):
+		""" Suspend this transaction """
+		self.entity.cfdp_suspend(self)
+
+	def resume(self):
+		""" Resume this transaction """
+		self.entity.cfdp_resume(self)
+
+	def report(self):
+		""" Request issuance of a report on the progress of this transaction """
+		self.entity.cfdp_report(self)
+
+	def done(self):
+		""" Returns True if the transaction has finished or was abandoned """
+		return self._done.is_set()
+
+	def wait(self, timeout=None):
+		""" Block until the transaction has ended
+
+			:param timeout: Time to wait in [seconds]. Defaults to forever
+			:return: True if the transaction has ended
+		"""
+		return self._done.wait(timeout=timeout)
+
+	@property
+	def progress(self):
+		""" Snapshot of the progress of this transaction. See ``CfdpProxy.cfdp_progress`` """
+		if self.entity.proxy is None: return None
+		return self.entity.proxy.cfdp_progress(self.key)
+
+	def add_done_callback(self, func):
+		""" Call a function when this transaction ends, or right away if it
+			already has. It is called from the proxy's event dispatcher, so it 
+			should not block or start new transactions.
+
+			:param func: Function with signature ``def func(transaction)``
+		"""
+		with self._cb_lock:
+			if not self._done.is_set():
+				self._callbacks.append(func)
+				return
+		func(self)
+
+	def result(self, timeout=None):
+		""" Block until the transaction has ended and check its outcome
+
+			:param timeout: Time to wait in [seconds]. Defaults to forever
+			:return: True if the transaction finished successfully
+			:raises TimeoutError: If the transaction has not ended in time
+			:raises ConnectionError: If the transaction was abandoned, or did not
+									 deliver the file
+		"""
+		if not self.wait(timeout=timeout):
+			raise TimeoutError('CFDP transaction {} still in progress'.format(self.key))
+		if not self._ok:
+			raise ConnectionError('CFDP transaction {} failed{}'.format(self.key, 
+								  '' if self.fault is None else ' ({})'.format(self.fault)))
+		return True
+
+	def _mark_end(self, success):
+		""" Mark that this transaction has ended. Do not call directly.
+
+			:param success: True/False
+		"""
+		with self._cb_lock:
+			self._ok = success
+			self._done.set()
+			callbacks, self._callbacks = self._callbacks, []
+
+		# Run the callbacks. An error in one must not stop the others
+		for func in callbacks:
+			try:
+				func(self)
+			except Exception as e:
+				warn('Error in callback of CFDP transaction {}: {}'.format(self.key, e))
+
+	def __str__(self):
+		return '<Transaction: {}>'.format(self.key)
+
+	def __repr__(self):
+		return '<Transaction: {} ({} -> {})>'.format(self.key, self.source_file, self.dest_file)
+
+def _finished_ok(ev_params):
+	""" True if a ``CFDP_TRANSACTION_FINISHED_IND`` reports that the file was
+		delivered with no error, even if faults were reported (and ignored) before
+	"""
+	return (ev_params.get('condition_code') == CfdpConditionEnum.CFDP_NO_ERROR and
+			ev_params.get('delivery_code') == CfdpDeliverCodeEnum.CFDP_DATA_COMPLETE)
+
+# ============================================================================
+# === TransactionJournal class
+# ============================================================================
+
+class TransactionJournal():
+	""" Append-only journal of the CFDP transactions started by the entities of
+		a proxy. Each line is a JSON record of the start of a transaction (its
+		ID, entity, kind and files), its progress, or its end. A process that
+		restarts can re-associate with the transactions still in progress in
+		ION. Do not instantiate it manually, use ``CfdpProxy.cfdp_journal``.
+
+		:ivar path: Path of the journal
+		:ivar sync: If True, each record is flushed to disk with ``fsync``
+	"""
+	def __init__(self, path, sync=False):
+		self.path  = Path(path)
+		self.sync  = sync
+		self._lock = Lock()
+		self._file = open(str(self.path), 'a')
+
+		# End a record cut by a crash, so that it does not corrupt the next one
+		if self.path.stat().st_size > 0:
+			with open(str(self.path), 'rb') as f:
+				f.seek(-1, os.SEEK_END)
+				if f.read(1) != b'\n': self._append_line('\n')
+
+	def started(self, entity_nbr, tr, kind):
+		""" Journal the start of a transaction """
+		self._append({'op': 'start', 'key': list(tr.key), 'entity': entity_nbr, 'kind': kind,
+					  'src': str(tr.source_file), 'dst': str(tr.dest_file), 't': time.time()})
+
+	def progress(self, key, event, progress):
+		""" Journal an event that reports the progress of a transaction """
+		self._append({'op': 'progress', 'key': list(key), 'event': event, 
+					  'progress': progress, 't': time.time()})
+
+	def ended(self, key, success):
+		""" Journal the end of a transaction """
+		self._append({'op': 'end', 'key': list(key), 'ok': bool(success), 't': time.time()})
+
+	def _append(self, rec):
+		""" Append a record to the journal """
+		self._append_line(json.dumps(rec, separators=(',', ':')) + '\n')
+
+	def _append_line(self, line):
+		""" Append a line to the journal """
+		with self._lock:
+			if self._file is None: return
+			self._file.write(line)
+			self._file.flush()
+			if self.sync: os.fsync(self._file.fileno())
+
+	def pending(self):
+		""" Transactions started but not ended, according to the journal
+
+			:return: Dictionary {(source entity nbr, transaction nbr): start record}.
+					 The record has the last journaled ``event`` and ``progress``.
+		"""
+		with self._lock:
+			return self._read_pending()
+
+	def _read_pending(self):
+		""" See ``pending``. Must be called holding the lock. """
+		pending = {}
+		with open(str(self.path), 'r') as f:
+			for line in f:
+				# A record cut by a crash is ignored
+				try:
+					rec = json.loads(line)
+					key = tuple(rec['key'])
+				except (ValueError, KeyError, TypeError):
+					continue
+
+				if rec['op'] == 'start':
+					pending[key] = rec
+				elif rec['op'] == 'progress' and key in pending:
+					pending[key].update(event=rec['event'], progress=rec['progress'])
+				elif rec['op'] == 'end':
+					pending.pop(key, None)
+		return pending
+
+	def compact(self):
+		""" Rewrite the journal with only the transactions still pending """
+		tmp = str(self.path) + '.tmp'
+		with self._lock:
+			pending = self._read_pending()
+			with open(tmp, 'w') as f:
+				for rec in pending.values():
+					f.write(json.dumps(rec, separators=(',', ':')) + '\n')
+				f.flush()
+				os.fsync(f.fileno())
+			if self._file is not None: self._file.close()
+			os.replace(tmp, str(self.path))
+			self._file = open(str(self.path), 'a')
+
+	def close(self):
+		""" Close the journal """
+		with self._lock:
+			if self._file is not None: self._file.close()
+			self._file = None
+
+	def __repr__(self):
+		return '<TransactionJournal: {}>'.format(self.path)
+
+# ============================================================================
+# === Memory files
+# ============================================================================
+
+def _memory_dir():
+	""" Directory of the memory files (``/dev/shm`` if available) """
+	return '/dev/shm' if os.path.isdir('/dev/shm') else tempfile.gettempdir()
+
+def _memory_file(buffer):
+	""" Copy a buffer into a uniquely named, read-only file that lives in 
+		memory. ION's CFDP daemons open it by name every time they read it,
+		so the name must not be reused while they reference it.
+
+		:param buffer: bytes or any object with the buffer protocol
+		:return: Path of the file
+	"""
+	fd, path = tempfile.mkstemp(prefix=_MEMORY_FILE, dir=_memory_dir())
+	try:
+		with open(fd, 'wb') as f:
+			f.write(buffer)
+		os.chmod(path, 0o400)
+	except:
+		_unlink(path)
+		raise
+	return path
+
+def _is_memory_file(path):
+	""" True if ``path`` was created with ``_memory_file`` """
+	path = str(path)
+	return (os.path.dirname(path) == _memory_dir() and 
+			os.path.basename(path).startswith(_MEMORY_FILE))
+
+def _unlink(path):
+	""" Delete a file if it exists """
+	try:
+		os.unlink(path)
+	except FileNotFoundError:
+		pass
+
+# ============================================================================
+# === Archives of small files
+# ============================================================================
+
+def _pack_tree(small, tmp_dir, dst_dir, archive_size):
+	""" Pack small files into tar archives for ``Entity.cfdp_send_tree``
+
+		:param small: List of (source file, relative path)
+		:param tmp_dir: Directory to create the archives in
+		:param dst_dir: PurePosixPath of the directory at the receiving node
+		:param archive_size: Target size of each archive [bytes]
+		:return: List of (archive, dest file, files it carries)
+	"""
+	units, tar, size = [], None, 0
+	try:
+		for f, rel in small:
+			if tar is None or size >= archive_size:
+				if tar is not None: tar.close()
+				name = '{}{:05d}.tar'.format(_TREE_ARCHIVE, len(units))
+				tar  = tarfile.open(os.path.join(tmp_dir, name), 'w')
+				units.append((tar.name, str(dst_dir / name), []))
+				size = 0
+			tar.add(str(f), arcname=str(rel), recursive=False)
+			units[-1][2].append(f)
+			size += f.stat().st_size + tarfile.BLOCKSIZE
+	finally:
+		if tar is not None: tar.close()
+	return units
+
+def unpack_tree(dst_dir, remove=True):
+	""" Unpack the archives of small files sent with ``Entity.cfdp_send_tree``
+		once they have been received.
+
+		:param dst_dir: str or Path of the directory where they were received
+		:param remove: If True, delete each archive once unpacked
+		:return: List of files unpacked
+	"""
+	files = []
+	for arch in sorted(Path(dst_dir).glob(_TREE_ARCHIVE + '*.tar')):
+		with tarfile.open(str(arch)) as tar:
+			members = [m for m in tar.getmembers() if m.isfile() and 
+					   not (m.name.startswith('/') or '..' in PurePosixPath(m.name).parts)]
+			tar.extractall(str(dst_dir), members=members)
+			files.extend(Path(dst_dir) / m.name for m in members)
+		if remove: arch.unlink()
+	return files
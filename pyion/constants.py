@@ -22,6 +22,12 @@ except ImportError:
     warn('_bp, _cfdp extensions not available. Using mock instead.')
     _bp, _cfdp = Mock(), Mock()
 
+try:
+    import _ltp
+except ImportError:
+    warn('_ltp extension not available. Using mock instead.')
+    _ltp = Mock()
+
 # Define all methods/vars exposed at pyion
 __all__ = [
     'BpCustodyEnum', 
@@ -29,14 +35,20 @@ __all__ = [
     'BpEcsEnumeration',
     'BpReportsEnum',
     'BpAckReqEnum',
+    'BpAdminRecordEnum',
+    'BpSrReasonEnum',
+    'CodecEnum',
+    'LtpSegmentEnum',
     'CfdpMode',
     'CfdpClosure',
     'CfdpMetadataEnum',
     'CfdpFileStoreEnum',
     'CfdpEventEnum',
     'CfdpConditionEnum',
+    'CfdpFaultHandlerEnum',
     'CfdpFileStatusEnum',
-    'CfdpDeliverCodeEnum'
+    'CfdpDeliverCodeEnum',
+    'CfdpTransactionStateEnum'
 ]
 
 # ============================================================================
@@ -89,6 +101,59 @@ class BpAckReqEnum(IntEnum):
     BP_ACK_REQ    = True
     BP_NO_ACK_REQ = False
 
+@unique
+class BpAdminRecordEnum(IntEnum):
+    """ BP administrative record types. See ``help(BpAdminRecordEnum)`` """
+    BP_STATUS_REPORT  = _bp.BP_STATUS_REPORT
+    BP_CUSTODY_SIGNAL = _bp.BP_CUSTODY_SIGNAL
+
+@unique
+class BpSrReasonEnum(IntEnum):
+    """ Reason codes in BP status reports and custody signals (RFC 5050, section 6.1).
+        See ``help(BpSrReasonEnum)``
+    """
+    SR_NO_EXPLANATION        = 0
+    SR_LIFETIME_EXPIRED      = 1
+    SR_UNIDIRECTIONAL_LINK   = 2
+    SR_CANCELED              = 3
+    SR_DEPLETED_STORAGE      = 4
+    SR_DEST_UNINTELLIGIBLE   = 5
+    SR_NO_KNOWN_ROUTE        = 6
+    SR_NO_TIMELY_CONTACT     = 7
+    SR_BLOCK_UNINTELLIGIBLE  = 8
+
+# ============================================================================
+# === PAYLOAD COMPRESSION
+# ============================================================================
+
+@unique
+class CodecEnum(IntEnum):
+    """ Compression codecs for BP endpoints and LTP access points. See ``help(CodecEnum)``
+
+        - NONE: Disable compression (and decompression)
+        - LZ4: Fast compression. Level is the LZ4 acceleration
+        - ZSTD: Better ratio. Level is the zstd compression level
+    """
+    NONE = _bp.CODEC_NONE
+    LZ4  = _bp.CODEC_LZ4
+    ZSTD = _bp.CODEC_ZSTD
+
+# ============================================================================
+# === LICKLIDER TRANSMISSION PROTOCOL
+# ============================================================================
+
+@unique
+class LtpSegmentEnum(IntEnum):
+    """ Kind of data returned by ``AccessPoint.ltp_receive_segment``. See ``help(LtpSegmentEnum)``
+
+        - LTP_RED_PART: Red part of a block. It starts at offset 0
+        - LTP_GREEN_SEGMENT: Green segment of a block. It may be lost
+        - LTP_IMPORT_CANCELED: Import session cancelled. No data
+    """
+    LTP_RED_PART        = _ltp.LtpRecvRedPart
+    LTP_GREEN_SEGMENT   = _ltp.LtpRecvGreenSegment
+    LTP_IMPORT_CANCELED = _ltp.LtpImportSessionCanceled
+
 # ============================================================================
 # === CFDP PROTOCOL
 # ============================================================================
@@ -159,6 +224,7 @@ class CfdpEventEnum(IntEnum):
     CFDP_FAULT_IND                = _cfdp.CfdpFaultInd
     CFDP_ABANDONED_IND            = _cfdp.CfdpAbandonedInd
     CFDP_ALL_IND                  = 100
+    CFDP_SEGMENTS_SUMMARY_IND     = _cfdp.CfdpSegmentsSummaryInd
 
 @unique
 class CfdpConditionEnum(IntEnum):
@@ -177,6 +243,15 @@ class CfdpConditionEnum(IntEnum):
     CFDP_SUSPED_REQUESTED         = _cfdp.CfdpSuspendRequested
     CFDP_CANCEL_REQUESTED         = _cfdp.CfdpCancelRequested
 
+@unique
+class CfdpFaultHandlerEnum(IntEnum):
+    """ Action upon a CFDP fault condition. ``CFDP_NO_HANDLER`` uses the default of the entity """
+    CFDP_NO_HANDLER = _cfdp.CfdpNoHandler
+    CFDP_CANCEL     = _cfdp.CfdpCancel
+    CFDP_SUSPEND    = _cfdp.CfdpSuspend
+    CFDP_IGNORE     = _cfdp.CfdpIgnore
+    CFDP_ABANDON    = _cfdp.CfdpAbandon
+
 @unique
 class CfdpFileStatusEnum(IntEnum):
     """ CFDP file status enumeration. See ``help(CfdpFileStatusEnum)`` """
@@ -189,4 +264,14 @@ class CfdpFileStatusEnum(IntEnum):
 class CfdpDeliverCodeEnum(IntEnum):
     """ CFDP delivery code enumeration. See ``help(CfdpDeliverCodeEnum)`` """
     CFDP_DATA_COMPLETE   = _cfdp.CfdpDataComplete
-    CFDP_DATA_INCOMPLETE = _cfdp.CfdpDataIncomplete
\ No newline at end of file
+    CFDP_DATA_INCOMPLETE = _cfdp.CfdpDataIncomplete
+
+@unique
+class CfdpTransactionStateEnum(IntEnum):
+    """ State of a CFDP transaction in ``CfdpProxy.cfdp_progress``. A transaction
+        that is abandoned, or finishes with an error or incomplete data, is
+        ``CFDP_TR_FAILED`` """
+    CFDP_TR_ACTIVE    = _cfdp.CFDP_TR_ACTIVE
+    CFDP_TR_SUSPENDED = _cfdp.CFDP_TR_SUSPENDED
+    CFDP_TR_FINISHED  = _cfdp.CFDP_TR_FINISHED
+    CFDP_TR_FAILED    = _cfdp.CFDP_TR_FAILED
@@ -12,13 +12,15 @@
 
 # General imports
 from unittest.mock import Mock
+from collections import namedtuple
 from pathlib import Path
-from threading import Event, Thread
+import time
 from warnings import warn
 
 # Module imports
 import pyion
 import pyion.utils as utils
+from pyion.constants import LtpSegmentEnum
 
 # Import C Extension
 try:
@@ -28,7 +30,11 @@ except ImportError:
 	_ltp = Mock()
 
 # Define all methods/vars exposed at pyion
-__all__ = ['AccessPoint']
+__all__ = ['AccessPoint', 'ExportSession', 'Aggregator', 'LtpSegment', 'wait_all', 'as_completed']
+
+# Red part or green segment of an LTP block. ``kind`` is a ``LtpSegmentEnum``
+LtpSegment = namedtuple('LtpSegment', ['engine_id', 'session_nbr', 'kind', 'offset', 
+                                       'data', 'end_of_block', 'reason_code'])
 
 # ============================================================================
 # === AccessPoint class
@@ -43,6 +49,7 @@ class AccessPoint():
         self._sap_addr = sap_addr
         self.node_dir  = proxy.node_dir
         self._result   = None
+        self._aggrs    = []
 
     def __del__(self):
         # If you have already been closed, return
@@ -57,6 +64,13 @@ class AccessPoint():
         """ Returns True if the access point is opened """
         return (self.proxy is not None and self._sap_addr is not None)
 
+    def _close_aggregators(self):
+        """ Close all aggregators of this access point, sending their pending
+            messages. Do not call directly, use ``proxy.ltp_close``
+        """
+        while self._aggrs:
+            self._aggrs[-1].close()
+
     def _cleanup(self):
         """ Clean access point after closing. Do not call directly,
             use ``proxy.ltp_close``
@@ -68,42 +82,247 @@ class AccessPoint():
 
     @utils._chk_is_open
     @utils.in_ion_folder
-    def ltp_send(self, dest_engine_nbr, data):
+    def ltp_send(self, dest_engine_nbr, data, red_length=None):
         """ Trigger LTP to send data 
 
             :param: Destination engine number
-            :param: Data as str, bytes or bytearray
+            :param: Data as str or any object with the buffer protocol (bytes,
+                    bytearray, memoryview, numpy array, etc.). It is not copied
+                    before being inserted in the SDR heap.
+            :param red_length: Number of bytes at the start of the block sent as 
+                               red (reliable) LTP. The rest is sent as green LTP.
+                               Defaults to None (all red). Use 0 for all green.
+            :return: ExportSession resolved when the block is acknowledged
+                     or cancelled
+        """
+        red_length  = _ltp.LTP_ALL_RED if red_length is None else int(red_length)
+        session_nbr = _ltp.ltp_send(self._sap_addr, dest_engine_nbr, red_length, data)
+        return ExportSession(self, session_nbr)
+
+    @utils._chk_is_open
+    @utils.in_ion_folder
+    def ltp_send_file(self, dest_engine_nbr, file_path, offset=0, length=None, red_length=None):
+        """ Trigger LTP to send a block read directly from a file. The block
+            is not loaded in memory nor copied to the SDR heap, so the file
+            must not be modified until the session is resolved.
+
+            .. Warning:: Payload compression does not apply to file blocks.
+
+            :param: Destination engine number
+            :param file_path: str or Path of the file
+            :param offset: Offset of the block in the file in [bytes]
+            :param length: Length of the block in [bytes]. Defaults to the
+                           rest of the file
+            :param red_length: See ``ltp_send``
+            :return: ExportSession resolved when the block is acknowledged
+                     or cancelled
+        """
+        file_path   = Path(file_path).resolve().absolute()
+        red_length  = _ltp.LTP_ALL_RED if red_length is None else int(red_length)
+        length      = 0 if length is None else int(length)
+        if length < 0 or offset < 0:
+            raise ValueError('Offset and length of an LTP block must be positive')
+        session_nbr = _ltp.ltp_send_file(self._sap_addr, dest_engine_nbr, red_length,
+                                         str(file_path), int(offset), length)
+        return ExportSession(self, session_nbr)
+
+    @utils._chk_is_open
+    def ltp_aggregator(self, dest_engine_nbr, size_limit=65536, time_limit=1.0):
+        """ Create an aggregator to send many small messages to an engine using
+            few LTP blocks (and export sessions). See ``Aggregator``.
+
+            :param: Destination engine number
+            :param size_limit: Target block size in [bytes]
+            :param time_limit: Max time a message waits before its block is
+                               sent in [seconds]. None to disable.
+            :return: Aggregator
+        """
+        time_limit = 0.0 if time_limit is None else float(time_limit)
+        aggr_addr  = _ltp.ltp_aggr_open(self._sap_addr, dest_engine_nbr, int(size_limit), time_limit)
+        aggr       = Aggregator(self, dest_engine_nbr, aggr_addr)
+        self._aggrs.append(aggr)
+        return aggr
+
+    @utils._chk_is_open
+    def wait_all(self, sessions, timeout=None):
+        """ Block until all export sessions are resolved
+
+            :param sessions: Iterable of ExportSession from this access point
+            :param timeout: Time to wait in [seconds]. Defaults to forever
+            :return: True if all sessions are resolved
+        """
+        nbrs = tuple(s.session_nbr for s in sessions)
+        done = _ltp.ltp_session_wait(self._sap_addr, nbrs, 1, _to_timeout(timeout))
+        return len(done) == len(nbrs)
+
+    @utils._chk_is_open
+    def as_completed(self, sessions, timeout=None):
+        """ Iterate over export sessions as they are resolved. 
+
+            :param sessions: Iterable of ExportSession from this access point
+            :param timeout: Total time to wait in [seconds]. Defaults to forever.
+                            If it expires, ``TimeoutError`` is raised
+            :return: Generator of ExportSession
         """
-        self._result = _ltp.ltp_send(self._sap_addr, dest_engine_nbr, data)
+        pending  = {s.session_nbr: s for s in sessions}
+        deadline = None if timeout is None else time.time() + timeout
+
+        while pending:
+            left = None if deadline is None else max(0.0, deadline - time.time())
+            done = _ltp.ltp_session_wait(self._sap_addr, tuple(pending), 0, _to_timeout(left))
+            if not done:
+                raise TimeoutError('{} LTP export sessions still pending'.format(len(pending)))
+            for nbr in done:
+                yield pending.pop(nbr)
 
     @utils._chk_is_open
-    def ltp_receive(self):
-        """ Trigger LTP to receive data """
-        # Receive on another thread. Otherwise you cannot handle a SIGINT
-        th = Thread(target=self._ltp_receive, daemon=True)
-        th.start()
-        th.join()
-
-        # If exception, raise it
-        if isinstance(self._result, Exception):
-            raise self._result
-
-        return self._result
-        
     @utils.in_ion_folder
-    def _ltp_receive(self):
-        # Get payload from next bundle. If exception, return it too
+    def ltp_receive(self, timeout=None):
+        """ Trigger LTP to receive data. Blocks are delivered by the access 
+            point's notice dispatcher, so this call does not start a thread
+            and can be interrupted with SIGINT.
+
+            :param timeout: Time to wait in [seconds]. Defaults to forever.
+                            If it expires, ``TimeoutError`` is raised.
+            :return: Block as bytes
+        """
+        return _ltp.ltp_receive(self._sap_addr, _to_timeout(timeout))
+
+    def ltp_receive_messages(self, timeout=None):
+        """ Receive a block sent by an ``Aggregator`` and split it into the
+            original messages. Blocks that are not aggregated are returned 
+            as a single message.
+
+            :param timeout: See ``ltp_receive``
+            :return: List of messages as bytes
+        """
+        block = self.ltp_receive(timeout=timeout)
         try:
-            self._result = _ltp.ltp_receive(self._sap_addr)
-        except Exception as e:
-            self._result = e
+            return _ltp.ltp_unpack(block)
+        except ValueError:
+            return [block]
+
+    @utils._chk_is_open
+    @utils.in_ion_folder
+    def ltp_receive_into(self, buffer, timeout=None):
+        """ Receive a block directly into a writable buffer (e.g., a recycled
+            ``bytearray`` or ``memoryview``) instead of a new bytes object.
+
+            :param buffer: Object with the writable buffer protocol
+            :param timeout: Time to wait in [seconds]. Defaults to forever.
+                            If it expires, ``TimeoutError`` is raised.
+            :return: Number of bytes written in ``buffer``
+            :raises BufferError: If the block does not fit in ``buffer``. The
+                                 block is kept and returned by the next call.
+        """
+        return _ltp.ltp_receive_into(self._sap_addr, buffer, _to_timeout(timeout))
+
+    @utils._chk_is_open
+    @utils.in_ion_folder
+    def ltp_receive_segment(self, timeout=None):
+        """ Receive the next red part or green segment of a block. Use it 
+            if the sender uses green LTP (see ``red_length`` in ``ltp_send``).
+            Green segments are delivered as soon as they arrive, they may be
+            lost and their ``offset`` is relative to the start of the block.
+
+            :param timeout: Time to wait in [seconds]. Defaults to forever.
+                            If it expires, ``TimeoutError`` is raised.
+            :return: LtpSegment
+        """
+        return _to_segment(_ltp.ltp_receive_segment(self._sap_addr, _to_timeout(timeout)))
+
+    @utils._chk_is_open
+    @utils.in_ion_folder
+    def ltp_receive_many(self, max_blocks=1024, timeout=None):
+        """ Receive all blocks, green segments and cancelled import sessions 
+            already pending in one call. This is a BLOCKING call until at least
+            one is available. Use it instead of ``ltp_receive`` for high block
+            rates, since all pending notices are drained in a single native loop.
+
+            :param max_blocks: Max number of records to return
+            :param timeout: Time to wait in [seconds]. Defaults to forever.
+                            If it expires, ``TimeoutError`` is raised.
+            :return: List of LtpSegment. For all-red blocks, ``data`` is the 
+                     entire block. For cancelled sessions, ``data`` is None and
+                     ``reason_code`` is set.
+        """
+        segs = _ltp.ltp_receive_many(self._sap_addr, int(max_blocks), _to_timeout(timeout))
+        return [_to_segment(s) for s in segs]
+
+    def ltp_receive_stream(self, timeout=None):
+        """ Iterate over the red parts and green segments received until
+            this access point is interrupted or closed.
+
+            :param timeout: Time to wait for each segment in [seconds]. Defaults
+                            to forever. If it expires, ``TimeoutError`` is raised.
+            :return: Generator of LtpSegment
+        """
+        while self.is_open:
+            try:
+                yield self.ltp_receive_segment(timeout=timeout)
+            except (InterruptedError, ConnectionAbortedError):
+                return
+
+    @utils._chk_is_open
+    @utils.in_ion_folder
+    def ltp_export_events(self, max_events=1024, timeout=None):
+        """ Get the outcome of the export sessions (i.e., blocks sent) of this
+            client. It can be called concurrently with ``ltp_receive``. This is
+            a BLOCKING call until at least one event is available, and then all
+            events already pending are returned at once.
+
+            .. Warning:: If this function is never called, only the last 1024
+                         events are kept.
+
+            :param max_events: Max number of events to return
+            :param timeout: Time to wait in [seconds]. Defaults to forever.
+                            If it expires, ``TimeoutError`` is raised.
+            :return: List of tuples (engine id, session number, notice, reason code),
+                     where notice is ``_ltp.LtpExportSessionComplete`` or
+                     ``_ltp.LtpExportSessionCanceled``
+        """
+        return _ltp.ltp_export_events(self._sap_addr, max_events, _to_timeout(timeout))
+
+    @property
+    def notice_stats(self):
+        """ Counters of the notice dispatcher of this access point
+
+            :return: Dictionary
+        """
+        if not self.is_open: return {}
+        return _ltp.ltp_notice_stats(self._sap_addr)
             
     @utils._chk_is_open
     @utils.in_ion_folder
     def ltp_interrupt(self):
-        """ Trigger LTP to be interrupted """
+        """ Interrupt the calls waiting on this access point (e.g., ``ltp_receive``),
+            which raise ``InterruptedError``. This call returns once they have
+            left the access point, or after a 5 second deadline. The access
+            point remains open.
+        """
         _ltp.ltp_interrupt(self._sap_addr)
 
+    @utils._chk_is_open
+    def set_codec(self, codec, level=0, min_size=64, max_size=64*1024*1024):
+        """ Compress the blocks sent by ``ltp_send``, and decompress the blocks
+            received by ``ltp_receive``. Small or incompressible blocks are sent
+            as is, so the receiving access point must also have a codec (any)
+            to handle mixed traffic.
+
+            :param codec: ``CodecEnum`` value. ``CodecEnum.NONE`` disables it
+            :param level: LZ4 acceleration or zstd level. Defaults to 0 (codec default)
+            :param min_size: Blocks with fewer bytes are not compressed
+            :param max_size: Received blocks that decompress to more bytes are
+                             rejected as corrupted
+        """
+        _ltp.ltp_set_codec(self._sap_addr, int(codec), int(level), int(min_size), int(max_size))
+
+    @property
+    def codec_stats(self):
+        """ Compression statistics of this access point. See ``Endpoint.codec_stats`` """
+        if not self.is_open: return {}
+        return _ltp.ltp_codec_stats(self._sap_addr)
+
     def __enter__(self):
         """ Allows an endpoint to be used as context manager """
         return self
@@ -116,4 +335,184 @@ class AccessPoint():
         return '<AccessPoint: {} ({})>'.format(self.client_id, 'Open' if self.is_open else 'Closed')
 
     def __repr__(self):
-        return '<AccessPoint: {} ({})>'.format(self.client_id, self._sap_addr)
\ No newline at end of file
+        return '<AccessPoint: {} ({})>'.format(self.client_id, self._sap_addr)
+
+# ============================================================================
+# === ExportSession class
+# ============================================================================
+
+class ExportSession():
+    """ Handle to a block sent with ``AccessPoint.ltp_send``. Do not instantiate
+        it manually. Its status is updated by the access point's notice
+        dispatcher when the block is fully acknowledged (or cancelled).
+
+        :ivar sap: AccessPoint that sent the block
+        :ivar session_nbr: LTP session number
+    """
+    def __init__(self, sap, session_nbr):
+        self.sap         = sap
+        self.session_nbr = session_nbr
+        self._status     = None
+
+    def __del__(self):
+        # Let the access point forget this session
+        if self.sap is not None and self.sap.is_open:
+            _ltp.ltp_session_release(self.sap._sap_addr, self.session_nbr)
+
+    def _get_status(self):
+        """ Get (status, reason code) from the C Extension """
+        if self._status is not None and self._status[0] != _ltp.EXPORT_PENDING:
+            return self._status
+        if self.sap is None or not self.sap.is_open:
+            raise ConnectionAbortedError('Access point for LTP session {} is closed'.format(self.session_nbr))
+        self._status = _ltp.ltp_session_status(self.sap._sap_addr, self.session_nbr)
+        if self._status is None:
+            raise KeyError('LTP session {} is not tracked'.format(self.session_nbr))
+        return self._status
+
+    def done(self):
+        """ Returns True if the session is complete or cancelled """
+        return self._get_status()[0] != _ltp.EXPORT_PENDING
+
+    @property
+    def reason_code(self):
+        """ LTP reason code if the session was cancelled """
+        return self._get_status()[1]
+
+    def wait(self, timeout=None):
+        """ Block until the session is resolved
+
+            :param timeout: Time to wait in [seconds]. Defaults to forever
+            :return: True if the session is resolved
+        """
+        return self.sap.wait_all([self], timeout=timeout)
+
+    def result(self, timeout=None):
+        """ Block until the session is resolved and check its outcome
+
+            :param timeout: Time to wait in [seconds]. Defaults to forever
+            :return: True if the block was acknowledged
+            :raises TimeoutError: If the session is not resolved in time
+            :raises ConnectionError: If the session was cancelled
+        """
+        if not self.wait(timeout=timeout):
+            raise TimeoutError('LTP session {} still pending'.format(self.session_nbr))
+        status, reason = self._get_status()
+        if status == _ltp.EXPORT_CANCELED:
+            raise ConnectionError('LTP session {} cancelled (reason code={})'.format(self.session_nbr, reason))
+        return True
+
+    def __str__(self):
+        return '<ExportSession: {}>'.format(self.session_nbr)
+
+    def __repr__(self):
+        return '<ExportSession: {} ({})>'.format(self.session_nbr, self.sap)
+
+# ============================================================================
+# === Aggregator class
+# ============================================================================
+
+class Aggregator():
+    """ Packs small messages into LTP blocks, similar to the span's aggregation
+        of bundles. A block is sent when the next message would not fit in
+        ``size_limit``, when its first message has waited ``time_limit``, or 
+        when ``flush`` is called. Do not instantiate it manually, use 
+        ``AccessPoint.ltp_aggregator``. The receiver gets the messages back 
+        with ``AccessPoint.ltp_receive_messages``.
+
+        :ivar sap: AccessPoint that sends the blocks
+        :ivar dest_engine_nbr: Destination engine number
+    """
+    def __init__(self, sap, dest_engine_nbr, aggr_addr):
+        self.sap             = sap
+        self.dest_engine_nbr = dest_engine_nbr
+        self._aggr_addr      = aggr_addr
+
+    def __del__(self):
+        self.close()
+
+    @property
+    def is_open(self):
+        """ Returns True if the aggregator is open """
+        return self._aggr_addr is not None
+
+    def send(self, data):
+        """ Add a message to the current block. Blocks if LTP has no export
+            sessions available to send a full block.
+
+            :param data: Message as str or any object with the buffer protocol
+        """
+        if not self.is_open:
+            raise ConnectionError('LTP aggregator is closed')
+        _ltp.ltp_aggr_send(self._aggr_addr, data)
+
+    def flush(self):
+        """ Send the current block now
+
+            :return: ExportSession of the block, or None if it was empty
+        """
+        if not self.is_open:
+            raise ConnectionError('LTP aggregator is closed')
+        session_nbr = _ltp.ltp_aggr_flush(self._aggr_addr)
+        return None if session_nbr is None else ExportSession(self.sap, session_nbr)
+
+    def close(self, flush=True):
+        """ Close the aggregator
+
+            :param flush: If True, send the pending messages
+        """
+        if not self.is_open: return
+        _ltp.ltp_aggr_close(self._aggr_addr, int(flush))
+        self._aggr_addr = None
+        if self in self.sap._aggrs:
+            self.sap._aggrs.remove(self)
+
+    @property
+    def stats(self):
+        """ Messages and blocks sent by this aggregator
+
+            :return: Dictionary
+        """
+        if not self.is_open: return {}
+        return _ltp.ltp_aggr_stats(self._aggr_addr)
+
+    def __enter__(self):
+        return self
+
+    def __exit__(self, exc_type, exc_val, exc_tb):
+        self.close()
+
+    def __str__(self):
+        return '<Aggregator: {} -> {}>'.format(self.sap.client_id, self.dest_engine_nbr)
+
+# ============================================================================
+# === Helper functions
+# ============================================================================
+
+def _to_timeout(timeout):
+    """ Timeout for the C Extension. Negative means wait forever """
+    return -1.0 if timeout is None else float(timeout)
+
+def _to_segment(rec):
+    """ Convert a record from the C Extension to an LtpSegment """
+    return LtpSegment(rec[0], rec[1], LtpSegmentEnum(rec[2]), *rec[3:])
+
+def _same_sap(sessions):
+    """ Check that all sessions belong to the same access point """
+    sessions = list(sessions)
+    saps = {id(s.sap) for s in sessions}
+    if len(saps) > 1:
+        raise ValueError('All LTP export sessions must belong to the same access point')
+    return sessions
+
+def wait_all(sessions, timeout=None):
+    """ Block until all export sessions are resolved. See ``AccessPoint.wait_all`` """
+    sessions = _same_sap(sessions)
+    if not sessions: return True
+    return sessions[0].sap.wait_all(sessions, timeout=timeout)
+
+def as_completed(sessions, timeout=None):
+    """ Iterate over export sessions as they are resolved. See ``AccessPoint.as_completed`` """
+    sessions = _same_sap(sessions)
+    if not sessions: return iter(())
+    return sessions[0].sap.as_completed(sessions, timeout=timeout)
\ No newline at end of file
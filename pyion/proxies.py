@@ -12,10 +12,12 @@
 
 # General imports
 from unittest.mock import Mock
+import mmap
 import os
 from pathlib import Path
+import random
 import signal
-from time import sleep
+from threading import Event, Thread
 from warnings import warn
 
 # Module imports
@@ -202,10 +204,18 @@ class BpProxy(utils.Proxy):
         # Map {eid: Endpoint}
         self._ept_map = {}
 
+        # Priority send queue. Created on first use
+        self._send_queue = None
+
+        # Index of outstanding bundles. Created on first use
+        self._tracker = None
+
     def __del__(self):
         """ Close all Endpoints associated with this proxy """
         global _bp_proxies
         self.bp_close_all()
+        self.bp_close_send_queue()
+        self.bp_close_tracker()
         self.bp_detach()
         utils._unregister_proxy(_bp_proxies, self.node_nbr)
 
@@ -248,7 +258,7 @@ class BpProxy(utils.Proxy):
     def bp_open(self, eid, TTL=3600, priority=cst.BpPriorityEnum.BP_STD_PRIORITY,
                 report_eid=None, custody=cst.BpCustodyEnum.NO_CUSTODY_REQUESTED,
                 report_flags=cst.BpReportsEnum.BP_NO_RPTS, ack_req=cst.BpAckReqEnum.BP_NO_ACK_REQ,
-                retx_timer=0, chunk_size=None):
+                retx_timer=0, chunk_size=None, sub_priority=1, detained=False):
         """ Open an endpoint. If it already exists, the existing instance
             is returned.
 
@@ -276,6 +286,11 @@ class BpProxy(utils.Proxy):
                                means that no timer is created.
             :param chunk_size: Send data in bundles of ``chunk_size`` bytes (plus header), 
                                instead of a single potentially very large bundle.
+            :param sub_priority: Ordinal [0-254] that orders bundles within the
+                                 expedited class. Defaults to 1.
+            :param detained: Open the endpoint in detained mode, which is needed to
+                             get the handle of each bundle sent (see ``bp_tracker``).
+                             Always True if ``retx_timer>0``.
             :return: Endpoint object
         """
         # If this EID is already open, return it
@@ -283,16 +298,16 @@ class BpProxy(utils.Proxy):
             return self._ept_map[eid]
 
         # Detect if this endpoint "detains" bundles (see bp_open_source in ION manual)
-        detained = (retx_timer > 0)
+        detained = (retx_timer > 0) or bool(detained)
 
-        # Open EID in ION. Get the address of the BpSapState as a long. If retx_timer>0, then
+        # Open EID in ION. Get the address of the BpSapState as a long. If detained, then
         # open the endpoint in "detained mode" (see bp_open_source in ION manual).
         sap_addr = _bp.bp_open(eid, int(detained))
 
         # Create an endpoint
         ept_obj = bp.Endpoint(self, eid, sap_addr, TTL, int(priority), report_eid,
                               int(custody), int(report_flags), int(ack_req), 
-                              int(retx_timer), detained, chunk_size)
+                              int(retx_timer), detained, chunk_size, int(sub_priority))
 
         # Store it
         self._ept_map[eid] = ept_obj
@@ -320,6 +335,11 @@ class BpProxy(utils.Proxy):
         if not ept_obj.is_open:
             return
 
+        # Drop any data that this endpoint has not sent yet. The send queue
+        # cannot use the endpoint after it is closed.
+        if self._send_queue is not None:
+            self._send_queue.purge(ept_obj)
+
         # Close EID in ION
         _bp.bp_close(ept_obj._sap_addr)
 
@@ -341,24 +361,236 @@ class BpProxy(utils.Proxy):
         # Get SAP address in memory.
         ept_obj = self._ept_map[eid]
 
-        # Close EID in ION
+        # Interrupt EID in ION. This returns once the receiver has raised
+        # ``InterruptedError`` (or after a deadline).
         _bp.bp_interrupt(ept_obj._sap_addr)
 
-        # This is little hack to ensure that SIGINT prints "interrupted" as opposed
-        # to raising ConnectionAbortedError. However, this is not guaranteed
-        sleep(0.001)
-
+    @utils.in_ion_folder
     def bp_close_all(self):
-        """ Close all opened endpoints """
-        # Close all endpoints
-        for ept in self.open_endpoints:
-            self.bp_close(ept)
+        """ Close all opened endpoints. Their receivers are interrupted in
+            parallel, and this call returns once all of them have acknowledged it.
+        """
+        # Get all open endpoints
+        epts = [self._ept_map.pop(eid) for eid in self.open_endpoints]
+        epts = [ept for ept in epts if ept.is_open]
+        if not epts: return
+
+        # Drop any data that these endpoints have not sent yet
+        if self._send_queue is not None:
+            for ept in epts: self._send_queue.purge(ept)
+
+        # Close all EIDs in ION at once
+        _bp.bp_close_many(tuple(ept._sap_addr for ept in epts))
+
+        # Mark objects as inactive
+        for ept in epts: ept._cleanup()
 
+    @utils.in_ion_folder
     def bp_interrupt_all(self):
-        """ Interrupt all opened endpoints """
-        # Close all endpoints
-        for ept in self.open_endpoints:
-            self.bp_interrupt(ept)
+        """ Interrupt all opened endpoints in parallel. This call returns once
+            all receivers have acknowledged it.
+        """
+        epts = [self._ept_map[eid] for eid in self.open_endpoints]
+        if not epts: return
+        _bp.bp_interrupt_many(tuple(ept._sap_addr for ept in epts))
+
+    @utils._chk_attached
+    @utils.in_ion_folder
+    def bp_stripe_send(self, eids, dest_eids, data, chunk_size, transfer_id=None,
+                       TTL=None, priority=None, sub_priority=None, report_eid=None,
+                       custody=None, report_flags=None, ack_req=None, retx_timer=None):
+        """ Send one payload split in sequenced chunks. Chunk ``i`` is sent from
+            endpoint ``eids[i % len(eids)]`` to ``dest_eids[i % len(dest_eids)]``.
+            Use ``bp_stripe_receive`` at the destination(s) to reassemble it.
+
+            :param eids: List of EIDs (already opened) to send from
+            :param dest_eids: Destination EID or list of destination EIDs
+            :param data: Data as ``bytes``, ``bytearray``, ``memoryview`` or ``mmap``
+            :param chunk_size: Number of bytes of data per bundle (plus a 24 byte header)
+            :param transfer_id: 32-bit integer identifying this transfer. Defaults to random
+            :param **kwargs: See ``Proxy.bp_open``. Defaults are taken from ``eids[0]``
+            :return: Transfer id
+        """
+        # Get the endpoint objects
+        if isinstance(eids, str): eids = [eids]
+        if isinstance(dest_eids, str): dest_eids = [dest_eids]
+        try:
+            epts = [self._ept_map[eid] for eid in eids]
+        except KeyError as e:
+            raise ConnectionError('Cannot stripe through endpoint {}. It is not open.'.format(e))
+
+        # Get default values if necessary
+        ept = epts[0]
+        if TTL is None: TTL = ept.TTL
+        if priority is None: priority = ept.priority
+        if sub_priority is None: sub_priority = ept.sub_priority
+        if report_eid is None: report_eid = ept.report_eid
+        if custody is None: custody = ept.custody
+        if report_flags is None: report_flags = ept.report_flags
+        if ack_req is None: ack_req = ept.ack_req
+        if retx_timer is None: retx_timer = ept.retx_timer
+        if transfer_id is None: transfer_id = random.randint(1, 2**32-1)
+
+        # Custodial timers are only possible if all endpoints are detained
+        if retx_timer>0 and not all(e.detained for e in epts):
+            raise ConnectionError('Not all endpoints are detained. You cannot set up custodial timers.')
+
+        # If data is a string, then encode it to get a bytes object
+        if isinstance(data, str): data = data.encode('utf-8')
+
+        # Send all chunks from the C Extension
+        _bp.bp_stripe_send(tuple(e._sap_addr for e in epts), tuple(dest_eids), report_eid,
+                           TTL, int(priority), sub_priority, int(custody), int(report_flags),
+                           int(ack_req), retx_timer, self._tracker_addr, transfer_id,
+                           chunk_size, data)
+
+        return transfer_id
+
+    def bp_stripe_send_file(self, eids, dest_eids, file_path, chunk_size, **kwargs):
+        """ Convenience function to send a file as a striped transfer. The file
+            is memory-mapped, so it is not read into Python memory.
+
+            :param eids: List of EIDs (already opened) to send from
+            :param dest_eids: Destination EID or list of destination EIDs
+            :param file_path: Path to file being sent
+            :param chunk_size: Number of bytes of data per bundle
+            :param **kwargs: See ``BpProxy.bp_stripe_send``
+            :return: Transfer id
+        """
+        # Initialize variables
+        file_path = Path(file_path)
+
+        # If file does not exist, raise error
+        if not file_path.exists():
+            raise IOError('{} is not valid'.format(file_path))
+
+        # Send it
+        with file_path.open('rb') as f, mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as mm:
+            return self.bp_stripe_send(eids, dest_eids, mm, chunk_size, **kwargs)
+
+    @utils._chk_attached
+    def bp_stripe_receive(self, eids, transfer_id=0, out=None):
+        """ Receive a striped transfer through one or multiple endpoints. This is
+            a BLOCKING call that returns once all chunks have been received.
+            Bundles that do not belong to the transfer are dropped.
+
+            :param eids: List of EIDs (already opened) to receive from
+            :param transfer_id: Only accept this transfer. Defaults to 0, which
+                                accepts the first transfer seen.
+            :param out: Writable buffer (e.g. ``bytearray``) where to reassemble the
+                        data. If None, a ``bytes`` object is allocated.
+            :return: ``out`` or a bytes object with the reassembled data
+            :raises InterruptedError: If any of the endpoints is interrupted
+                                      before the transfer is complete
+        """
+        # Get the endpoint objects
+        if isinstance(eids, str): eids = [eids]
+        try:
+            epts = [self._ept_map[eid] for eid in eids]
+        except KeyError as e:
+            raise ConnectionError('Cannot receive through endpoint {}. It is not open.'.format(e))
+
+        # Create the reassembly state
+        rx_addr = _bp.bp_stripe_rx_open(transfer_id, out)
+        done    = Event()
+        errors  = []
+
+        # Receive through each endpoint in a separate thread
+        def _receive(ept):
+            while not done.is_set():
+                try:
+                    missing = self._bp_stripe_receive(rx_addr, ept)
+                except BaseException as e:
+                    # An interruption after the transfer is done comes from
+                    # the cleanup below, not from the user.
+                    if not (isinstance(e, InterruptedError) and done.is_set()):
+                        errors.append(e)
+                    done.set()
+                    return
+                if missing == 0: done.set()
+
+        ths = [Thread(target=_receive, args=(ept,), daemon=True) for ept in epts]
+        for th in ths: th.start()
+
+        # Wait for the transfer to complete. If interrupted by the user, stop
+        # all receiving threads.
+        try:
+            while not done.wait(0.1): pass
+        finally:
+            done.set()
+            while any(th.is_alive() for th in ths):
+                for ept in epts:
+                    if ept.is_open: _bp.bp_interrupt(ept._sap_addr)
+                for th in ths: th.join(0.01)
+            ret = _bp.bp_stripe_rx_close(rx_addr)
+
+        # If exception, raise it
+        if errors: raise errors[0]
+
+        return ret
+
+    @utils.in_ion_folder
+    def _bp_stripe_receive(self, rx_addr, ept):
+        """ Receive one chunk of a striped transfer """
+        return _bp.bp_stripe_receive(rx_addr, ept._sap_addr)
+
+    @utils._chk_attached
+    def bp_send_queue(self):
+        """ Get the priority send queue of this proxy. It is created (and its
+            dispatcher thread started) the first time this function is called.
+
+            :return: SendQueue object
+        """
+        if self._send_queue is None:
+            self._send_queue = bp.SendQueue(self, _bp.bp_queue_open())
+        return self._send_queue
+
+    def bp_close_send_queue(self):
+        """ Stop the priority send queue. Data not sent yet is lost, use 
+            ``SendQueue.flush`` first to avoid it.
+        """
+        # If no queue, you are done
+        if getattr(self, '_send_queue', None) is None:
+            return
+
+        # Close it
+        self._send_queue._close()
+        self._send_queue = None
+
+    @utils._chk_attached
+    def bp_tracker(self, done_flags=cst.BpReportsEnum.BP_DELIVERED_RPT):
+        """ Get the bundle tracker of this proxy. It is created the first time 
+            this function is called. From then on, bundles sent by any endpoint
+            of this proxy that request ``done_flags`` reports (or custody, if
+            ``done_flags`` includes ``BP_CUSTODY_RPT``) are indexed until a
+            report for them is received with ``Endpoint.bp_receive_reports``.
+
+            .. Warning:: Requires compiling pyion with ``ION_HOME``.
+
+            :param done_flags: ``BpReportsEnum`` flags that mark a bundle as delivered.
+                               Ignored if the tracker already exists.
+            :return: Tracker object
+        """
+        if self._tracker is None:
+            self._tracker = bp.Tracker(self, _bp.bp_tracker_open(int(done_flags)))
+        return self._tracker
+
+    def bp_close_tracker(self):
+        """ Stop tracking bundles and free the index """
+        # If no tracker, you are done
+        if getattr(self, '_tracker', None) is None:
+            return
+
+        # Close it
+        self._tracker._close()
+        self._tracker = None
+
+    @property
+    def _tracker_addr(self):
+        """ Memory address of the tracker for the C Extension (0 if None) """
+        if getattr(self, '_tracker', None) is None:
+            return 0
+        return self._tracker._tracker_addr
 
 # ============================================================================
 # === Proxy to CFDP engine in ION for a given node
@@ -372,6 +604,22 @@ class CfdpProxy(utils.Proxy):
         # Map {entity_nbr: Entity}
         self._ett_map = {}
 
+        # Native dispatcher of CFDP events, and thread that delivers them
+        # to the entities. Started on attach.
+        self._disp_addr = None
+        self._disp_th   = None
+
+        # Time between summaries of the file segments received [sec]. None
+        # if each segment is delivered as a CFDP_FILE_SEGMENT_IND
+        self._aggr_interval = None
+
+        # Thread that reports the progress of the transactions periodically
+        self._mon_th   = None
+        self._mon_stop = Event()
+
+        # Journal of the transactions started by the entities (see ``cfdp_journal``)
+        self._journal = None
+
     def __del__(self):
         """ Close all Endpoints associated with this proxy """
         global _cfdp_proxies
@@ -404,15 +652,207 @@ class CfdpProxy(utils.Proxy):
         # Mark as attached to ION
         self.attached = True
 
+        # Start dispatching the CFDP events of this node. If there is a journal, 
+        # the events of transactions started by a previous process are held
+        # until ``cfdp_recover`` routes them to their entities.
+        if self._disp_addr is None:
+            hold = int(self.node_nbr) if self._journal is not None else 0
+            self._disp_addr = _cfdp.cfdp_dispatcher_start(hold)
+            if self._aggr_interval:
+                _cfdp.cfdp_dispatcher_aggregate(self._disp_addr, self._aggr_interval)
+            self._disp_th   = Thread(target=self._dispatch_events, args=(self._disp_addr,),
+                                     daemon=True)
+            self._disp_th.start()
+
     @utils.in_ion_folder
     def cfdp_detach(self):
         """ Dettach from ION """
+        # Stop reporting progress and dispatching events
+        self.cfdp_monitor_progress(None)
+        self._stop_dispatcher()
+
         # Detach from ION instance
         _cfdp.cfdp_detach()
 
         # Mark as detached from ION
         self.attached = False
 
+    def _stop_dispatcher(self):
+        """ Stop the native event dispatcher and the thread that delivers its events """
+        if getattr(self, '_disp_addr', None) is None:
+            return
+        addr, self._disp_addr = self._disp_addr, None
+        _cfdp.cfdp_dispatcher_stop(addr)
+        self._disp_th.join()
+        _cfdp.cfdp_dispatcher_close(addr)
+
+    def _dispatch_events(self, disp_addr):
+        """ Deliver the CFDP events of this node to the entity that owns
+            their transaction. The native dispatcher has already routed
+            them, so this is a dictionary lookup per event. All events
+            pending are drained with a single call to the C extension.
+        """
+        while True:
+            try:
+                events = _cfdp.cfdp_dispatcher_next_many(disp_addr, 256, -1)
+            except ConnectionAbortedError:
+                return
+            except RuntimeError as e:
+                warn('Cannot process CFDP event: {}'.format(e))
+                continue
+
+            # Events of entities not open are dropped
+            for entity_nbr, (evt, ev_params, key) in events:
+                ett_obj = self._ett_map.get(entity_nbr)
+                if ett_obj is not None: ett_obj._handle_event(evt, ev_params, key)
+
+    def cfdp_aggregate_segments(self, interval=1.0):
+        """ Coalesce the ``CFDP_FILE_SEGMENT_IND`` of each transaction into a
+            ``CFDP_SEGMENTS_SUMMARY_IND`` every ``interval`` seconds (and
+            right before its ``CFDP_EOF_RECV_IND``, ``CFDP_TRANSACTION_FINISHED_IND``
+            or ``CFDP_ABANDONED_IND``). The summary parameters are ``segments``
+            and ``total_segments`` received, ``received`` bytes, ``file_size``
+            and the ``extents`` of the file received as a list of ``(start, end)``.
+
+            :param interval: Time between summaries [sec]. None or 0 to
+                             deliver each segment indication again.
+        """
+        self._aggr_interval = interval if interval and interval > 0 else None
+        if self._disp_addr is not None:
+            _cfdp.cfdp_dispatcher_aggregate(self._disp_addr, self._aggr_interval or 0)
+
+    def cfdp_progress(self, transaction=None):
+        """ Snapshot of the progress of the CFDP transactions of this node.
+            Each transaction is a dictionary with its ``transaction_id``, 
+            ``entity_nbr``, ``inbound`` (True if received by this node),
+            ``state`` (see ``CfdpTransactionStateEnum``), ``file_size``,
+            bytes ``sent``, ``acked`` and ``received``, number of ``events``
+            and ``faults``, ``elapsed`` time and ``inactive`` time since its
+            last event [sec], and its current and average ``throughput`` 
+            [bytes/sec]. Transactions are kept for a minute after they end.
+
+            :param transaction: Transaction or tuple (source entity nbr, 
+                                transaction nbr). None for all transactions.
+            :return: List of dictionaries, or one dictionary (None if the 
+                     transaction is unknown)
+        """
+        if self._disp_addr is None:
+            return [] if transaction is None else None
+        if transaction is None:
+            return _cfdp.cfdp_dispatcher_progress(self._disp_addr)
+
+        key  = transaction.key if isinstance(transaction, cfdp.Transaction) else transaction
+        prog = _cfdp.cfdp_dispatcher_progress(self._disp_addr, *key)
+        return prog[0] if prog else None
+
+    def cfdp_monitor_progress(self, func, interval=1.0):
+        """ Call a function periodically with the progress of all CFDP transactions
+            of this node (see ``cfdp_progress``), from a thread. Events are
+            not delivered to Python for this.
+
+            :param func: Function with signature ``def func(progress)``, where
+                         progress is a list of dictionaries. None to stop.
+            :param interval: Time between calls [sec]
+        """
+        # Stop the current monitor, if any
+        if self._mon_th is not None:
+            self._mon_stop.set()
+            self._mon_th.join()
+            self._mon_th = None
+        if func is None:
+            return
+
+        # Start the new one
+        self._mon_stop.clear()
+        self._mon_th = Thread(target=self._monitor_progress, args=(func, interval), daemon=True)
+        self._mon_th.start()
+
+    def _monitor_progress(self, func, interval):
+        """ Report the progress of the transactions until ``cfdp_monitor_progress(None)`` """
+        while not self._mon_stop.wait(interval):
+            try:
+                func(self.cfdp_progress())
+            except Exception as e:
+                warn('Error in CFDP progress monitor: {}'.format(e))
+
+    def cfdp_journal(self, path, sync=False):
+        """ Journal the transactions started by the entities of this proxy in
+            an append-only file, so that a new process can recover them with
+            ``cfdp_recover`` if this one stops. Call it before ``cfdp_attach``,
+            so that the events that ION queued for those transactions while no 
+            process was running are held until ``cfdp_recover``.
+
+            :param path: str or Path of the journal. Records are appended if
+                         it exists.
+            :param sync: If True, flush each record to disk (slower)
+            :return: TransactionJournal
+        """
+        if self._journal is not None: self._journal.close()
+        self._journal = cfdp.TransactionJournal(path, sync=sync)
+        for ett_obj in self._ett_map.values():
+            ett_obj.journal = self._journal
+        return self._journal
+
+    @utils._chk_attached
+    @utils.in_ion_folder
+    def cfdp_recover(self, action='resume'):
+        """ Re-associate with the transactions that the journal shows as still
+            in progress (e.g., started by a previous process). Their entities
+            must be open. Each one gets a new ``Transaction`` handle and its 
+            events are routed to its entity again, so files are not re-sent.
+            The events held since ``cfdp_attach`` are then dispatched.
+
+            :param action: 'resume' to resume the ones that the journal shows as
+                           suspended, 'cancel' to cancel them, or None to only 
+                           track them
+            :return: Tuple (recovered, lost). ``recovered`` is a list of
+                     Transaction. ``lost`` is a list of the journal records
+                     of the transactions that ION rejected.
+        """
+        if self._journal is None:
+            raise RuntimeError('Start the journal with cfdp_journal first')
+        if action not in ('resume', 'cancel', None):
+            raise ValueError('Invalid action {}'.format(action))
+
+        recovered, lost = [], []
+        for key, rec in self._journal.pending().items():
+            # Transactions of entities not open stay in the journal
+            ett_obj = self._ett_map.get(rec['entity'])
+            if ett_obj is None: continue
+
+            # Track the transaction and route its events to its entity
+            tr = ett_obj._adopt_transaction(key, rec['src'], rec['dst'])
+            if self._disp_addr is not None:
+                _cfdp.cfdp_dispatcher_route(self._disp_addr, key[0], key[1], rec['entity'])
+
+            # Resume or cancel it. Only suspended transactions can be resumed.
+            try:
+                if action == 'resume' and rec.get('event') == 'CFDP_SUSPENDED_IND': tr.resume()
+                if action == 'cancel': tr.cancel()
+                recovered.append(tr)
+            except RuntimeError as e:
+                warn('Cannot recover CFDP transaction {}: {}'.format(key, e))
+                ett_obj._end_of(key, False)
+                lost.append(rec)
+
+        # Dispatch the events of transactions not recovered, and keep only the
+        # transactions still pending
+        if self._disp_addr is not None:
+            _cfdp.cfdp_dispatcher_release(self._disp_addr)
+        self._journal.compact()
+
+        return recovered, lost
+
+    @property
+    def dispatcher_stats(self):
+        """ Statistics of the CFDP event dispatcher (events dispatched, queued
+            and held, transactions routed and tracked, segment indications coalesced).
+            ``error`` is True while getting events from ION fails. The dispatcher
+            keeps retrying, and ``errors`` counts the failed attempts.
+        """
+        if self._disp_addr is None: return None
+        return _cfdp.cfdp_dispatcher_stats(self._disp_addr)
+
     @utils._chk_attached
     @utils.in_ion_folder
     def cfdp_open(self, peer_entity_nbr, endpoint, mode=cst.CfdpMode.CFDP_BP_RELIABLE,
@@ -438,11 +878,13 @@ class CfdpProxy(utils.Proxy):
             endpoint.sub_priority,
             endpoint.report_flags,
             endpoint.criticality,
+            self._disp_addr or 0,
         )
 
         # Create a CFDP entity object
         ett_obj = cfdp.Entity(self, peer_entity_nbr, param_addr, endpoint,
                               int(mode), int(closure_latency), int(seg_metadata))
+        ett_obj.journal = self._journal
 
         # Store it
         self._ett_map[peer_entity_nbr] = ett_obj
@@ -478,7 +920,8 @@ class CfdpProxy(utils.Proxy):
     def cfdp_cancel_all(self):
         """ Cancel any transaction in all entities in this node """
         for peer_nbr in self.open_entities:
-            self._ett_map[peer_nbr].cfdp_cancel()
+            for tr in self._ett_map[peer_nbr].transactions:
+                tr.cancel()
 
 # ============================================================================
 # === Proxy to LTP engine in ION for a given node
@@ -571,21 +1014,68 @@ class LtpProxy(utils.Proxy):
         if not sap_obj.is_open:
             return
 
+        # Send pending aggregated messages. Aggregators use the access point.
+        sap_obj._close_aggregators()
+
         # Close Entity in ION
         _ltp.ltp_close(sap_obj._sap_addr)
 
         # Mark object as inactive
         sap_obj._cleanup()
 
+    @utils.in_ion_folder
     def ltp_close_all(self):
-        """ Close all open clients in this proxy """
-        for client_id in self.open_clients:
-            self.ltp_close(client_id)
+        """ Close all open clients in this proxy. Their receivers are stopped
+            in parallel, and this call returns once all of them have left.
+        """
+        # Get all open access points
+        saps = [self._sap_map.pop(cid) for cid in self.open_clients]
+        saps = [sap for sap in saps if sap.is_open]
+        if not saps: return
+
+        # Send pending aggregated messages. Aggregators use the access points.
+        for sap in saps: sap._close_aggregators()
 
+        # Close all access points in ION at once
+        _ltp.ltp_close_many(tuple(sap._sap_addr for sap in saps))
+
+        # Mark objects as inactive
+        for sap in saps: sap._cleanup()
+
+    @utils._chk_attached
+    @utils.in_ion_folder
+    def receive_any(self, client_ids=None, timeout=None):
+        """ Receive from any of several LTP clients with a single thread. The
+            notice dispatchers of all access points wake up a native 
+            multiplexer, which serves the access points in round robin.
+
+            :param client_ids: Iterable of client ids. Defaults to all open clients
+            :param timeout: Time to wait in [seconds]. Defaults to forever.
+                            If it expires, ``TimeoutError`` is raised.
+            :return: Tuple (client id, event, payload), where event is a
+                     ``LtpSegmentEnum`` and payload is the LtpSegment received
+                     (see ``AccessPoint.ltp_receive_segment``)
+        """
+        # Get the access points to receive from
+        client_ids = self.open_clients if client_ids is None else tuple(client_ids)
+        saps = [self._sap_map[cid] for cid in client_ids]
+
+        # Wait for any of them
+        idx, rec = _ltp.ltp_receive_any(tuple(sap._sap_addr for sap in saps), ltp._to_timeout(timeout))
+        seg = ltp._to_segment(rec)
+
+        return client_ids[idx], seg.kind, seg
+
+    @utils.in_ion_folder
     def ltp_interrupt_all(self):
-        """ Interrupt any LTP transactions in all clients in this proxy """
-        for client_id in self.open_clients:
-            self._sap_map[client_id].ltp_interrupt()
+        """ Interrupt any LTP transactions in all clients in this proxy. They
+            are interrupted in parallel, and this call returns once all of
+            them have left their access points.
+        """
+        saps = [self._sap_map[cid] for cid in self.open_clients]
+        saps = [sap for sap in saps if sap.is_open]
+        if not saps: return
+        _ltp.ltp_interrupt_many(tuple(sap._sap_addr for sap in saps))
 
 # ============================================================================
 # === EOF
@@ -55,6 +55,7 @@
 # ========================================================================================
 
 # Generic imports
+from ctypes.util import find_library
 import math
 import os
 from pathlib import Path
@@ -113,6 +114,10 @@ else:
     # Just empty paths, they won't be used
     bp_path, cfdp_path, ltp_path = '', '', ''
 
+# Extensions with optional features that need ION's private API (e.g., the
+# bundle tracker in _bp) get the private include paths and this macro
+private_macros = [('PYION_PRIVATE_API', '1')] if ion_path else []
+
 # ========================================================================================
 # === Figure out compile-time options
 # ========================================================================================
@@ -128,6 +133,18 @@ elif hw_type == 16:
 else:
     raise ValueError('Cannot determine compute type (16 vs. 32 vs. 64 bits)')
 
+# Optional compression codecs for _bp and _ltp. Each one is compiled in if both
+# its header and its shared library are found.
+codec_macros, codec_libs = [], []
+for lib, header, macro in [('lz4', 'lz4.h', 'PYION_HAVE_LZ4'), ('zstd', 'zstd.h', 'PYION_HAVE_ZSTD')]:
+    inc_dirs = [ion_inc, Path('/usr/include'), Path('/usr/local/include')]
+    if find_library(lib) and any((d/header).exists() for d in inc_dirs):
+        codec_macros.append((macro, '1'))
+        codec_libs.append(lib)
+    else:
+        warn('Codec ``{}`` not compiled. Install its development package.'.format(lib),
+             category=SetupWarning)
+
 # Defined C compilation options for the extensions.
 compile_args = [
     '-DSPACE_ORDER={}'.format(ds), 
@@ -153,10 +170,11 @@ _admin = Extension('_admin',
 
 # Define the ION-BP extension and related directories
 _bp = Extension('_bp',
-                include_dirs=[str(ion_inc)],
-                libraries=['bp', 'ici'],
+                include_dirs=[str(ion_inc)] + ([str(bp_path)] if ion_path else []),
+                libraries=['bp', 'ici'] + codec_libs,
                 library_dirs=[str(ion_lib)],
                 sources=['./pyion/_bp.c'],
+                define_macros=private_macros + codec_macros,
                 extra_compile_args=compile_args
                 )
 
@@ -172,9 +190,10 @@ _cfdp = Extension('_cfdp',
 # Define the ION-LTP extension and related directories
 _ltp = Extension('_ltp',
                 include_dirs=[str(ion_inc)],
-                libraries=['ltp', 'ici'],
+                libraries=['ltp', 'ici'] + codec_libs,
                 library_dirs=[str(ion_lib)],
                 sources=['./pyion/_ltp.c'],
+                define_macros=codec_macros,
                 extra_compile_args=compile_args
                 )
 